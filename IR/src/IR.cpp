@@ -1,4 +1,5 @@
 #include "IR.h"
+#include <thread_pool.h>
 
 #ifdef IR_DEBUG
 #define DEBUG_OUT (std::cerr << "DEBUG-IR: ") // or any other ostream
@@ -257,6 +258,135 @@ namespace IR {
         return ret;
     }
 
+    /**
+     * print(), the to_string text without the temporaries
+     * */
+
+    void ItemTypeSig::print(Output::Sink & out) {
+        switch (this->vtype)
+        {
+        case VarType::code :
+            out << "code";
+            break;
+        
+        case VarType::int64 :
+            out << "int64";
+            break;
+
+        case VarType::tuple :
+            out << "tuple";
+            break;
+
+        case VarType::tensor :
+            out << "int64";
+            for (int32_t i = 0; i < this->ndim; i++) {
+                out << "[]";
+            }
+            break;
+        
+        case VarType::void_type :
+            out << "void ";
+            break;
+
+        default:
+            std::cerr << "wrong op type in ItemTypeSig::print\n";
+            assert(0);
+        }
+    }
+
+    void ItemConstant::print(Output::Sink & out) {
+        out << this->constVal;
+    }
+
+    void ItemLabel::print(Output::Sink & out) {
+        out << this->labelName;
+    }
+
+    void ItemVariable::print(Output::Sink & out) {
+        out << this->name;
+    }
+
+    void ItemArrAccess::print(Output::Sink & out) {
+        this->addr->print(out);
+        for (Item * offset : this->offsets) {
+            out << '[';
+            offset->print(out);
+            out << ']';
+        }
+    }
+
+    static const char * op_name(OpType opType) {
+        switch (opType)
+        {
+        case OpType::plus :         return "+";
+        case OpType::minus :        return "-";
+        case OpType::times :        return "*";
+        case OpType::bit_and :      return "&";
+        case OpType::shift_left :   return "<<";
+        case OpType::shift_right :  return ">>";
+        case OpType::eq :           return "=";
+        case OpType::less :         return "<";
+        case OpType::leq :          return "<=";
+        case OpType::great :        return ">";
+        case OpType::geq :          return ">=";
+        default :                   return NULL;
+        }
+    }
+
+    void ItemOp::print(Output::Sink & out) {
+        const char * op = op_name(this->opType);
+        if (op == NULL) {
+            std::cerr << "wrong op type in ItemOp::print\n";
+            assert(0);
+            return;
+        }
+
+        this->op1->print(out);
+        out << ' ' << op << ' ';
+        this->op2->print(out);
+    }
+
+    void ItemCall::print(Output::Sink & out) {
+        out << "call ";
+        this->callee->print(out);
+        out << '(';
+        
+        for (int32_t i = 0; i < this->args.size(); i++) {
+            if (i > 0) {
+                out << ", ";
+            }
+            this->args[i]->print(out);
+        }
+        
+        out << ')';
+    }
+
+    void ItemNewArray::print(Output::Sink & out) {
+        out << "new Array(";
+        
+        for (int32_t i = 0; i < this->dims.size(); i++) {
+            if (i > 0) {
+                out << ", ";
+            }
+            this->dims[i]->print(out);
+        }
+        
+        out << ')';
+    }
+
+    void ItemNewTuple::print(Output::Sink & out) {
+        out << "new Tuple(";
+        this->len->print(out);
+        out << ')';
+    }
+
+    void ItemLength::print(Output::Sink & out) {
+        out << "length ";
+        this->addr->print(out);
+        out << ' ';
+        this->dim->print(out);
+    }
+
     /**
      * accept() for visitor
      * */
@@ -812,8 +942,8 @@ namespace IR {
     }
 
     void Program::populatePredsSuccs () {
-        for (Function * F : this->functions) {
-            F->populatePredsSuccs();
-        }
+        ThreadPool::parallel_for(this->functions.size(), [this](int32_t i) {
+            this->functions[i]->populatePredsSuccs();
+        });
     }
 }
\ No newline at end of file
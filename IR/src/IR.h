@@ -10,6 +10,8 @@
 #include <cassert>
 
 
+#include <output_sink.h>
+
 #include "utils.h"
 #include "config.h"
 
@@ -94,6 +96,11 @@ namespace IR {
         ItemType itemtype;
 
         virtual std::string to_string() = 0;
+
+        /**
+         *  same text as to_string, appended to @out without building a string
+         * */
+        virtual void print(Output::Sink & out) = 0;
         virtual void accept(ItemVisitor &) = 0;
         virtual Item * copy() = 0;
     };
@@ -108,6 +115,7 @@ namespace IR {
         void accept(ItemVisitor &visitor) override;
         ItemTypeSig * copy() override;
         std::string to_string() override;
+        void print(Output::Sink & out) override;
     };
 
 
@@ -117,6 +125,7 @@ namespace IR {
         ItemConstant(int64_t constVal);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemConstant * copy() override;
     }; 
@@ -127,6 +136,7 @@ namespace IR {
         ItemLabel(std::string str);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemLabel * copy() override;
     }; 
@@ -138,6 +148,7 @@ namespace IR {
         ItemVariable(std::string str, Item * typeSig);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemVariable * copy() override;
     };
@@ -149,6 +160,7 @@ namespace IR {
         ItemArrAccess(Item * addr, std::vector<Item *> & offsets);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemArrAccess * copy() override;
 
@@ -162,6 +174,7 @@ namespace IR {
         ItemOp(Item *op1, Item *op2, OpType opType);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemOp * copy() override;
     };
@@ -182,6 +195,7 @@ namespace IR {
         ItemCall(bool isRuntime, Item *callee, std::vector<Item *> & args);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor &visitor) override;
         ItemCall * copy() override;
 
@@ -193,6 +207,7 @@ namespace IR {
         ItemNewArray(std::vector<Item *> & dims);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemNewArray * copy() override;
 
@@ -204,6 +219,7 @@ namespace IR {
         ItemNewTuple(Item * len);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemNewTuple * copy() override;
     };
@@ -215,6 +231,7 @@ namespace IR {
         ItemLength(Item * addr, Item * dim);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemLength * copy() override;
     };
@@ -15,6 +15,8 @@
 #include "IR.h"
 #include "IRparser.h"
 #include "code_generator.h"
+#include "inliner.h"
+#include "sccp.h"
 #include "config.h"
 // #include <spiller.h>
 // #include <register_allocation.h>
@@ -52,26 +54,26 @@ int main(
         return 1;
     }
     
-    // int32_t opt;
-    // while ((opt = getopt(argc, argv, "vg:O:")) != -1) {
-    //     switch (opt){
-    //     case 'O':
-    //         optLevel = strtoul(optarg, NULL, 0);
-    //         break ;
-
-    //     case 'g':
-    //         enable_code_generator = (strtoul(optarg, NULL, 0) == 0) ? false : true ;
-    //         break ;
-
-    //     case 'v':
-    //         verbose = true;
-    //         break ;
-
-    //     default:
-    //         print_help(argv[0]);
-    //         return 1;
-    //     }
-    // }
+    int32_t opt;
+    while ((opt = getopt(argc, argv, "vg:O:")) != -1) {
+        switch (opt){
+        case 'O':
+            optLevel = strtoul(optarg, NULL, 0);
+            break ;
+
+        case 'g':
+            enable_code_generator = (strtoul(optarg, NULL, 0) == 0) ? false : true ;
+            break ;
+
+        case 'v':
+            verbose = true;
+            break ;
+
+        default:
+            print_help(argv[0]);
+            return 1;
+        }
+    }
 
     /*
     * Parse the input file.
@@ -79,6 +81,14 @@ int main(
     IR::Program p = IR::parse_file(argv[optind]);
     DEBUG_OUT << "Done: parsing!\n";
     
+    if (optLevel > 0) {
+        IR::inline_functions(p);
+        DEBUG_OUT << "Done: inlining " << IR::inlined_call_sites() << " call sites!\n";
+
+        IR::optimize_ssa(p);
+        DEBUG_OUT << "Done: SSA optimizations!\n";
+    }
+
     p.populatePredsSuccs();
     DEBUG_OUT << "Done: predsSuccs!\n";
     
@@ -5,4 +5,5 @@
 
 namespace IR {
     Program parse_file (char *fileName);
+    Program parse_input (const std::string & source, const std::string & sourceName);
 }
\ No newline at end of file
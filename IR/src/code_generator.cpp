@@ -1,4 +1,5 @@
 #include "code_generator.h"
+#include <thread_pool.h>
 
 #ifdef CODE_GEN_DEBUG
 #define DEBUG_OUT (std::cerr << "DEBUG-Code-Generator: ") // or any other ostream
@@ -54,7 +55,7 @@ namespace IR {
     }
 
     InstL3GenVisitor::InstL3GenVisitor(
-        std::ofstream * outputFile,
+        Output::Sink * outputFile,
         std::string & newVarPrefix
     ) {
         this->out = outputFile;
@@ -63,22 +64,31 @@ namespace IR {
     }
 
     void InstL3GenVisitor::visit(Instruction_label * lb) {
-        *this->out << '\t' << lb->to_string();
+        this->begin_inst();
+        lb->item_label->print(*this->out);
+        *this->out << '\n';
     }
 
     /**
     *  Terminator of Basic Block
     * */
-    void InstL3GenVisitor::visit(Instruction_ret * ret) {
-        *this->out << '\t' << ret->to_string();
+    void InstL3GenVisitor::visit(Instruction_ret *) {
+        this->begin_inst();
+        *this->out << "return\n";
     }
 
     void InstL3GenVisitor::visit(Instruction_ret_var * ret) {
-        *this->out << '\t' << ret->to_string();
+        this->begin_inst();
+        *this->out << "return ";
+        ret->valueToReturn->print(*this->out);
+        *this->out << '\n';
     }
 
     void InstL3GenVisitor::visit(Instruction_branch * br) {
-        *this->out << '\t' << br->to_string();
+        this->begin_inst();
+        *this->out << "br ";
+        br->dst->print(*this->out);
+        *this->out << '\n';
     }
 
     void InstL3GenVisitor::visit(Instruction_branch_cond * condBr) {
@@ -87,20 +97,17 @@ namespace IR {
          *  L3: br t labelT
          *      br labelF
          * */
-        std::string inst_str = "br ";
-        inst_str += condBr->condition->to_string();
-        inst_str += " ";
-        inst_str += condBr->dst1->to_string();
-        inst_str += "\n";
-
-        *this->out << '\t' << inst_str;
-
-        inst_str = "br ";
-        inst_str += condBr->dst2->to_string();
-        inst_str += "\n";
-
-        *this->out << '\t' << inst_str;
-    
+        this->begin_inst();
+        *this->out << "br ";
+        condBr->condition->print(*this->out);
+        *this->out << ' ';
+        condBr->dst1->print(*this->out);
+        *this->out << '\n';
+
+        this->begin_inst();
+        *this->out << "br ";
+        condBr->dst2->print(*this->out);
+        *this->out << '\n';
     }   
 
     /**
@@ -117,11 +124,13 @@ namespace IR {
          *  L3: call callee ( args )
          * */
 
-        *this->out << '\t' << call->to_string();
+        this->begin_inst();
+        call->call_wrap->print(*this->out);
+        *this->out << '\n';
     }
 
-    void InstL3GenVisitor::output_inst_tab(std::string & inst) {
-        *this->out << '\t' << inst;
+    void InstL3GenVisitor::begin_inst() {
+        *this->out << '\t';
     }
 
 
@@ -130,25 +139,21 @@ namespace IR {
          *  %v0 <- %v0 << 1 
          *  %v0 <- %v0 + 1
          * */
-        std::string inst = "";
-        inst += v->to_string();
-        inst += " <- ";
-        inst += v->to_string();
-        inst += " << ";
-        inst += "1";
-        inst += "\n";
-
-        this->output_inst_tab(inst);
-
-        inst.clear();
-        inst += v->to_string();
-        inst += " <- ";
-        inst += v->to_string();
-        inst += " + ";
-        inst += "1";
-        inst += "\n";
-
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        v->print(*this->out);
+        *this->out << " <- ";
+        v->print(*this->out);
+        *this->out << " << ";
+        *this->out << "1";
+        *this->out << "\n";
+
+        this->begin_inst();
+        v->print(*this->out);
+        *this->out << " <- ";
+        v->print(*this->out);
+        *this->out << " + ";
+        *this->out << "1";
+        *this->out << "\n";
     }
 
     void InstL3GenVisitor::output_newTupleInst(
@@ -160,18 +165,17 @@ namespace IR {
          * */
         ItemConstant constOne(1);
         
-        std::string inst = "";
-        inst += dst->to_string();
-        inst += " <- ";
-        inst += " call ";
-        inst += " allocate ";
-        inst += "(";
-        inst += newTuple->len->to_string();
-        inst += ", ";
-        inst += "1";
-        inst += ")";
-        inst += "\n";
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        dst->print(*this->out);
+        *this->out << " <- ";
+        *this->out << " call ";
+        *this->out << " allocate ";
+        *this->out << "(";
+        newTuple->len->print(*this->out);
+        *this->out << ", ";
+        *this->out << "1";
+        *this->out << ")";
+        *this->out << "\n";
     }
 
     void InstL3GenVisitor::output_newArrayInst(
@@ -188,7 +192,6 @@ namespace IR {
         assert(newArr->dims.size() > 0);
         
         std::vector<ItemVariable *> decoded_ndims (newArr->dims.size());
-        std::string inst = "";
 
         for (int32_t i = 0; i < newArr->dims.size(); i++) {
             ItemVariable * decoded = this->get_new_var();
@@ -197,14 +200,12 @@ namespace IR {
             /**
              *  L3: %p1D <- %p1 >> 1
              * */
-            inst.clear();
-            inst += decoded->to_string();
-            inst += " <- ";
-            inst += newArr->dims[i]->to_string();
-            inst += " >> ";
-            inst += "1\n";
-            
-            this->output_inst_tab(inst);
+            this->begin_inst();
+            decoded->print(*this->out);
+            *this->out << " <- ";
+            newArr->dims[i]->print(*this->out);
+            *this->out << " >> ";
+            *this->out << "1\n";
         }
 
         /**
@@ -214,42 +215,36 @@ namespace IR {
         /**
          *  L3: %arrTotalLength <- decoded_ndims[0]
          * */
-        inst.clear();
-        inst += arrTotalLength->to_string();
-        inst += " <- ";
-        inst += decoded_ndims[0]->to_string();
-        inst += "\n";
-        
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        arrTotalLength->print(*this->out);
+        *this->out << " <- ";
+        decoded_ndims[0]->print(*this->out);
+        *this->out << "\n";
 
         for (int32_t i = 1 ; i < decoded_ndims.size(); i++) {
             /**
              *  L3: %arrTotalLength <- %arrTotalLength * decoded_ndims[i]
              * */
-            inst.clear();
-            inst += arrTotalLength->to_string();
-            inst += " <- ";
-            inst += arrTotalLength->to_string();
-            inst += " * ";
-            inst += decoded_ndims[i]->to_string();
-            inst += "\n";
-
-            this->output_inst_tab(inst);
+            this->begin_inst();
+            arrTotalLength->print(*this->out);
+            *this->out << " <- ";
+            arrTotalLength->print(*this->out);
+            *this->out << " * ";
+            decoded_ndims[i]->print(*this->out);
+            *this->out << "\n";
         }
 
          /**
          *  L3: %arrTotalLength <- %arrTotalLength + str(ndims + 1)
          * */
         int32_t offsets = newArr->dims.size() + 1;
-        inst.clear();
-        inst += arrTotalLength->to_string();
-        inst += " <- ";
-        inst += arrTotalLength->to_string();
-        inst += " + ";
-        inst += std::to_string(offsets);
-        inst += "\n";
-
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        arrTotalLength->print(*this->out);
+        *this->out << " <- ";
+        arrTotalLength->print(*this->out);
+        *this->out << " + ";
+        *this->out << offsets;
+        *this->out << "\n";
 
         /**
          *  Encode it 
@@ -261,68 +256,63 @@ namespace IR {
         /**
          *  %a <- call allocate(%v0, 1)
          * */
-        inst.clear();
-        inst += dst->to_string();
-        inst += " <- ";
-        inst += " call ";
-        inst += " allocate ";
-        inst += "(";
-        inst += arrTotalLength->to_string();
-        inst += ", ";
-        inst += "1";
-        inst += ")";
-        inst += "\n";
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        dst->print(*this->out);
+        *this->out << " <- ";
+        *this->out << " call ";
+        *this->out << " allocate ";
+        *this->out << "(";
+        arrTotalLength->print(*this->out);
+        *this->out << ", ";
+        *this->out << "1";
+        *this->out << ")";
+        *this->out << "\n";
 
         /**
          *  %arrPtr <- src + 8
          */ 
         ItemVariable * arrPtr = this->get_new_var();
         
-        inst.clear();
-        inst += arrPtr->to_string();
-        inst += " <- ";
-        inst += dst->to_string();
-        inst += " + ";
-        inst += std::to_string(VAL_WIDTH);
-        inst += "\n";
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        arrPtr->print(*this->out);
+        *this->out << " <- ";
+        dst->print(*this->out);
+        *this->out << " + ";
+        *this->out << VAL_WIDTH;
+        *this->out << "\n";
 
         /**
          *  store %arrPtr <- str(encode(ndims)
          */ 
         int64_t ndimsEncoded = getEncoded(newArr->dims.size());
-        inst.clear();
-        inst += "store ";
-        inst += arrPtr->to_string();
-        inst += " <- ";
-        inst += std::to_string(ndimsEncoded);
-        inst += "\n";
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        *this->out << "store ";
+        arrPtr->print(*this->out);
+        *this->out << " <- ";
+        *this->out << ndimsEncoded;
+        *this->out << "\n";
 
         for (int32_t i = 0; i < newArr->dims.size(); i++) {
             /**
              *  %arrPtr <- %arrPtr + 8
              */ 
-            inst.clear();
-            inst += arrPtr->to_string();
-            inst += " <- ";
-            inst += arrPtr->to_string();
-            inst += " + ";
-            inst += std::to_string(VAL_WIDTH);
-            inst += "\n";
-            this->output_inst_tab(inst);
+            this->begin_inst();
+            arrPtr->print(*this->out);
+            *this->out << " <- ";
+            arrPtr->print(*this->out);
+            *this->out << " + ";
+            *this->out << VAL_WIDTH;
+            *this->out << "\n";
 
             /**
              *  store %arrPtr <- %p[i]
              */
-            inst.clear();
-            inst += "store ";
-            inst += arrPtr->to_string();
-            inst += " <- ";
-            inst += newArr->dims[i]->to_string();
-            inst += "\n";
-            this->output_inst_tab(inst);
+            this->begin_inst();
+            *this->out << "store ";
+            arrPtr->print(*this->out);
+            *this->out << " <- ";
+            newArr->dims[i]->print(*this->out);
+            *this->out << "\n";
         }
  
     }
@@ -354,14 +344,11 @@ namespace IR {
         assert(dst != NULL);
         assert(src != NULL);
         
-        std::string inst = "";
-
-        inst += dst->to_string();
-        inst += " <- ";
-        inst += src->to_string();
-        inst += "\n";
-
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        dst->print(*this->out);
+        *this->out << " <- ";
+        src->print(*this->out);
+        *this->out << "\n";
     }
 
     void InstL3GenVisitor::output_AssignCallInst(
@@ -371,14 +358,11 @@ namespace IR {
         assert(dst != NULL);
         assert(call != NULL);
         
-        std::string inst = "";
-
-        inst += dst->to_string();
-        inst += " <- ";
-        inst += call->to_string();
-        inst += "\n";
-
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        dst->print(*this->out);
+        *this->out << " <- ";
+        call->print(*this->out);
+        *this->out << "\n";
     }
 
     void InstL3GenVisitor::output_LoadInst(
@@ -387,13 +371,11 @@ namespace IR {
     ) {
         assert(dst != NULL);
         assert(addr != NULL);
-        std::string inst = "";
-        inst += dst->to_string();
-        inst += " <- load ";
-        inst += addr->to_string();
-        inst += "\n";
-        this->output_inst_tab(inst);
-        
+        this->begin_inst();
+        dst->print(*this->out);
+        *this->out << " <- load ";
+        addr->print(*this->out);
+        *this->out << "\n";
     }
 
     void InstL3GenVisitor::output_StoreInst(
@@ -402,13 +384,12 @@ namespace IR {
     ) {
         assert(addr != NULL);
         assert(src != NULL);
-        std::string inst = "";
-        inst += "store ";
-        inst += addr->to_string();
-        inst += " <- ";
-        inst += src->to_string();
-        inst += "\n";
-        this->output_inst_tab(inst);
+        this->begin_inst();
+        *this->out << "store ";
+        addr->print(*this->out);
+        *this->out << " <- ";
+        src->print(*this->out);
+        *this->out << "\n";
     }
 
     
@@ -846,17 +827,17 @@ namespace IR {
     /**
      *  arg0, arg1, arg2
      * */
-    void output_args_helper(std::ofstream & out, std::vector<Item *> & args) {
+    void output_args_helper(Output::Sink & out, std::vector<Item *> & args) {
         for (int32_t i = 0; i < args.size(); i++) {
             if (i > 0) {
                 out << ", ";
             }
             
-            out << args[i]->to_string(); 
+            args[i]->print(out); 
         }
     }
 
-    generateCodeForTraces::generateCodeForTraces(std::ofstream * outputFile, std::string & newVarPrefix) {
+    generateCodeForTraces::generateCodeForTraces(Output::Sink * outputFile, std::string & newVarPrefix) {
         
         this->L3InstGen = InstL3GenVisitor(outputFile, newVarPrefix);
         this->out = outputFile;
@@ -978,15 +959,31 @@ namespace IR {
 
     void generateCode(
         Program & p
+    ) {
+        Output::Sink out(1 << 20);
+
+        generateCode(p, out);
+
+        if (!out.flush("prog.L3")) {
+            std::cerr << "cannot write prog.L3\n";
+        }
+    }
+
+    void generateCode(
+        Program & p,
+        Output::Sink & out
     ) {
         std::string varPrefix = new_var_prefix(p);
 
-        std::ofstream out =  std::ofstream();
-        out.open("prog.L3");
-        
-        for (Function * F : p.functions) {
+        /**
+         *  every function has its own trace generator and new variable counter,
+         *      functions are generated in parallel and written out in program order
+         * */
+        ThreadPool::parallel_emit(p.functions.size(), out, [&](int32_t i, Output::Sink & out) {
+            Function * F = p.functions[i];
+
             out << "define ";
-            out << F->name->to_string();
+            F->name->print(out);
             
             out << "(";
             output_args_helper(out, F->arg_list);
@@ -1000,9 +997,7 @@ namespace IR {
 
             out << "}\n";
 
-        }
-
-        out.close();
+        });
 
     }
 }
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <fstream>
 #include <string>
 #include <iostream>
 
@@ -15,6 +14,19 @@
 namespace IR {
 
     void generateCode(Program & p);
+    void generateCode(Program & p, Output::Sink & out);
+
+    /**
+     *  prefix of the variables introduced while lowering to L3,
+     *      longer than every variable of @p
+     * */
+    std::string new_var_prefix(Program & p);
+
+    /**
+     *  @nextBB directly follows @curBB in a trace and only @curBB reaches it,
+     *      the terminator of @curBB and the label of @nextBB are dropped
+     * */
+    bool canMerge(BasicBlock * curBB, BasicBlock * nextBB);
 
     class InstL3GenVisitor : public InstVisitor {
         public:
@@ -36,7 +48,7 @@ namespace IR {
             void visit(Instruction_assignment *)    override;
 
             InstL3GenVisitor();
-            InstL3GenVisitor(std::ofstream * outputFile, std::string & newVarPrefix);
+            InstL3GenVisitor(Output::Sink * outputFile, std::string & newVarPrefix);
 
             void clean_new_vars();
         private:
@@ -44,13 +56,17 @@ namespace IR {
 
             
 
-            std::ofstream *out;
+            Output::Sink *out;
             std::string newVarPrefix;
             int32_t newVarIdx;
 
             std::vector<ItemVariable *> newvars;
 
-            void output_inst_tab(std::string & inst);
+            /**
+             *  start a new L3 instruction line,
+             *      the instruction is then printed item by item into @out
+             * */
+            void begin_inst();
 
             void output_encode(Item * v);
 
@@ -124,10 +140,10 @@ namespace IR {
         public:
             void generateL3code(std::vector<Trace *> & traces);
 
-            generateCodeForTraces(std::ofstream * outputFile, std::string & newVarPrefix);
+            generateCodeForTraces(Output::Sink * outputFile, std::string & newVarPrefix);
 
         private:
             InstL3GenVisitor L3InstGen;
-            std::ofstream *out;
+            Output::Sink *out;
     }; 
 }
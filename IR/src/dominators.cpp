@@ -0,0 +1,174 @@
+#include <algorithm>
+
+#include "dominators.h"
+
+#ifdef DOMINATORS_DEBUG
+#define DEBUG_OUT (std::cerr << "DEBUG-Dominators: ") // or any other ostream
+#else
+#define DEBUG_OUT 0 && std::cerr
+#endif
+
+
+namespace IR {
+
+    /**
+     *  labels the terminator of @BB branches to, in the order they are written
+     * */
+    static std::vector<Item *> branch_targets(BasicBlock * BB) {
+        Instruction_terminator * te = BB->te;
+
+        if (te->type == InstType::inst_branch) {
+            return {((Instruction_branch *) te)->dst};
+        }
+
+        if (te->type == InstType::inst_branch_cond) {
+            Instruction_branch_cond * br = (Instruction_branch_cond *) te;
+            return {br->dst1, br->dst2};
+        }
+
+        return {};
+    }
+
+    DominatorTree::DominatorTree(Function * F) {
+        for (BasicBlock * BB : F->BasicBlocks) {
+            this->label2BB[(ItemLabel *) BB->label->item_label] = BB;
+        }
+
+        this->number_blocks(F);
+        this->find_idoms();
+        this->find_frontiers();
+    }
+
+    bool DominatorTree::reachable(BasicBlock * BB) {
+        return IN_MAP(this->index, BB);
+    }
+
+    int32_t DominatorTree::target(Item * label) {
+        assert(label->itemtype == ItemType::item_labels);
+        return this->index[this->label2BB[(ItemLabel *) label]];
+    }
+
+    void DominatorTree::number_blocks(Function * F) {
+        /**
+         *  depth first search from the entry block, without recursion
+         * */
+        std::vector<BasicBlock *> postorder;
+        std::set<BasicBlock *> visited;
+        std::vector<std::pair<BasicBlock *, size_t>> stack;
+
+        BasicBlock * entry = F->BasicBlocks[0];
+        visited.insert(entry);
+        stack.push_back({entry, 0});
+
+        while (!stack.empty()) {
+            BasicBlock * BB = stack.back().first;
+            std::vector<Item *> targets = branch_targets(BB);
+            size_t & next = stack.back().second;
+
+            if (next == targets.size()) {
+                postorder.push_back(BB);
+                stack.pop_back();
+                continue;
+            }
+
+            BasicBlock * succ = this->label2BB[(ItemLabel *) targets[next]];
+            next++;
+            if (!IN_SET(visited, succ)) {
+                visited.insert(succ);
+                stack.push_back({succ, 0});
+            }
+        }
+
+        this->order.assign(postorder.rbegin(), postorder.rend());
+        for (int32_t i = 0; i < (int32_t) this->order.size(); i++) {
+            this->index[this->order[i]] = i;
+        }
+
+        this->succs.resize(this->order.size());
+        this->preds.resize(this->order.size());
+        for (int32_t i = 0; i < (int32_t) this->order.size(); i++) {
+            for (Item * label : branch_targets(this->order[i])) {
+                int32_t s = this->target(label);
+
+                /**
+                 *  br %c :l :l
+                 * */
+                if (std::find(this->succs[i].begin(), this->succs[i].end(), s) != this->succs[i].end()) continue;
+
+                this->succs[i].push_back(s);
+                this->preds[s].push_back(i);
+            }
+        }
+    }
+
+    int32_t DominatorTree::intersect(int32_t b1, int32_t b2) {
+        while (b1 != b2) {
+            while (b1 > b2) b1 = this->idom[b1];
+            while (b2 > b1) b2 = this->idom[b2];
+        }
+
+        return b1;
+    }
+
+    void DominatorTree::find_idoms() {
+        /**
+         *  Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+         *      -1 marks a block not processed yet
+         * */
+        int32_t n = this->order.size();
+        this->idom.assign(n, -1);
+        this->idom[0] = 0;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+
+            for (int32_t b = 1; b < n; b++) {
+                int32_t newIdom = -1;
+                for (int32_t p : this->preds[b]) {
+                    if (this->idom[p] == -1) continue;
+                    newIdom = newIdom == -1 ? p : this->intersect(p, newIdom);
+                }
+
+                if (newIdom != this->idom[b]) {
+                    this->idom[b] = newIdom;
+                    changed = true;
+                }
+            }
+        }
+
+        this->children.resize(n);
+        for (int32_t b = 1; b < n; b++) {
+            this->children[this->idom[b]].push_back(b);
+        }
+    }
+
+    void DominatorTree::find_frontiers() {
+        int32_t n = this->order.size();
+        this->frontier.resize(n);
+
+        for (int32_t b = 1; b < n; b++) {
+            if (this->preds[b].size() < 2) continue;
+
+            for (int32_t p : this->preds[b]) {
+                for (int32_t runner = p; runner != this->idom[b]; runner = this->idom[runner]) {
+                    this->frontier[runner].insert(b);
+                }
+            }
+        }
+
+        /**
+         *  entering the function is one more edge into the entry block,
+         *      so a branch back to it makes it a join point of everything on the way
+         * */
+        for (int32_t p : this->preds[0]) {
+            for (int32_t runner = p; ; runner = this->idom[runner]) {
+                this->frontier[runner].insert(0);
+                if (runner == 0) break;
+            }
+        }
+
+        DEBUG_OUT << n << " blocks reachable\n";
+    }
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "IR.h"
+
+namespace IR {
+
+    /**
+     *  Dominator tree and dominance frontiers of a function
+     *      blocks are numbered in reverse postorder from the entry block,
+     *      blocks the entry cannot reach get no number and are left out
+     *  successors are read from the terminators, so preds and succs of BasicBlock are not needed
+     * */
+    struct DominatorTree {
+        std::vector<BasicBlock *> order;
+        std::unordered_map<BasicBlock *, int32_t> index;
+        std::map<ItemLabel *, BasicBlock *> label2BB;
+
+        std::vector<std::vector<int32_t>> succs;
+        std::vector<std::vector<int32_t>> preds;
+
+        /**
+         *  idom[0] == 0, the entry block has no dominator but itself
+         * */
+        std::vector<int32_t> idom;
+        std::vector<std::vector<int32_t>> children;
+        std::vector<std::set<int32_t>> frontier;
+
+        DominatorTree(Function * F);
+
+        bool reachable(BasicBlock * BB);
+
+        /**
+         *  block a branch to @label goes to
+         * */
+        int32_t target(Item * label);
+
+        private:
+            void number_blocks(Function * F);
+            void find_idoms();
+            void find_frontiers();
+            int32_t intersect(int32_t b1, int32_t b2);
+    };
+
+}
@@ -0,0 +1,409 @@
+#include <unordered_map>
+
+#include "inliner.h"
+
+#ifdef INLINER_DEBUG
+#define DEBUG_OUT (std::cerr << "DEBUG-Inliner: ") // or any other ostream
+#else
+#define DEBUG_OUT 0 && std::cerr
+#endif
+
+
+namespace IR {
+
+    /**
+     *  sizes count instructions, every basic block counts its terminator too
+     *      INLINE_ALWAYS_SIZE      callees this small are inlined at every call site
+     *      INLINE_ONCE_SIZE        callees called from a single site are inlined up to this size
+     *      CALLER_SIZE_LIMIT       no caller grows beyond this by inlining
+     * */
+    const int64_t INLINE_ALWAYS_SIZE = 12;
+    const int64_t INLINE_ONCE_SIZE = 60;
+    const int64_t CALLER_SIZE_LIMIT = 2000;
+
+    static int64_t inlinedSites = 0;
+
+    int64_t inlined_call_sites() {
+        return inlinedSites;
+    }
+
+    static int64_t function_size(Function * F) {
+        int64_t size = 0;
+        for (BasicBlock * BB : F->BasicBlocks) {
+            size += BB->insts.size() + 1;
+        }
+
+        return size;
+    }
+
+    /**
+     *  the call of @inst when it calls a user function by its label,
+     *      NULL for anything else, including calls through a variable
+     * */
+    static ItemCall * direct_call(Instruction * inst) {
+        Item * wrap = NULL;
+        if (inst->type == InstType::inst_call) {
+            wrap = ((Instruction_call *) inst)->call_wrap;
+        } else if (inst->type == InstType::inst_assign) {
+            wrap = ((Instruction_assignment *) inst)->src;
+        }
+
+        if (wrap == NULL || wrap->itemtype != ItemType::item_call) {
+            return NULL;
+        }
+
+        ItemCall * call = (ItemCall *) wrap;
+        if (call->isRuntime || call->callee->itemtype != ItemType::item_labels) {
+            return NULL;
+        }
+
+        return call;
+    }
+
+    static bool calls_itself(Function * F) {
+        for (BasicBlock * BB : F->BasicBlocks) {
+            for (Instruction_normal * inst : BB->insts) {
+                ItemCall * call = direct_call(inst);
+                if (call != NULL && ((ItemLabel *) call->callee)->labelName == F->name->labelName) {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     *  fresh variable and label names,
+     *      longer than every name of the program so nothing can clash with them
+     * */
+    struct NameSource {
+        std::string varPrefix;
+        std::string labelPrefix;
+        int64_t next;
+
+        NameSource(Program & p) {
+            std::string longestVar = "%";
+            std::string longestLabel = ":";
+
+            for (Function * F : p.functions) {
+                for (auto & kv : F->varName2ptr) {
+                    if (kv.first.length() > longestVar.length()) longestVar = kv.first;
+                }
+                for (auto & kv : F->labelName2ptr) {
+                    if (kv.first.length() > longestLabel.length()) longestLabel = kv.first;
+                }
+            }
+
+            this->varPrefix = longestVar + "_inl_";
+            this->labelPrefix = longestLabel + "_inl_";
+            this->next = 0;
+        }
+
+        ItemVariable * new_var(Function * F, Item * typeSig) {
+            std::string name = this->varPrefix + std::to_string(this->next++);
+            ItemVariable * v = new ItemVariable(name, typeSig);
+            F->varName2ptr[name] = v;
+
+            return v;
+        }
+
+        ItemLabel * new_label(Function * F) {
+            std::string name = this->labelPrefix + std::to_string(this->next++);
+            ItemLabel * l = new ItemLabel(name);
+            F->labelName2ptr[name] = l;
+            F->Instlabels.insert(l);
+
+            return l;
+        }
+    };
+
+    /**
+     *  copies instructions of @callee into @caller
+     *      variables and basic block labels of @callee get fresh names,
+     *      function labels are those of @caller with the same name
+     * */
+    class InlineCloner {
+        public:
+            InlineCloner(Function * caller, Function * callee, NameSource & names)
+                : caller(caller), names(names) {
+                for (BasicBlock * BB : callee->BasicBlocks) {
+                    ItemLabel * l = (ItemLabel *) BB->label->item_label;
+                    this->labels[l] = names.new_label(caller);
+                }
+            }
+
+            Item * clone(Item * it) {
+                switch (it->itemtype) {
+                    case ItemType::item_type_sig:
+                        return it;
+
+                    case ItemType::item_constant:
+                        return it->copy();
+
+                    case ItemType::item_labels:
+                        return this->clone_label((ItemLabel *) it);
+
+                    case ItemType::item_variable:
+                    {
+                        ItemVariable * v = (ItemVariable *) it;
+                        if (!IN_MAP(this->vars, v)) {
+                            this->vars[v] = this->names.new_var(this->caller, v->typeSig);
+                        }
+                        return this->vars[v];
+                    }
+
+                    case ItemType::item_ArrAccess:
+                    {
+                        ItemArrAccess * access = (ItemArrAccess *) it;
+                        std::vector<Item *> offsets = this->clone_all(access->offsets);
+                        return new ItemArrAccess(this->clone(access->addr), offsets);
+                    }
+
+                    case ItemType::item_op:
+                    {
+                        ItemOp * op = (ItemOp *) it;
+                        return new ItemOp(this->clone(op->op1), this->clone(op->op2), op->opType);
+                    }
+
+                    case ItemType::item_newArr:
+                    {
+                        std::vector<Item *> dims = this->clone_all(((ItemNewArray *) it)->dims);
+                        return new ItemNewArray(dims);
+                    }
+
+                    case ItemType::item_newTuple:
+                        return new ItemNewTuple(this->clone(((ItemNewTuple *) it)->len));
+
+                    case ItemType::item_call:
+                    {
+                        ItemCall * call = (ItemCall *) it;
+                        std::vector<Item *> args = this->clone_all(call->args);
+                        return new ItemCall(call->isRuntime, this->clone(call->callee), args);
+                    }
+
+                    case ItemType::item_length:
+                    {
+                        ItemLength * len = (ItemLength *) it;
+                        return new ItemLength(this->clone(len->addr), this->clone(len->dim));
+                    }
+                }
+
+                assert(false && "unknown item");
+                return NULL;
+            }
+
+            Instruction_normal * clone(Instruction_normal * inst) {
+                switch (inst->type) {
+                    case InstType::inst_declare:
+                    {
+                        Instruction_declare * declare = (Instruction_declare *) inst;
+                        return new Instruction_declare(declare->typeSig, this->clone(declare->var));
+                    }
+
+                    case InstType::inst_call:
+                        return new Instruction_call(this->clone(((Instruction_call *) inst)->call_wrap));
+
+                    case InstType::inst_assign:
+                    {
+                        Instruction_assignment * assign = (Instruction_assignment *) inst;
+                        return new Instruction_assignment(this->clone(assign->src), this->clone(assign->dst));
+                    }
+
+                    default:
+                        break;
+                }
+
+                assert(false && "not a normal instruction");
+                return NULL;
+            }
+
+            /**
+             *  branches only, returns are rewritten by the caller of the cloner
+             * */
+            Instruction_terminator * clone(Instruction_terminator * te) {
+                if (te->type == InstType::inst_branch) {
+                    return new Instruction_branch(this->clone(((Instruction_branch *) te)->dst));
+                }
+
+                assert(te->type == InstType::inst_branch_cond);
+                Instruction_branch_cond * br = (Instruction_branch_cond *) te;
+                return new Instruction_branch_cond(
+                    this->clone(br->dst1),
+                    this->clone(br->dst2),
+                    this->clone(br->condition)
+                );
+            }
+
+        private:
+            Function * caller;
+            NameSource & names;
+            std::unordered_map<ItemVariable *, ItemVariable *> vars;
+            std::unordered_map<ItemLabel *, ItemLabel *> labels;
+
+            std::vector<Item *> clone_all(std::vector<Item *> & items) {
+                std::vector<Item *> cloned;
+                for (Item * it : items) {
+                    cloned.push_back(this->clone(it));
+                }
+
+                return cloned;
+            }
+
+            Item * clone_label(ItemLabel * l) {
+                /**
+                 *  print, input, tensor-error
+                 * */
+                if (isRuntimeLabel(l)) {
+                    return l;
+                }
+
+                if (IN_MAP(this->labels, l)) {
+                    return this->labels[l];
+                }
+
+                if (!IN_MAP(this->caller->labelName2ptr, l->labelName)) {
+                    this->caller->labelName2ptr[l->labelName] = new ItemLabel(l->labelName);
+                }
+                return this->caller->labelName2ptr[l->labelName];
+            }
+    };
+
+    /**
+     *  replace the call BasicBlocks[@b]->insts[@i] of @caller by the body of @callee
+     *      the instructions after the call move to a new continuation block,
+     *      the copies of the blocks of @callee come right before it
+     *  returns the index of the continuation block
+     * */
+    static size_t inline_call(Function * caller, size_t b, size_t i, Function * callee, NameSource & names) {
+        BasicBlock * BB = caller->BasicBlocks[b];
+        Instruction_normal * inst = BB->insts[i];
+        ItemCall * call = direct_call(inst);
+        Item * dst = inst->type == InstType::inst_assign ? ((Instruction_assignment *) inst)->dst : NULL;
+
+        BasicBlock * cont = new BasicBlock();
+        cont->label = new Instruction_label(names.new_label(caller));
+        cont->te = BB->te;
+        cont->insts.assign(BB->insts.begin() + i + 1, BB->insts.end());
+        BB->insts.resize(i);
+
+        InlineCloner cloner(caller, callee, names);
+
+        /**
+         *  parameters become fresh variables holding the arguments
+         * */
+        for (size_t j = 0; j < callee->arg_list.size(); j++) {
+            ItemVariable * param = (ItemVariable *) cloner.clone(callee->arg_list[j]);
+            BB->insts.push_back(new Instruction_declare(param->typeSig, param));
+            BB->insts.push_back(new Instruction_assignment(call->args[j], param));
+        }
+        BB->te = new Instruction_branch(cloner.clone(callee->BasicBlocks[0]->label->item_label));
+
+        std::vector<BasicBlock *> body;
+        for (BasicBlock * CB : callee->BasicBlocks) {
+            BasicBlock * NB = new BasicBlock();
+            NB->label = new Instruction_label(cloner.clone(CB->label->item_label));
+
+            for (Instruction_normal * ci : CB->insts) {
+                NB->insts.push_back(cloner.clone(ci));
+            }
+
+            switch (CB->te->type) {
+                case InstType::inst_ret_var:
+                    if (dst != NULL) {
+                        Item * value = cloner.clone(((Instruction_ret_var *) CB->te)->valueToReturn);
+                        NB->insts.push_back(new Instruction_assignment(value, dst));
+                    }
+                    NB->te = new Instruction_branch(cont->label->item_label);
+                    break;
+
+                case InstType::inst_ret:
+                    NB->te = new Instruction_branch(cont->label->item_label);
+                    break;
+
+                default:
+                    NB->te = cloner.clone(CB->te);
+                    break;
+            }
+
+            body.push_back(NB);
+        }
+        body.push_back(cont);
+
+        caller->BasicBlocks.insert(caller->BasicBlocks.begin() + b + 1, body.begin(), body.end());
+
+        DEBUG_OUT << "inlined " << callee->name->labelName << " into " << caller->name->labelName << "\n";
+        return b + body.size();
+    }
+
+    void inline_functions(Program & p) {
+        std::unordered_map<std::string, Function *> name2F;
+        for (Function * F : p.functions) {
+            name2F[F->name->labelName] = F;
+        }
+
+        /**
+         *  static call sites of each function in the program as parsed
+         * */
+        std::unordered_map<Function *, int64_t> callSites;
+        for (Function * F : p.functions) {
+            for (BasicBlock * BB : F->BasicBlocks) {
+                for (Instruction_normal * inst : BB->insts) {
+                    ItemCall * call = direct_call(inst);
+                    if (call == NULL) continue;
+
+                    std::string & name = ((ItemLabel *) call->callee)->labelName;
+                    if (IN_MAP(name2F, name)) {
+                        callSites[name2F[name]]++;
+                    }
+                }
+            }
+        }
+
+        NameSource names(p);
+
+        for (Function * F : p.functions) {
+            int64_t callerSize = function_size(F);
+
+            /**
+             *  blocks copied in by inline_call are skipped,
+             *      the calls they hold were not call sites of the original program
+             * */
+            size_t b = 0;
+            while (b < F->BasicBlocks.size()) {
+                BasicBlock * BB = F->BasicBlocks[b];
+                bool inlined = false;
+
+                for (size_t i = 0; i < BB->insts.size(); i++) {
+                    ItemCall * call = direct_call(BB->insts[i]);
+                    if (call == NULL) continue;
+
+                    std::string & name = ((ItemLabel *) call->callee)->labelName;
+                    if (!IN_MAP(name2F, name)) continue;
+
+                    Function * callee = name2F[name];
+                    if (callee == F || callee->arg_list.size() != call->args.size()) continue;
+
+                    int64_t calleeSize = function_size(callee);
+                    bool small = calleeSize <= INLINE_ALWAYS_SIZE;
+                    bool once = callSites[callee] == 1 && calleeSize <= INLINE_ONCE_SIZE;
+
+                    if (!small && !once) continue;
+                    if (callerSize + calleeSize > CALLER_SIZE_LIMIT) continue;
+                    if (calls_itself(callee)) continue;
+
+                    b = inline_call(F, b, i, callee, names);
+                    callerSize += calleeSize;
+                    inlinedSites++;
+                    inlined = true;
+                    break;
+                }
+
+                if (!inlined) {
+                    b++;
+                }
+            }
+        }
+    }
+
+}
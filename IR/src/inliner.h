@@ -0,0 +1,25 @@
+#pragma once
+
+#include "IR.h"
+
+namespace IR {
+
+    /**
+     *  Inline calls to small functions
+     *      a direct call to a user function is replaced by a copy of the callee's basic blocks
+     *      when the callee is small, or called from one site only and not much larger
+     *  every variable and label of the copy gets a fresh name in the caller,
+     *  the arguments are assigned to the copies of the parameters,
+     *  return becomes a branch to a continuation block holding the rest of the calling block
+     *  only the call sites the program started with are considered,
+     *  so (mutually) recursive functions are unrolled once at most
+     *  must run before populatePredsSuccs
+     * */
+    void inline_functions(Program & p);
+
+    /**
+     *  how many call sites inline_functions replaced so far
+     * */
+    int64_t inlined_call_sites();
+
+}
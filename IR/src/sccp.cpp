@@ -0,0 +1,440 @@
+#include <atomic>
+#include <unordered_set>
+
+#include <thread_pool.h>
+
+#include "sccp.h"
+
+#ifdef SCCP_DEBUG
+#define DEBUG_OUT (std::cerr << "DEBUG-SCCP: ") // or any other ostream
+#else
+#define DEBUG_OUT 0 && std::cerr
+#endif
+
+
+namespace IR {
+
+    static struct {
+        std::atomic<int64_t> constantUses;
+        std::atomic<int64_t> foldedBranches;
+        std::atomic<int64_t> deadBlocks;
+        std::atomic<int64_t> deadInsts;
+    } stats;
+
+    enum LatticeLevel {
+        lattice_top,        /* no executable definition seen yet */
+        lattice_const,
+        lattice_bottom      /* not a constant */
+    };
+
+    struct LatticeValue {
+        LatticeLevel level;
+        int64_t c;
+
+        bool operator!=(const LatticeValue & other) const {
+            return this->level != other.level || (this->level == lattice_const && this->c != other.c);
+        }
+    };
+
+    static const LatticeValue TOP = {lattice_top, 0};
+    static const LatticeValue BOTTOM = {lattice_bottom, 0};
+
+    static LatticeValue constant(int64_t c) {
+        return {lattice_const, c};
+    }
+
+    static LatticeValue meet(LatticeValue a, LatticeValue b) {
+        if (a.level == lattice_top) return b;
+        if (b.level == lattice_top) return a;
+        if (a.level == lattice_bottom || b.level == lattice_bottom || a.c != b.c) return BOTTOM;
+        return a;
+    }
+
+    /**
+     *  @a op @b as the generated x86 code computes it:
+     *      wrapping arithmetic, shift counts taken modulo 64, arithmetic right shifts
+     * */
+    static bool fold(OpType op, int64_t a, int64_t b, int64_t & result) {
+        uint64_t ua = a, ub = b;
+
+        switch (op) {
+            case OpType::plus:          result = ua + ub;           return true;
+            case OpType::minus:         result = ua - ub;           return true;
+            case OpType::times:         result = ua * ub;           return true;
+            case OpType::bit_and:       result = a & b;             return true;
+            case OpType::shift_left:    result = ua << (b & 63);    return true;
+            case OpType::shift_right:   result = a >> (b & 63);     return true;
+            case OpType::less:          result = a < b;             return true;
+            case OpType::leq:           result = a <= b;            return true;
+            case OpType::eq:            result = a == b;            return true;
+            case OpType::great:         result = a > b;             return true;
+            case OpType::geq:           result = a >= b;            return true;
+            default:                    return false;
+        }
+    }
+
+    /**
+     *  where a version is read: a phi, or an instruction (terminators included)
+     * */
+    struct UseSite {
+        int32_t block;
+        Phi * phi;
+        Instruction * inst;
+    };
+
+    class ConstantPropagation {
+        public:
+            ConstantPropagation(SSAFunction * ssa) : ssa(ssa), dom(*ssa->dom) {
+                this->executable.assign(this->dom.order.size(), false);
+                this->find_uses();
+            }
+
+            void run() {
+                this->add_edge(-1, 0);
+
+                while (!this->cfgWork.empty() || !this->ssaWork.empty()) {
+                    if (!this->cfgWork.empty()) {
+                        std::pair<int32_t, int32_t> edge = this->cfgWork.back();
+                        this->cfgWork.pop_back();
+                        this->visit_edge(edge.first, edge.second);
+                        continue;
+                    }
+
+                    ItemVariable * v = this->ssaWork.back();
+                    this->ssaWork.pop_back();
+
+                    for (UseSite & site : this->uses[v]) {
+                        if (!this->executable[site.block]) continue;
+
+                        if (site.phi != NULL) {
+                            this->visit_phi(site.block, site.phi);
+                        } else {
+                            this->visit_inst(site.block, site.inst);
+                        }
+                    }
+                }
+            }
+
+            void rewrite() {
+                Function * F = this->ssa->F;
+
+                for (int32_t b = 0; b < (int32_t) this->dom.order.size(); b++) {
+                    if (!this->executable[b]) continue;
+                    BasicBlock * BB = this->dom.order[b];
+
+                    auto use_constant = [this](Item * & it, bool isValue) {
+                        LatticeValue val = this->value(it);
+                        if (isValue && val.level == lattice_const) {
+                            it = new ItemConstant(val.c);
+                            stats.constantUses++;
+                        }
+                    };
+
+                    for (Instruction_normal * inst : BB->insts) {
+                        ItemVariable * v = defined_var(inst);
+                        Instruction_assignment * assign = (Instruction_assignment *) inst;
+
+                        if (v != NULL && this->value(v).level == lattice_const && assign->src->itemtype != ItemType::item_constant) {
+                            assign->src = new ItemConstant(this->value(v).c);
+                            stats.constantUses++;
+                            continue;
+                        }
+
+                        for_each_use(inst, use_constant);
+                    }
+
+                    if (BB->te->type == InstType::inst_branch_cond) {
+                        Instruction_branch_cond * br = (Instruction_branch_cond *) BB->te;
+                        LatticeValue cond = this->value(br->condition);
+
+                        if (cond.level == lattice_const) {
+                            BB->te = new Instruction_branch(cond.c == 1 ? br->dst1 : br->dst2);
+                            stats.foldedBranches++;
+                        }
+                    } else {
+                        for_each_use(BB->te, use_constant);
+                    }
+                }
+
+                /**
+                 *  blocks the entry cannot reach are dead as well
+                 * */
+                std::vector<BasicBlock *> live;
+                for (BasicBlock * BB : F->BasicBlocks) {
+                    if (this->dom.reachable(BB) && this->executable[this->dom.index[BB]]) {
+                        live.push_back(BB);
+                    } else {
+                        this->ssa->phis.erase(BB);
+                        stats.deadBlocks++;
+                    }
+                }
+                F->BasicBlocks = live;
+            }
+
+        private:
+            SSAFunction * ssa;
+            DominatorTree & dom;
+
+            std::unordered_map<ItemVariable *, LatticeValue> values;
+            std::unordered_map<ItemVariable *, std::vector<UseSite>> uses;
+
+            std::vector<bool> executable;
+            std::set<std::pair<int32_t, int32_t>> executableEdges;
+            std::vector<std::pair<int32_t, int32_t>> cfgWork;
+            std::vector<ItemVariable *> ssaWork;
+
+            void find_uses() {
+                for (int32_t b = 0; b < (int32_t) this->dom.order.size(); b++) {
+                    BasicBlock * BB = this->dom.order[b];
+
+                    for (Phi * phi : this->ssa->phis[BB]) {
+                        for (auto & kv : phi->args) {
+                            if (kv.second->itemtype == ItemType::item_variable) {
+                                this->uses[(ItemVariable *) kv.second].push_back({b, phi, NULL});
+                            }
+                        }
+                    }
+
+                    auto add_use = [this, b](Instruction * inst) {
+                        for_each_use(inst, [this, b, inst](Item * & it, bool) {
+                            this->uses[(ItemVariable *) it].push_back({b, NULL, inst});
+                        });
+                    };
+
+                    for (Instruction_normal * inst : BB->insts) {
+                        add_use(inst);
+                    }
+                    add_use(BB->te);
+                }
+            }
+
+            /**
+             *  the variables of the original program hold parameters or garbage
+             * */
+            LatticeValue value(Item * it) {
+                switch (it->itemtype) {
+                    case ItemType::item_constant:
+                        return constant(((ItemConstant *) it)->constVal);
+
+                    case ItemType::item_variable:
+                    {
+                        ItemVariable * v = (ItemVariable *) it;
+                        if (!this->ssa->is_version(v)) return BOTTOM;
+                        return IN_MAP(this->values, v) ? this->values[v] : TOP;
+                    }
+
+                    default:
+                        return BOTTOM;
+                }
+            }
+
+            LatticeValue evaluate(Item * src) {
+                if (src->itemtype != ItemType::item_op) {
+                    return this->value(src);
+                }
+
+                ItemOp * op = (ItemOp *) src;
+                LatticeValue a = this->value(op->op1);
+                LatticeValue b = this->value(op->op2);
+
+                if (a.level == lattice_bottom || b.level == lattice_bottom) return BOTTOM;
+                if (a.level == lattice_top || b.level == lattice_top) return TOP;
+
+                int64_t result;
+                if (!fold(op->opType, a.c, b.c, result)) return BOTTOM;
+                return constant(result);
+            }
+
+            void lower(ItemVariable * v, LatticeValue val) {
+                LatticeValue old = this->value(v);
+                LatticeValue merged = meet(old, val);
+
+                if (merged != old) {
+                    this->values[v] = merged;
+                    this->ssaWork.push_back(v);
+                }
+            }
+
+            void add_edge(int32_t from, int32_t to) {
+                if (!IN_SET(this->executableEdges, std::make_pair(from, to))) {
+                    this->cfgWork.push_back({from, to});
+                }
+            }
+
+            void visit_edge(int32_t from, int32_t to) {
+                if (!this->executableEdges.insert({from, to}).second) return;
+
+                BasicBlock * BB = this->dom.order[to];
+                for (Phi * phi : this->ssa->phis[BB]) {
+                    this->visit_phi(to, phi);
+                }
+
+                if (this->executable[to]) return;
+                this->executable[to] = true;
+
+                for (Instruction_normal * inst : BB->insts) {
+                    this->visit_inst(to, inst);
+                }
+                this->visit_inst(to, BB->te);
+            }
+
+            void visit_phi(int32_t b, Phi * phi) {
+                LatticeValue val = TOP;
+
+                for (auto & kv : phi->args) {
+                    int32_t from = kv.first == NULL ? -1 : this->dom.index[kv.first];
+                    if (IN_SET(this->executableEdges, std::make_pair(from, b))) {
+                        val = meet(val, this->value(kv.second));
+                    }
+                }
+
+                this->lower(phi->dst, val);
+            }
+
+            void visit_inst(int32_t b, Instruction * inst) {
+                switch (inst->type) {
+                    case InstType::inst_assign:
+                    {
+                        ItemVariable * v = defined_var(inst);
+                        if (v != NULL) {
+                            this->lower(v, this->evaluate(((Instruction_assignment *) inst)->src));
+                        }
+                        break;
+                    }
+
+                    case InstType::inst_branch:
+                        this->add_edge(b, this->dom.target(((Instruction_branch *) inst)->dst));
+                        break;
+
+                    case InstType::inst_branch_cond:
+                    {
+                        Instruction_branch_cond * br = (Instruction_branch_cond *) inst;
+                        LatticeValue cond = this->value(br->condition);
+
+                        /**
+                         *  br t :l1 :l2 goes to :l1 when t is 1 (cjump t = 1 in L2)
+                         * */
+                        if (cond.level == lattice_const) {
+                            this->add_edge(b, this->dom.target(cond.c == 1 ? br->dst1 : br->dst2));
+                        } else if (cond.level == lattice_bottom) {
+                            this->add_edge(b, this->dom.target(br->dst1));
+                            this->add_edge(b, this->dom.target(br->dst2));
+                        }
+                        break;
+                    }
+
+                    default:
+                        break;
+                }
+            }
+    };
+
+    void propagate_constants(SSAFunction * ssa) {
+        ConstantPropagation cp(ssa);
+        cp.run();
+        cp.rewrite();
+    }
+
+    /**
+     *  reading @src can have an effect of its own, or fail
+     * */
+    static bool has_effect(Item * src) {
+        switch (src->itemtype) {
+            case ItemType::item_call:
+            case ItemType::item_newArr:
+            case ItemType::item_newTuple:
+            case ItemType::item_ArrAccess:
+            case ItemType::item_length:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    void eliminate_dead_code(SSAFunction * ssa) {
+        Function * F = ssa->F;
+
+        std::unordered_map<ItemVariable *, Instruction_assignment *> defs;
+        std::unordered_map<ItemVariable *, Phi *> phiDefs;
+        for (BasicBlock * BB : F->BasicBlocks) {
+            for (Phi * phi : ssa->phis[BB]) {
+                phiDefs[phi->dst] = phi;
+            }
+            for (Instruction_normal * inst : BB->insts) {
+                ItemVariable * v = defined_var(inst);
+                if (v != NULL) defs[v] = (Instruction_assignment *) inst;
+            }
+        }
+
+        std::unordered_set<ItemVariable *> live;
+        std::vector<ItemVariable *> work;
+        auto mark = [&](Item * & it, bool) {
+            ItemVariable * v = (ItemVariable *) it;
+            if (live.insert(v).second) work.push_back(v);
+        };
+
+        for (BasicBlock * BB : F->BasicBlocks) {
+            for (Instruction_normal * inst : BB->insts) {
+                ItemVariable * v = defined_var(inst);
+                if (v == NULL || has_effect(((Instruction_assignment *) inst)->src)) {
+                    for_each_use(inst, mark);
+                }
+            }
+            for_each_use(BB->te, mark);
+        }
+
+        while (!work.empty()) {
+            ItemVariable * v = work.back();
+            work.pop_back();
+
+            if (IN_MAP(defs, v)) {
+                for_each_use(defs[v], mark);
+            } else if (IN_MAP(phiDefs, v)) {
+                for (auto & kv : phiDefs[v]->args) {
+                    if (kv.second->itemtype == ItemType::item_variable) {
+                        mark(kv.second, true);
+                    }
+                }
+            }
+        }
+
+        for (BasicBlock * BB : F->BasicBlocks) {
+            std::vector<Instruction_normal *> kept;
+
+            for (Instruction_normal * inst : BB->insts) {
+                ItemVariable * v = defined_var(inst);
+                if (v != NULL && !IN_SET(live, v) && !has_effect(((Instruction_assignment *) inst)->src)) {
+                    stats.deadInsts++;
+                    continue;
+                }
+                kept.push_back(inst);
+            }
+
+            BB->insts = kept;
+        }
+    }
+
+    void optimize_ssa(Program & p) {
+        ThreadPool::parallel_for(p.functions.size(), [&p](int32_t i) {
+            Function * F = p.functions[i];
+
+            SSAFunction * ssa = construct_ssa(F);
+            propagate_constants(ssa);
+            eliminate_dead_code(ssa);
+            destruct_ssa(ssa);
+
+            DEBUG_OUT << F->name->labelName << " optimized\n";
+            delete ssa->dom;
+            delete ssa;
+        });
+    }
+
+    void print_ssa_stats(std::ostream & out) {
+        out << "ssa constant uses: " << stats.constantUses << '\n';
+        out << "ssa folded branches: " << stats.foldedBranches << '\n';
+        out << "ssa dead blocks: " << stats.deadBlocks << '\n';
+        out << "ssa dead instructions: " << stats.deadInsts << '\n';
+    }
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ostream>
+
+#include "IR.h"
+#include "ssa.h"
+
+namespace IR {
+
+    /**
+     *  Sparse conditional constant propagation (Wegman and Zadeck)
+     *      a version is constant until some executable definition proves otherwise,
+     *      a block is dead until some executable edge reaches it
+     *  then uses of constant versions become constants, conditional branches
+     *  on constants become plain branches and blocks that never execute are deleted
+     *  array addresses and callees stay variables
+     * */
+    void propagate_constants(SSAFunction * ssa);
+
+    /**
+     *  Delete assignments whose value is never needed
+     *      calls, stores, returns and branches are needed,
+     *      so is whatever they read, transitively through definitions and phis;
+     *  allocations and memory reads are kept as they can fail at run time
+     * */
+    void eliminate_dead_code(SSAFunction * ssa);
+
+    /**
+     *  SSA construction, constant propagation, dead code elimination
+     *      and destruction over every function of @p
+     *  leaves preds and succs of every basic block up to date
+     * */
+    void optimize_ssa(Program & p);
+
+    void print_ssa_stats(std::ostream & out);
+
+}
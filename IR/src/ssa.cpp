@@ -0,0 +1,289 @@
+#include <unordered_set>
+
+#include "ssa.h"
+
+#ifdef SSA_DEBUG
+#define DEBUG_OUT (std::cerr << "DEBUG-SSA: ") // or any other ostream
+#else
+#define DEBUG_OUT 0 && std::cerr
+#endif
+
+
+namespace IR {
+
+    bool SSAFunction::is_version(ItemVariable * v) {
+        return IN_MAP(this->original, v);
+    }
+
+    static void item_uses(Item * & it, bool isValue, const std::function<void(Item * &, bool)> & f) {
+        switch (it->itemtype) {
+            case ItemType::item_variable:
+                f(it, isValue);
+                break;
+
+            case ItemType::item_ArrAccess:
+            {
+                ItemArrAccess * access = (ItemArrAccess *) it;
+                item_uses(access->addr, false, f);
+                for (Item * & offset : access->offsets) {
+                    item_uses(offset, true, f);
+                }
+                break;
+            }
+
+            case ItemType::item_op:
+            {
+                ItemOp * op = (ItemOp *) it;
+                item_uses(op->op1, true, f);
+                item_uses(op->op2, true, f);
+                break;
+            }
+
+            case ItemType::item_call:
+            {
+                ItemCall * call = (ItemCall *) it;
+                item_uses(call->callee, false, f);
+                for (Item * & arg : call->args) {
+                    item_uses(arg, true, f);
+                }
+                break;
+            }
+
+            case ItemType::item_newArr:
+                for (Item * & dim : ((ItemNewArray *) it)->dims) {
+                    item_uses(dim, true, f);
+                }
+                break;
+
+            case ItemType::item_newTuple:
+                item_uses(((ItemNewTuple *) it)->len, true, f);
+                break;
+
+            case ItemType::item_length:
+            {
+                ItemLength * len = (ItemLength *) it;
+                item_uses(len->addr, false, f);
+                item_uses(len->dim, true, f);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    void for_each_use(Instruction * inst, const std::function<void(Item * &, bool isValue)> & f) {
+        switch (inst->type) {
+            case InstType::inst_assign:
+            {
+                Instruction_assignment * assign = (Instruction_assignment *) inst;
+                item_uses(assign->src, true, f);
+
+                /**
+                 *  a store reads the array and the indices it writes to
+                 * */
+                if (assign->dst->itemtype != ItemType::item_variable) {
+                    item_uses(assign->dst, true, f);
+                }
+                break;
+            }
+
+            case InstType::inst_call:
+                item_uses(((Instruction_call *) inst)->call_wrap, true, f);
+                break;
+
+            case InstType::inst_ret_var:
+                item_uses(((Instruction_ret_var *) inst)->valueToReturn, true, f);
+                break;
+
+            case InstType::inst_branch_cond:
+                item_uses(((Instruction_branch_cond *) inst)->condition, true, f);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    ItemVariable * defined_var(Instruction * inst) {
+        if (inst->type != InstType::inst_assign) return NULL;
+
+        Item * dst = ((Instruction_assignment *) inst)->dst;
+        return dst->itemtype == ItemType::item_variable ? (ItemVariable *) dst : NULL;
+    }
+
+    class SSARenamer {
+        public:
+            SSARenamer(SSAFunction * ssa) : ssa(ssa), next(0) {}
+
+            void rename(int32_t b) {
+                DominatorTree & dom = *this->ssa->dom;
+                BasicBlock * BB = dom.order[b];
+                std::vector<ItemVariable *> pushed;
+
+                for (Phi * phi : this->ssa->phis[BB]) {
+                    phi->dst = this->new_version(phi->var);
+                    pushed.push_back(phi->var);
+                }
+
+                auto rename_use = [this](Item * & it, bool) {
+                    it = this->current((ItemVariable *) it);
+                };
+
+                for (Instruction_normal * inst : BB->insts) {
+                    for_each_use(inst, rename_use);
+
+                    ItemVariable * v = defined_var(inst);
+                    if (v != NULL) {
+                        ((Instruction_assignment *) inst)->dst = this->new_version(v);
+                        pushed.push_back(v);
+                    }
+                }
+                for_each_use(BB->te, rename_use);
+
+                for (int32_t s : dom.succs[b]) {
+                    for (Phi * phi : this->ssa->phis[dom.order[s]]) {
+                        phi->args[BB] = this->current(phi->var);
+                    }
+                }
+
+                for (int32_t child : dom.children[b]) {
+                    this->rename(child);
+                }
+
+                for (ItemVariable * v : pushed) {
+                    this->stacks[v].pop_back();
+                }
+            }
+
+        private:
+            SSAFunction * ssa;
+            int64_t next;
+            std::unordered_map<ItemVariable *, std::vector<ItemVariable *>> stacks;
+
+            ItemVariable * current(ItemVariable * v) {
+                std::vector<ItemVariable *> & stack = this->stacks[v];
+                return stack.empty() ? v : stack.back();
+            }
+
+            ItemVariable * new_version(ItemVariable * v) {
+                ItemVariable * version = new ItemVariable(
+                    v->name + "_ssa" + std::to_string(this->next++),
+                    v->typeSig
+                );
+
+                this->ssa->original[version] = v;
+                this->stacks[v].push_back(version);
+                return version;
+            }
+    };
+
+    SSAFunction * construct_ssa(Function * F) {
+        SSAFunction * ssa = new SSAFunction();
+        ssa->F = F;
+        ssa->dom = new DominatorTree(F);
+        DominatorTree & dom = *ssa->dom;
+
+        /**
+         *  variables read in some block before that block assigns them,
+         *      only those can need a phi
+         * */
+        std::unordered_set<ItemVariable *> global;
+        std::vector<ItemVariable *> defined;
+        std::unordered_map<ItemVariable *, std::vector<int32_t>> defBlocks;
+
+        for (int32_t b = 0; b < (int32_t) dom.order.size(); b++) {
+            BasicBlock * BB = dom.order[b];
+            std::unordered_set<ItemVariable *> killed;
+
+            auto find_global = [&](Item * & it, bool) {
+                ItemVariable * v = (ItemVariable *) it;
+                if (!IN_SET(killed, v)) global.insert(v);
+            };
+
+            for (Instruction_normal * inst : BB->insts) {
+                for_each_use(inst, find_global);
+
+                ItemVariable * v = defined_var(inst);
+                if (v == NULL || IN_SET(killed, v)) continue;
+
+                killed.insert(v);
+                if (!IN_MAP(defBlocks, v)) defined.push_back(v);
+                defBlocks[v].push_back(b);
+            }
+            for_each_use(BB->te, find_global);
+        }
+
+        int64_t phis = 0;
+        for (ItemVariable * v : defined) {
+            if (!IN_SET(global, v)) continue;
+
+            std::vector<int32_t> work = defBlocks[v];
+            std::unordered_set<int32_t> defining(work.begin(), work.end());
+            std::unordered_set<int32_t> hasPhi;
+
+            while (!work.empty()) {
+                int32_t b = work.back();
+                work.pop_back();
+
+                for (int32_t d : dom.frontier[b]) {
+                    if (IN_SET(hasPhi, d)) continue;
+                    hasPhi.insert(d);
+
+                    Phi * phi = new Phi();
+                    phi->var = v;
+                    phi->dst = NULL;
+                    if (d == 0) {
+                        phi->args[NULL] = v;
+                    }
+                    ssa->phis[dom.order[d]].push_back(phi);
+                    phis++;
+
+                    if (!IN_SET(defining, d)) {
+                        defining.insert(d);
+                        work.push_back(d);
+                    }
+                }
+            }
+        }
+
+        SSARenamer renamer(ssa);
+        renamer.rename(0);
+
+        DEBUG_OUT << F->name->labelName << ": " << phis << " phis, " << ssa->original.size() << " versions\n";
+        return ssa;
+    }
+
+    void destruct_ssa(SSAFunction * ssa) {
+        auto original_of = [ssa](Item * & it, bool) {
+            ItemVariable * v = (ItemVariable *) it;
+            if (ssa->is_version(v)) it = ssa->original[v];
+        };
+
+        for (BasicBlock * BB : ssa->F->BasicBlocks) {
+            for (Instruction_normal * inst : BB->insts) {
+                for_each_use(inst, original_of);
+
+                ItemVariable * v = defined_var(inst);
+                if (v != NULL && ssa->is_version(v)) {
+                    ((Instruction_assignment *) inst)->dst = ssa->original[v];
+                }
+            }
+            for_each_use(BB->te, original_of);
+        }
+
+        for (auto & kv : ssa->phis) {
+            for (Phi * phi : kv.second) {
+                delete phi;
+            }
+        }
+        ssa->phis.clear();
+
+        for (BasicBlock * BB : ssa->F->BasicBlocks) {
+            BB->succs.clear();
+            BB->preds.clear();
+        }
+        ssa->F->populatePredsSuccs();
+    }
+
+}
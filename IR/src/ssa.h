@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "IR.h"
+#include "dominators.h"
+
+namespace IR {
+
+    /**
+     *  dst <- phi(args) at the top of a basic block
+     *      @args maps every predecessor to the version it passes in,
+     *      the NULL predecessor stands for entering the function
+     * */
+    struct Phi {
+        ItemVariable * var;
+        ItemVariable * dst;
+        std::map<BasicBlock *, Item *> args;
+    };
+
+    /**
+     *  A function in SSA form
+     *      every assignment to a variable defines a new version of it,
+     *      the variable itself stands for its value on entry (a parameter, or undefined)
+     *  phis are kept here rather than in the instruction lists,
+     *  so code generation and the other passes never see them
+     * */
+    struct SSAFunction {
+        Function * F;
+        DominatorTree * dom;
+        std::unordered_map<BasicBlock *, std::vector<Phi *>> phis;
+
+        /**
+         *  version -> the variable of the original program
+         * */
+        std::unordered_map<ItemVariable *, ItemVariable *> original;
+
+        bool is_version(ItemVariable * v);
+    };
+
+    /**
+     *  calls @f on every variable @inst reads, through a reference so it can be replaced
+     *      @isValue is false where only a variable may stand (array addresses, callees),
+     *      true where a constant could replace it
+     * */
+    void for_each_use(Instruction * inst, const std::function<void(Item * &, bool isValue)> & f);
+
+    /**
+     *  the variable @inst assigns, NULL for stores and everything else
+     * */
+    ItemVariable * defined_var(Instruction * inst);
+
+    /**
+     *  Rename @F into SSA form
+     *      phis go on the iterated dominance frontier of the definitions
+     *      of variables live across blocks (semi-pruned SSA),
+     *      blocks the entry cannot reach are left as they are
+     * */
+    SSAFunction * construct_ssa(Function * F);
+
+    /**
+     *  back to plain IR
+     *      every version is renamed to its variable and phis are dropped,
+     *      valid as the versions of one variable never interfere (conventional SSA):
+     *      passes on the SSA form replace uses by constants and delete definitions,
+     *      but never propagate copies or move definitions
+     *  preds and succs of every basic block are recomputed
+     * */
+    void destruct_ssa(SSAFunction * ssa);
+
+}
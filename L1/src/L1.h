@@ -16,7 +16,10 @@ namespace L1 {
   enum Register_type {rdi, rax, rsi, rdx, rcx, r8, r9, rbx, rbp, r10, r11, r12, r13, r14, r15, rsp};
   enum Register_8b_type {r10b, r11b, r12b, r13b, r14b, r15b, r8b, r9b, al, bpl, bl, cl, dil, dl, sil};
   enum AopType {plus_eq, minus_eq, times_eq, bitand_eq};
-  enum CmpType {less, leq, eq, great, geq};
+  /**
+   *  neq is never parsed, passes create it when they invert an eq
+   * */
+  enum CmpType {less, leq, eq, great, geq, neq};
   enum ShiftType {left, right};
 
   struct Item{
@@ -100,11 +103,21 @@ namespace L1 {
   struct Instruction_call_runtime: Instruction_call {
     std::string callee;
     int arg_cnt;
+
+    /**
+     *  allocate: number of its inline fast path, -1 when it is a plain call
+     * */
+    int64_t inlineSite = -1;
   };
 
   struct Instruction_call_user: Instruction_call {
     Item * callee;
     Item * num_args;
+
+    /**
+     *  tail-call: the callee reuses the frame and returns straight to our caller
+     * */
+    bool isTail = false;
   };
 
   struct Instruction_aop: Instruction {
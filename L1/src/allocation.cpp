@@ -0,0 +1,34 @@
+#include <allocation.h>
+
+namespace L1{
+
+  static struct {
+    int64_t inlined;
+  } stats;
+
+  void inline_allocations(Program & p, int32_t optLevel) {
+    if (optLevel < 1) return;
+
+    for (Function * f : p.functions) {
+      for (Instruction * inst : f->instructions) {
+        if (inst->type != InstType::inst_call || !((Instruction_call *) inst)->isRuntimeCall) continue;
+
+        Instruction_call_runtime * call = (Instruction_call_runtime *) inst;
+        if (call->callee != "allocate") continue;
+
+        call->inlineSite = stats.inlined++;
+      }
+    }
+  }
+
+  std::string allocation_label(int64_t site, const std::string & what) {
+    /**
+     *  .L keeps it out of the symbol table, and no L1 label can look like it
+     * */
+    return ".Lallocate_" + what + "_" + std::to_string(site);
+  }
+
+  void print_allocation_stats(std::ostream & out) {
+    out << "allocate calls with an inline fast path: " << stats.inlined << '\n';
+  }
+}
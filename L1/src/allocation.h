@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <L1.h>
+
+namespace L1{
+
+  /**
+   *  Inline fast path of call allocate 2
+   *      runtime.c exports its nursery: compiled code bumps nursery.allocptr
+   *      up to nursery.limit itself for arrays of 1 to ALLOCATE_INLINE_MAX words of data,
+   *      and calls allocate only for the other sizes or when the nursery is full
+   *  the contract stays the one of the runtime stub:
+   *      rax is the array, every other caller-saved register is clobbered
+   * */
+  const int64_t ALLOCATE_INLINE_MAX = 64;
+
+  /**
+   *  offsets of allocptr and limit in runtime.c's heap_t
+   * */
+  const int64_t NURSERY_ALLOCPTR_OFFSET = 0;
+  const int64_t NURSERY_LIMIT_OFFSET = 8;
+
+  /**
+   *  number the call allocate 2 of @p (Instruction_call_runtime::inlineSite)
+   *      so that the code generators emit their fast path
+   *  does nothing below -O1
+   * */
+  void inline_allocations(Program & p, int32_t optLevel);
+
+  /**
+   *  local label @what of the fast path of @site, the same in prog.S and prog.o
+   * */
+  std::string allocation_label(int64_t site, const std::string & what);
+
+  void print_allocation_stats(std::ostream & out);
+
+}
@@ -0,0 +1,558 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <block_layout.h>
+
+namespace L1{
+
+  /**
+   *  Straight-line run of instructions
+   *      @labels are the labels in front of it,
+   *      @body is everything but the labels and the goto/cjump at its end
+   *  a block ending with a return or a call to a user function does not fall through,
+   *  the call comes back at a return label, whose address was stored earlier
+   * */
+  struct Block {
+    size_t idx;
+    std::vector<Instruction_label *> labels;
+    std::vector<Instruction *> body;
+
+    Instruction_cjump * cjump = NULL;
+    bool endsWithGoto = false;
+    bool falls = true;
+
+    /**
+     *  target of the goto/cjump, @taken is NULL when the label is outside the function
+     * */
+    std::string takenLabel;
+    Block * taken = NULL;
+    Block * fall = NULL;
+
+    /**
+     *  calls tensor-error, so it only runs once, right before the program dies
+     * */
+    bool cold = false;
+
+    /**
+     *  number of loops around the block
+     * */
+    int32_t loopDepth = 0;
+
+    bool reached = false;
+    bool placed = false;
+  };
+
+  struct LayoutStats {
+    int64_t threadedJumps = 0;
+    int64_t invertedBranches = 0;
+    int64_t removedBlocks = 0;
+    int64_t jumpsBefore = 0;
+    int64_t jumpsAfter = 0;
+  };
+
+  static LayoutStats stats;
+
+  static bool invert_cmptype(CmpType cmptype, CmpType & inverted) {
+    switch (cmptype) {
+      case CmpType::less:  inverted = CmpType::geq;  return true;
+      case CmpType::leq:   inverted = CmpType::great; return true;
+      case CmpType::great: inverted = CmpType::leq;  return true;
+      case CmpType::geq:   inverted = CmpType::less; return true;
+      case CmpType::eq:    inverted = CmpType::neq;  return true;
+      case CmpType::neq:   inverted = CmpType::eq;   return true;
+      default:
+        return false;
+    }
+  }
+
+  static bool is_invertible(Instruction_cjump * cjump) {
+    CmpType inverted;
+    return invert_cmptype(((ItemCmp *) cjump->condition)->cmptype, inverted);
+  }
+
+  static std::string jump_target(Instruction * inst) {
+    if (inst->type == InstType::inst_goto) {
+      return ((ItemLabel *) ((Instruction_goto *) inst)->gotoLabel)->labelName;
+    }
+    return ((ItemLabel *) ((Instruction_cjump *) inst)->dst)->labelName;
+  }
+
+  static ItemLabel * new_item_label(const std::string & labelName) {
+    ItemLabel * il = new ItemLabel();
+    il->itemtype = ItemType::item_labels;
+    il->labelName = labelName;
+    return il;
+  }
+
+  static Instruction_goto * new_goto(const std::string & labelName) {
+    Instruction_goto * gt = new Instruction_goto();
+    gt->type = InstType::inst_goto;
+    gt->gotoLabel = new_item_label(labelName);
+    return gt;
+  }
+
+  /**
+   *  Per-function state: the blocks plus the label names of the whole program,
+   *      so that new labels never clash with an existing one
+   * */
+  struct FunctionLayout {
+    Function * f;
+    std::vector<Block *> blocks;
+    std::unordered_map<std::string, Block *> labelBlock;
+    std::unordered_set<std::string> & programLabels;
+    int64_t newLabelCnt = 0;
+
+    FunctionLayout(Function * f, std::unordered_set<std::string> & programLabels)
+      : f(f), programLabels(programLabels) {}
+
+    Block * new_block() {
+      Block * b = new Block();
+      b->idx = blocks.size();
+      blocks.push_back(b);
+      return b;
+    }
+
+    /**
+     *  a label naming @b, created if the block had none
+     * */
+    std::string label_of(Block * b) {
+      if (!b->labels.empty()) return b->labels[0]->labelName;
+
+      std::string name;
+      do {
+        name = f->name + "_layout_" + std::to_string(newLabelCnt++);
+      } while (programLabels.count(name));
+      programLabels.insert(name);
+
+      Instruction_label * il = new Instruction_label();
+      il->type = InstType::inst_label;
+      il->labelName = name;
+      b->labels.push_back(il);
+      return name;
+    }
+
+    void build_blocks() {
+      Block * cur = NULL;
+      bool ended = true;
+
+      for (auto inst : f->instructions) {
+        if (inst->type == InstType::inst_label) {
+          if (cur == NULL || ended || !cur->body.empty()) {
+            cur = new_block();
+            ended = false;
+          }
+          Instruction_label * il = (Instruction_label *) inst;
+          cur->labels.push_back(il);
+          labelBlock[il->labelName] = cur;
+          continue;
+        }
+
+        if (cur == NULL || ended) {
+          cur = new_block();
+          ended = false;
+        }
+
+        switch (inst->type) {
+          case InstType::inst_goto:
+            cur->endsWithGoto = true;
+            cur->falls = false;
+            cur->takenLabel = jump_target(inst);
+            ended = true;
+            break;
+
+          case InstType::inst_cjump:
+            cur->cjump = (Instruction_cjump *) inst;
+            cur->takenLabel = jump_target(inst);
+            ended = true;
+            break;
+
+          case InstType::inst_ret:
+            cur->body.push_back(inst);
+            cur->falls = false;
+            ended = true;
+            break;
+
+          case InstType::inst_call:
+            cur->body.push_back(inst);
+            if (!((Instruction_call *) inst)->isRuntimeCall) {
+              cur->falls = false;
+              ended = true;
+            } else if (((Instruction_call_runtime *) inst)->callee == "tensor-error") {
+              cur->cold = true;
+            }
+            break;
+
+          default:
+            cur->body.push_back(inst);
+            break;
+        }
+      }
+
+      for (size_t i = 0; i < blocks.size(); i++) {
+        Block * b = blocks[i];
+        if (!b->takenLabel.empty()) {
+          auto it = labelBlock.find(b->takenLabel);
+          b->taken = it == labelBlock.end() ? NULL : it->second;
+        }
+        if (b->falls && i + 1 < blocks.size()) {
+          b->fall = blocks[i + 1];
+        }
+      }
+    }
+
+    /**
+     *  follow blocks that do nothing but pass control on
+     * */
+    Block * thread(Block * b) {
+      std::set<Block *> visited;
+
+      while (b != NULL && b->body.empty() && b->cjump == NULL && !visited.count(b)) {
+        visited.insert(b);
+
+        Block * next;
+        if (b->endsWithGoto) next = b->taken;
+        else if (b->falls) next = b->fall;
+        else break;
+
+        if (next == NULL) break;
+        b = next;
+      }
+      return b;
+    }
+
+    void thread_jumps() {
+      for (auto b : blocks) {
+        if (b->taken != NULL) {
+          Block * t = thread(b->taken);
+          if (t != b->taken) {
+            b->taken = t;
+            stats.threadedJumps++;
+          }
+        }
+        if (b->fall != NULL) {
+          Block * t = thread(b->fall);
+          if (t != b->fall) {
+            b->fall = t;
+            stats.threadedJumps++;
+          }
+        }
+      }
+    }
+
+    void mark_reachable(std::unordered_set<std::string> & addressTaken) {
+      std::vector<Block *> worklist;
+
+      if (!blocks.empty()) worklist.push_back(blocks[0]);
+      for (auto b : blocks) {
+        for (auto il : b->labels) {
+          if (addressTaken.count(il->labelName)) {
+            worklist.push_back(b);
+            break;
+          }
+        }
+      }
+
+      while (!worklist.empty()) {
+        Block * b = worklist.back();
+        worklist.pop_back();
+        if (b->reached) continue;
+
+        b->reached = true;
+        if (b->taken != NULL) worklist.push_back(b->taken);
+        if (b->fall != NULL) worklist.push_back(b->fall);
+      }
+    }
+
+    std::vector<Block *> successors(Block * b) {
+      std::vector<Block *> succs;
+      if (b->taken != NULL) succs.push_back(b->taken);
+      if (b->fall != NULL && b->fall != b->taken) succs.push_back(b->fall);
+      return succs;
+    }
+
+    /**
+     *  Natural loops of the back edges found by a DFS from the entry,
+     *      every block of a loop body gets its depth bumped once per loop
+     * */
+    void compute_loop_depth() {
+      if (blocks.empty()) return;
+
+      std::unordered_map<Block *, std::vector<Block *>> preds;
+      for (auto b : blocks) {
+        if (!b->reached) continue;
+        for (auto s : successors(b)) {
+          preds[s].push_back(b);
+        }
+      }
+
+      std::vector<std::pair<Block *, Block *>> backEdges;
+      std::set<Block *> visited, onStack;
+      std::vector<std::pair<Block *, size_t>> stack;
+
+      for (auto root : blocks) {
+        if (!root->reached || visited.count(root)) continue;
+
+        stack.push_back({root, 0});
+        visited.insert(root);
+        onStack.insert(root);
+
+        while (!stack.empty()) {
+          Block * b = stack.back().first;
+          std::vector<Block *> succs = successors(b);
+
+          if (stack.back().second == succs.size()) {
+            onStack.erase(b);
+            stack.pop_back();
+            continue;
+          }
+
+          Block * s = succs[stack.back().second++];
+          if (onStack.count(s)) {
+            backEdges.push_back({b, s});
+          } else if (!visited.count(s)) {
+            visited.insert(s);
+            onStack.insert(s);
+            stack.push_back({s, 0});
+          }
+        }
+      }
+
+      for (auto & edge : backEdges) {
+        Block * header = edge.second;
+        std::set<Block *> body = {header};
+        std::vector<Block *> worklist = {edge.first};
+
+        while (!worklist.empty()) {
+          Block * b = worklist.back();
+          worklist.pop_back();
+          if (body.count(b)) continue;
+
+          body.insert(b);
+          for (auto p : preds[b]) {
+            worklist.push_back(p);
+          }
+        }
+
+        for (auto b : body) {
+          b->loopDepth++;
+        }
+      }
+    }
+
+    void invert(Block * b) {
+      ItemCmp * cond = (ItemCmp *) b->cjump->condition;
+
+      ItemCmp * inverted = new ItemCmp();
+      inverted->itemtype = ItemType::item_cmp;
+      inverted->op1 = cond->op1;
+      inverted->op2 = cond->op2;
+      invert_cmptype(cond->cmptype, inverted->cmptype);
+
+      Instruction_cjump * cjump = new Instruction_cjump();
+      cjump->type = InstType::inst_cjump;
+      cjump->condition = inverted;
+      cjump->dst = NULL;
+      b->cjump = cjump;
+
+      std::swap(b->taken, b->fall);
+      stats.invertedBranches++;
+    }
+
+    static bool open(Block * b) {
+      return b != NULL && b->reached && !b->placed;
+    }
+
+    /**
+     *  should the taken side of @b's cjump be the one that falls through
+     *      never a cold block when the other side is warm,
+     *      then the side that stays in more loops,
+     *      then the side that came first in the source
+     * */
+    static bool prefer_taken(Block * b) {
+      if (!open(b->taken)) return false;
+      if (!open(b->fall)) return true;
+      if (b->taken->cold != b->fall->cold) return b->fall->cold;
+      if (b->taken->loopDepth != b->fall->loopDepth) return b->taken->loopDepth > b->fall->loopDepth;
+      return b->taken->idx < b->fall->idx;
+    }
+
+    /**
+     *  Greedy chains: keep appending the successor that is not placed yet,
+     *      a goto's target or a cjump's fall-through,
+     *      or the taken side of a cjump after inverting its condition
+     *  cold blocks only get chained after every warm one has been placed
+     * */
+    std::vector<Block *> layout() {
+      std::vector<Block *> order;
+
+      auto place_chain = [&](Block * b, bool allowCold) {
+        while (open(b) && (allowCold || !b->cold)) {
+          b->placed = true;
+          order.push_back(b);
+
+          Block * next = NULL;
+          if (b->endsWithGoto) {
+            next = b->taken;
+
+          } else if (b->cjump != NULL && b->taken != NULL && b->taken != b->fall) {
+            if (b->fall != NULL && is_invertible(b->cjump) && prefer_taken(b)) {
+              invert(b);
+            }
+            next = b->fall;
+
+          } else if (b->falls) {
+            next = b->fall;
+          }
+
+          b = next;
+        }
+      };
+
+      if (!blocks.empty()) place_chain(blocks[0], true);
+      for (auto b : blocks) {
+        place_chain(b, false);
+      }
+      for (auto b : blocks) {
+        place_chain(b, true);
+      }
+
+      for (auto b : blocks) {
+        if (!b->reached) stats.removedBlocks++;
+      }
+
+      return order;
+    }
+
+    /**
+     *  label of the block @b jumps to, the original one when it is outside the function
+     * */
+    std::string taken_label(Block * b) {
+      return b->taken == NULL ? b->takenLabel : label_of(b->taken);
+    }
+
+    void emit(std::vector<Block *> & order) {
+      /**
+       *  give every jump target a label before any block is written out,
+       *  a cjump whose taken side ended up next is inverted so that it falls through
+       * */
+      for (size_t k = 0; k < order.size(); k++) {
+        Block * b = order[k];
+        Block * next = k + 1 < order.size() ? order[k + 1] : NULL;
+
+        if (b->cjump != NULL && b->taken != NULL && b->taken == next && b->fall != NULL && b->fall != next
+          && is_invertible(b->cjump)
+        ) {
+          invert(b);
+        }
+
+        if (b->taken != NULL) label_of(b->taken);
+        if (b->fall != NULL && b->fall != next) label_of(b->fall);
+      }
+
+      std::vector<Instruction *> insts;
+
+      for (size_t k = 0; k < order.size(); k++) {
+        Block * b = order[k];
+        Block * next = k + 1 < order.size() ? order[k + 1] : NULL;
+
+        for (auto il : b->labels) {
+          insts.push_back(il);
+        }
+        insts.insert(insts.end(), b->body.begin(), b->body.end());
+
+        if (b->endsWithGoto) {
+          if (b->taken == NULL || b->taken != next) {
+            insts.push_back(new_goto(taken_label(b)));
+          }
+          continue;
+        }
+
+        if (b->cjump != NULL) {
+          if (b->taken == NULL || b->taken != b->fall) {
+            std::string target = taken_label(b);
+            if (b->cjump->dst == NULL || jump_target(b->cjump) != target) {
+              b->cjump->dst = new_item_label(target);
+            }
+            insts.push_back(b->cjump);
+          }
+        }
+
+        if (b->falls && b->fall != NULL && b->fall != next) {
+          insts.push_back(new_goto(label_of(b->fall)));
+        }
+      }
+
+      f->instructions = insts;
+    }
+  };
+
+  /**
+   *  labels whose address is stored somewhere, i.e. return labels,
+   *  control can arrive there without a jump
+   * */
+  static void collect_labels(
+    Program & p,
+    std::unordered_set<std::string> & all,
+    std::unordered_set<std::string> & addressTaken
+  ) {
+    for (auto f : p.functions) {
+      all.insert(f->name);
+
+      for (auto inst : f->instructions) {
+        if (inst->type == InstType::inst_label) {
+          all.insert(((Instruction_label *) inst)->labelName);
+        } else if (inst->type == InstType::inst_assign) {
+          Item * src = ((Instruction_assignment *) inst)->src;
+          if (src->itemtype == ItemType::item_labels) {
+            addressTaken.insert(((ItemLabel *) src)->labelName);
+          }
+        }
+      }
+    }
+  }
+
+  static int64_t count_jumps(Function * f) {
+    int64_t cnt = 0;
+    for (auto inst : f->instructions) {
+      if (inst->type == InstType::inst_goto || inst->type == InstType::inst_cjump) cnt++;
+    }
+    return cnt;
+  }
+
+  void layout_blocks(Program & p, int32_t optLevel) {
+    if (optLevel < 2) return;
+
+    std::unordered_set<std::string> programLabels;
+    std::unordered_set<std::string> addressTaken;
+    collect_labels(p, programLabels, addressTaken);
+
+    for (auto f : p.functions) {
+      stats.jumpsBefore += count_jumps(f);
+      FunctionLayout fl(f, programLabels);
+
+      fl.build_blocks();
+      fl.thread_jumps();
+      fl.mark_reachable(addressTaken);
+      fl.compute_loop_depth();
+
+      std::vector<Block *> order = fl.layout();
+      fl.emit(order);
+
+      for (auto b : fl.blocks) {
+        delete b;
+      }
+      stats.jumpsAfter += count_jumps(f);
+    }
+  }
+
+  void print_layout_stats(std::ostream & out) {
+    out << "layout threaded jumps: " << stats.threadedJumps << '\n';
+    out << "layout inverted branches: " << stats.invertedBranches << '\n';
+    out << "layout removed blocks: " << stats.removedBlocks << '\n';
+    out << "layout jumps before: " << stats.jumpsBefore << '\n';
+    out << "layout jumps after: " << stats.jumpsAfter << '\n';
+  }
+}
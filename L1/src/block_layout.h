@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include <L1.h>
+
+namespace L1{
+
+  /**
+   *  Reorder the basic blocks of every function of @p
+   *      jumps to blocks that only jump are threaded to the final target,
+   *      blocks nobody can reach are dropped,
+   *      blocks are chained so that jumps become fall-throughs,
+   *      conditions are inverted when that lets the taken side fall through
+   *  does nothing below -O2
+   * */
+  void layout_blocks(Program & p, int32_t optLevel);
+
+  void print_layout_stats(std::ostream & out);
+
+}
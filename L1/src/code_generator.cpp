@@ -1,8 +1,13 @@
 #include <string>
+#include <vector>
 #include <iostream>
-#include <fstream>
 
+#include <output_sink.h>
 #include <code_generator.h>
+#include <idioms.h>
+#include <frame.h>
+#include <allocation.h>
+#include <stack_map.h>
 
 #define QUADSIZE 8
 #define REG_ARGS_NUM 6
@@ -36,130 +41,41 @@ namespace L1{
     }
     
   }
-  void output_8bregister(std::ofstream & out, Register_8b_type rtype) {
-    out << '%';
-    switch(rtype) {
-      case r10b : 
-        out << "r10b";
-        break;
-      case r11b : 
-        out << "r11b";
-        break;
-      case r12b:
-        out << "r12b";
-        break;
-      case r13b : 
-        out << "r13b";
-        break;
-      case r14b : 
-        out << "r14b";
-        break;
-      case r15b:
-        out << "r15b";
-        break;
-      case r8b : 
-        out << "r8b";
-        break;
-      case r9b : 
-        out << "r9b";
-        break;
-      case al:
-        out << "al";
-        break;
-      case bpl : 
-        out << "bpl";
-        break;
-      case bl : 
-        out << "bl";
-        break;
-      case cl:
-        out << "cl";
-        break;
-      case dil : 
-        out << "dil";
-        break;
-      case dl : 
-        out << "dl";
-        break;
-      case sil:
-        out << "sil";
-        break;
-      default:
-        std::cerr << "Erorr Register_8b_type in output_8bregister!\n";
-        break;
-    }
-  }
-
-  void output_register(std::ofstream & out, Register_type rtype) {
-    out << '%';
-    switch(rtype) {
-      case rdi : 
-        out << "rdi";
-        break;
+  /**
+   *  names indexed by Register_8b_type / Register_type (64 and 32 bits)
+   * */
+  static const char * const reg8b_names[] = {
+    "r10b", "r11b", "r12b", "r13b", "r14b", "r15b", "r8b", "r9b", "al", "bpl", "bl", "cl", "dil", "dl", "sil"
+  };
 
-      case rax : 
-        out << "rax";
-        break; 
+  static const char * const reg_names[] = {
+    "rdi", "rax", "rsi", "rdx", "rcx", "r8", "r9", "rbx", "rbp", "r10", "r11", "r12", "r13", "r14", "r15", "rsp"
+  };
 
-      case rsi : 
-        out << "rsi";
-        break;
-      
-      case rdx : 
-        out << "rdx";
-        break;
-      
-      case rcx : 
-        out << "rcx";
-        break;
+  static const char * const reg32_names[] = {
+    "edi", "eax", "esi", "edx", "ecx", "r8d", "r9d", "ebx", "ebp", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d", "esp"
+  };
 
-      case r8 : 
-        out << "r8";
-        break;
+  void output_8bregister(Output::Sink & out, Register_8b_type rtype) {
+    if (rtype < r10b || rtype > sil) {
+      std::cerr << "Erorr Register_8b_type in output_8bregister!\n";
+      return;
+    }
+    out << '%' << reg8b_names[rtype];
+  }
 
-      case r9 : 
-        out << "r9";
-        break;
-      
-      case rbx : 
-        out << "rbx";
-        break;
-      
-      case rbp : 
-        out << "rbp";
-        break;
-      
-      case r10 : 
-        out << "r10";
-        break;
-      
-      case r11 : 
-        out << "r11";
-        break;
-      
-      case r12 : 
-        out << "r12";
-        break;
-      
-      case r13 : 
-        out << "r13";
-        break;
-      
-      case r14 : 
-        out << "r14";
-        break;
-      
-      case r15 : 
-        out << "r15";
-        break;
+  void output_register(Output::Sink & out, Register_type rtype) {
+    out << '%' << reg_names[rtype];
+  }
 
-      case rsp : 
-        out << "rsp";
-        break;
-    }
+  /**
+   *  xorl %eXX, %eXX  clears the whole register
+   * */
+  void output_xor_zero(Output::Sink & out, Register_type rtype) {
+    out << "xorl %" << reg32_names[rtype] << ", %" << reg32_names[rtype] << '\n';
   }
 
-  void output_set_cmp(std::ofstream & out, CmpType cmptype){
+  void output_set_cmp(Output::Sink & out, CmpType cmptype){
     switch(cmptype) {
           case CmpType::less:
             out << "setl";
@@ -181,12 +97,16 @@ namespace L1{
             out << "setge";
             break;
 
+          case CmpType::neq :
+            out << "setne";
+            break;
+
           default:
             std::cerr << "Error cmp type!\n";
         }
   }
 
-  void output_jmp_cmp(std::ofstream & out, CmpType cmptype){
+  void output_jmp_cmp(Output::Sink & out, CmpType cmptype){
     switch(cmptype) {
           case CmpType::less:
             out << "jl";
@@ -208,99 +128,132 @@ namespace L1{
             out << "jge";
             break;
 
+          case CmpType::neq :
+            out << "jne";
+            break;
+
           default:
             std::cerr << "Error cmp type!\n";
         }
   }
 
-  void output_constant(std::ofstream & out, int64_t val) {
+  void output_constant(Output::Sink & out, int64_t val) {
     out << '$' << val;
   }
 
-  void output_memmory_access(std::ofstream & out, Register_type rType, int64_t offset){
+  void output_memmory_access(Output::Sink & out, Register_type rType, int64_t offset){
     out << offset;
     out << '(' ;
     output_register(out, rType);
     out << ')' ;
   }
 
-  void output_item_labels(std::ofstream & out, std::string & labelName) {
+  void output_item_labels(Output::Sink & out, std::string & labelName) {
     out << "$_";
-    out << labelName.substr(1, labelName.length() - 1);
+    out.append(labelName.data() + 1, labelName.length() - 1);
   }
 
   /**
    *  output jmp style label
    */
-  void output_jmp_labels(std::ofstream & out, std::string & labelName) {
+  void output_jmp_labels(Output::Sink & out, std::string & labelName) {
     out << "_";
-    out << labelName.substr(1, labelName.length() - 1);
+    out.append(labelName.data() + 1, labelName.length() - 1);
   }
 
   /**
    *  Wrapper of jmp instruction output
    * */
-  void output_jmp_inst(std::ofstream & out, ItemLabel * itLabel) {
+  void output_jmp_inst(Output::Sink & out, ItemLabel * itLabel) {
     out << "jmp ";
     output_jmp_labels(out, itLabel->labelName);
     out << '\n';
   }
 
-  // void output_item_cmp(std::ofstream & out, ItemCmp * cmp) {
+  // void output_item_cmp(Output::Sink & out, ItemCmp * cmp) {
   //   output_item(cmp->op1)
   // }
 
-  void empty_lines(std::ofstream & out, int count) {
+  void empty_lines(Output::Sink & out, int count) {
     while(count-- > 0) {
       out << '\n';
     }
   }
 
 
-  void output_header(std::ofstream & out){
+  void output_header(Output::Sink & out){
     out << ".text\n";
     out << "  .globl go\n";
     out << "go:\n";
   }
 
 
-  void push_caller_save(std::ofstream & out) {
-    out << "pushq %rbx\n";
-    out << "pushq %rbp\n";
-    out << "pushq %r12\n";
-    out << "pushq %r13\n";
-    out << "pushq %r14\n";
-    out << "pushq %r15\n";
+  void stack_grow(Output::Sink & out, int bytes) {
+    out << "subq ";
+    out << '$';
+    out << bytes;
+    out << ", ";
+    out << "%rsp\n";
+  }
+
+  void stack_shrink(Output::Sink & out, int bytes) {
+    out << "addq ";
+    out << '$';
+    out << bytes;
+    out << ", ";
+    out << "%rsp\n";
   }
 
 
-  void call_entryPoint(std::ofstream & out, Program & p) {
+  /**
+   *  save the callee-saved registers the program uses,
+   *      the rest of go's frame is reserved with a subq (see GO_FRAME_BYTES)
+   * */
+  void push_caller_save(Output::Sink & out, std::vector<Register_type> & saved) {
+    for (auto r : saved) {
+      out << "pushq ";
+      output_register(out, r);
+      out << '\n';
+    }
+
+    int64_t padding = GO_FRAME_BYTES - (int64_t) saved.size() * QUADSIZE;
+    if (padding > 0) {
+      stack_grow(out, padding);
+    }
+  }
+
+
+  void call_entryPoint(Output::Sink & out, Program & p) {
     out << "call _"; 
-    out << p.entryPointLabel.substr(1, p.entryPointLabel.length() - 1);
+    out.append(p.entryPointLabel.data() + 1, p.entryPointLabel.length() - 1);
     out << '\n';
   }
 
-  void pop_caller_save(std::ofstream & out) {
-    out << "popq %rbx\n";
-    out << "popq %rbp\n";
-    out << "popq %r12\n";
-    out << "popq %r13\n";
-    out << "popq %r14\n";
-    out << "popq %r15\n";
+  void pop_caller_save(Output::Sink & out, std::vector<Register_type> & saved) {
+    int64_t padding = GO_FRAME_BYTES - (int64_t) saved.size() * QUADSIZE;
+    if (padding > 0) {
+      stack_shrink(out, padding);
+    }
+
+    for (auto r = saved.rbegin(); r != saved.rend(); r++) {
+      out << "popq ";
+      output_register(out, *r);
+      out << '\n';
+    }
   }
 
-  void output_ret(std::ofstream & out) {
+  void output_ret(Output::Sink & out) {
     out << "retq\n";
   }
 
-  void output_label_def(std::ofstream & out, std::string & labelname){
+  void output_label_def(Output::Sink & out, std::string & labelname){
     out << "_"; 
-    out << labelname.substr(1, labelname.length() - 1);
+    out.append(labelname.data() + 1, labelname.length() - 1);
     out << ':';
     out << '\n';
   }
 
-  void output_item(std::ofstream & out, Item * it){
+  void output_item(Output::Sink & out, Item * it){
     switch (it->itemtype) {
       case ItemType::item_registers:
       {
@@ -361,6 +314,9 @@ namespace L1{
       case CmpType::geq :
         return val1 >= val2;
 
+      case CmpType::neq :
+        return val1 != val2;
+
       default:
         std::cerr << "Error cmp type!\n";
         return 0;
@@ -384,13 +340,16 @@ namespace L1{
       case CmpType::geq :
         return CmpType::leq;
 
+      case CmpType::neq :
+        return CmpType::neq;
+
       default:
         std::cerr << "Error cmp type!\n";
         return CmpType::less;
     }
   }
 
-  void output_movzbq(std::ofstream & out, Register_type rtype) {
+  void output_movzbq(Output::Sink & out, Register_type rtype) {
     out << "movzbq ";
     
     output_8bregister(out, find_8b_equivalent(rtype));
@@ -402,7 +361,48 @@ namespace L1{
     out << '\n';
   }
 
-  void output_inst_assign(std::ofstream & out, Instruction_assignment * assign){
+  /**
+   *    op1 {cmp} op2
+   *  =>>
+   *    cmpq op2, op1       or testq op1, op1 when op2 is 0
+   *
+   *    reverse op1 and op2, and the cmp when op1 is a constant
+   *    returns the cmp the flags have to be tested for
+   * */
+  CmpType output_cmp(Output::Sink & out, ItemCmp * cmp) {
+    Register_type reg;
+    CmpType cmptype;
+    if (test_zero_idiom(cmp, reg, cmptype)) {
+      count_idiom(idiom_test_zero);
+      out << "testq ";
+      output_register(out, reg);
+      out << ", ";
+      output_register(out, reg);
+      out << "\n";
+      return cmptype;
+    }
+
+    out << "cmpq ";
+    cmptype = cmp->cmptype;
+
+    if(cmp->op1->itemtype == ItemType::item_constant) {
+      output_item(out, cmp->op1);
+      out << ", ";
+      output_item(out, cmp->op2);
+      out << "\n";
+      cmptype = get_reverse_cmptype(cmptype);
+
+    }else {
+      output_item(out,cmp->op2);
+      out << ", ";
+      output_item(out,cmp->op1);
+      out << "\n";
+    }
+
+    return cmptype;
+  }
+
+  void output_inst_assign(Output::Sink & out, Instruction_assignment * assign){
     /**
      *  dest <- src  ==>> movq src dest
      **/
@@ -445,42 +445,42 @@ namespace L1{
          *    set{le|e|l} 8b_register_dest
          *    movzbq 8b_register_dest, dest
          * 
-         *    reverse op1 and op2, and set flag when op1 is a constant
+         *    when dest is neither op1 nor op2, clear it first instead
+         *    xorl dest, dest
+         *    cmpq op2, op1
+         *    set{le|e|l} 8b_register_dest
          * */
-
-        out << "cmpq ";
-        CmpType cmptype = cmp->cmptype;
-
-        if(cmp->op1->itemtype == ItemType::item_constant) {
-          output_item(out, cmp->op1);
-          out << ", ";
-          output_item(out, cmp->op2);
-          out << "\n";
-          cmptype = get_reverse_cmptype(cmptype);
-
-        }else {
-          output_item(out,cmp->op2);
-          out << ", ";
-          output_item(out,cmp->op1);
-          out << "\n";
+        ItemRegister *reg = (ItemRegister *) assign->dst;
+        bool cleared = xor_setcc_idiom(assign);
+        if (cleared) {
+          count_idiom(idiom_xor_setcc);
+          output_xor_zero(out, reg->rType);
         }
 
+        CmpType cmptype = output_cmp(out, cmp);
+
         output_set_cmp(out, cmptype);
 
         out << " ";
         
-        ItemRegister *reg = (ItemRegister *) assign->dst;
         output_8bregister(out, find_8b_equivalent(reg->rType));
 
         out << "\n";
         
-        output_movzbq(out, reg->rType);
+        if (!cleared) {
+          output_movzbq(out, reg->rType);
+        }
         
       }
       
       return;
     }
 
+    if (xor_zero_idiom(assign)) {
+      count_idiom(idiom_xor_zero);
+      output_xor_zero(out, ((ItemRegister *) assign->dst)->rType);
+      return;
+    }
 
     out << "movq ";
 
@@ -493,31 +493,14 @@ namespace L1{
     out << "\n";
   }
 
-  void stack_grow(std::ofstream & out, int bytes) {
-    out << "subq ";
-    out << '$';
-    out << bytes;
-    out << ", ";
-    out << "%rsp\n";
-  }
-
-  void stack_shrink(std::ofstream & out, int bytes) {
-    out << "addq ";
-    out << '$';
-    out << bytes;
-    out << ", ";
-    out << "%rsp\n";
-  }
-
-
-  void alloc_locals(std::ofstream & out, Function * function){
+  void alloc_locals(Output::Sink & out, Function * function){
     int growedQuad = function->locals;
     if (growedQuad > 0) {
       stack_grow(out, growedQuad * QUADSIZE);
     }
   }
 
-  void dealloc_locals_and_stack(std::ofstream & out, Function * function) {
+  void dealloc_locals_and_stack(Output::Sink & out, Function * function) {
     int numLocals = function->locals;
     int numArgsOnStack = MAX(function->arguments - REG_ARGS_NUM, 0);
     
@@ -527,7 +510,63 @@ namespace L1{
     }
   }
 
-  void output_runtimeCall(std::ofstream & out, Instruction_call_runtime * runtime_call) {
+  /**
+   *  fast path of call allocate 2 (allocation.h)
+   *      rdi: encoded size, rsi: fill value
+   *      rcx, rdx and r8 are free, the call clobbers them anyway
+   * */
+  void output_allocate_fast(Output::Sink & out, Instruction_call_runtime * runtime_call) {
+    std::string slow = allocation_label(runtime_call->inlineSite, "slow");
+    std::string fill = allocation_label(runtime_call->inlineSite, "fill");
+    std::string done = allocation_label(runtime_call->inlineSite, "done");
+
+    /**
+     *  1 to ALLOCATE_INLINE_MAX words of data, anything else is up to the runtime
+     * */
+    out << "movq %rdi, %rcx\n";
+    out << "andq $1, %rcx\n";
+    out << "je " << slow << '\n';
+    out << "movq %rdi, %rax\n";
+    out << "sarq $1, %rax\n";
+    out << "leaq -1(%rax), %rcx\n";
+    out << "cmpq $" << ALLOCATE_INLINE_MAX - 1 << ", %rcx\n";
+    out << "ja " << slow << '\n';
+
+    /**
+     *  bump the nursery: rdx is the array, r8 its end
+     * */
+    out << "movq $nursery, %rcx\n";
+    out << "movq " << NURSERY_ALLOCPTR_OFFSET << "(%rcx), %rdx\n";
+    out << "leaq (%rdx, %rax, 8), %r8\n";
+    out << "addq $8, %r8\n";
+    out << "cmpq " << NURSERY_LIMIT_OFFSET << "(%rcx), %r8\n";
+    out << "jge " << slow << '\n';
+    out << "movq %r8, " << NURSERY_ALLOCPTR_OFFSET << "(%rcx)\n";
+
+    /**
+     *  size, then the fill value up to the end
+     * */
+    out << "movq %rax, (%rdx)\n";
+    out << "leaq 8(%rdx), %rcx\n";
+    out << fill << ":\n";
+    out << "movq %rsi, (%rcx)\n";
+    out << "addq $8, %rcx\n";
+    out << "cmpq %r8, %rcx\n";
+    out << "jl " << fill << '\n';
+    out << "movq %rdx, %rax\n";
+    out << "jmp " << done << '\n';
+
+    out << slow << ":\n";
+    out << "call allocate\n";
+    out << done << ":\n";
+  }
+
+  void output_runtimeCall(Output::Sink & out, Instruction_call_runtime * runtime_call) {
+    if (runtime_call->inlineSite >= 0) {
+      output_allocate_fast(out, runtime_call);
+      return;
+    }
+
     out << "call ";
     if (runtime_call->callee == "tensor-error") {
       switch (runtime_call->arg_cnt)
@@ -553,12 +592,49 @@ namespace L1{
     out << '\n';
   }
 
-  void output_userCall(std::ofstream & out, Instruction_call_user * user_call) {
-    int quadToGrow = 1;
-    ItemConstant * c = (ItemConstant * ) user_call->num_args;
-    quadToGrow += MAX(c->constVal - REG_ARGS_NUM, 0);
-    
-    stack_grow(out, quadToGrow * QUADSIZE);
+  /**
+   *  tail-call: move the stack arguments onto ours and give our return address to the callee
+   *      movq -16(%rsp), %rax
+   *      movq %rax, D-8(%rsp)
+   *      ...
+   *      addq $D - 8*stackArgs, %rsp
+   * */
+  void output_tail_frame(Output::Sink & out, Function * function, Instruction_call_user * user_call) {
+    TailCallFrame frame = tail_call_frame(function, user_call);
+
+    for (int64_t i = 0; i < frame.stackArgs; i++) {
+      int64_t offset = -2 * QUADSIZE - i * QUADSIZE;
+
+      out << "movq ";
+      output_memmory_access(out, rsp, offset);
+      out << ", ";
+      output_register(out, frame.scratch);
+      out << '\n';
+
+      out << "movq ";
+      output_register(out, frame.scratch);
+      out << ", ";
+      output_memmory_access(out, rsp, offset + frame.argShift);
+      out << '\n';
+    }
+
+    if (frame.rspShift > 0) {
+      stack_shrink(out, frame.rspShift);
+    } else if (frame.rspShift < 0) {
+      stack_grow(out, -frame.rspShift);
+    }
+  }
+
+  void output_userCall(Output::Sink & out, Function * function, Instruction_call_user * user_call) {
+    if (user_call->isTail) {
+      output_tail_frame(out, function, user_call);
+    } else {
+      int quadToGrow = 1;
+      ItemConstant * c = (ItemConstant * ) user_call->num_args;
+      quadToGrow += MAX(c->constVal - REG_ARGS_NUM, 0);
+
+      stack_grow(out, quadToGrow * QUADSIZE);
+    }
     
     out << "jmp";
     out << ' ';
@@ -584,7 +660,7 @@ namespace L1{
     out << '\n';
   }
 
-  void output_call_inst(std::ofstream & out, Instruction_call * call) {
+  void output_call_inst(Output::Sink & out, Function * function, Instruction_call * call) {
 
     if (call->isRuntimeCall) {
 
@@ -593,15 +669,24 @@ namespace L1{
     
     } else {
       Instruction_call_user * user_call = (Instruction_call_user *) call;
-      output_userCall(out, user_call);
+      output_userCall(out, function, user_call);
       
     }
   }
 
-  void output_aop_inst(std::ofstream & out, Instruction_aop * aop) {
+  void output_aop_inst(Output::Sink & out, Instruction_aop * aop) {
     /**
      *  op1 += op2  ==>> addq op2 op1
+     *  reg += 1    ==>> incq reg
      * */
+    Idiom incDec = inc_dec_idiom(aop);
+    if (incDec != idiom_count) {
+      count_idiom(incDec);
+      out << (incDec == idiom_inc ? "incq " : "decq ");
+      output_item(out, aop->op1);
+      out << '\n';
+      return;
+    }
 
     switch (aop->aopType)
     {
@@ -633,7 +718,7 @@ namespace L1{
     out << '\n';
   }
   
-  void output_sop_inst(std::ofstream & out, Instruction_sop * sop) {
+  void output_sop_inst(Output::Sink & out, Instruction_sop * sop) {
     /**
      *  op1 >>= op2  ==>> sarq op2 op1
      * */
@@ -671,7 +756,7 @@ namespace L1{
     out << '\n';
   }
 
-  void output_lea_inst(std::ofstream & out, Instruction_lea * lea) {
+  void output_lea_inst(Output::Sink & out, Instruction_lea * lea) {
     /**
      *  rax @ rdi rsi 4  ==>> lea (%rdi, %rsi, 4), %rax
      * */
@@ -698,7 +783,28 @@ namespace L1{
     out << '\n';
   }
   
-  void output_goto_inst(std::ofstream & out, Instruction_goto * goto_inst) {
+  void output_lea_idiom(Output::Sink & out, LeaIdiom & lea) {
+    /**
+     *  leaq disp(base, index, scale), dst
+     * */
+    out << "leaq ";
+    if (lea.disp != 0) out << lea.disp;
+
+    out << '(';
+    output_register(out, lea.base);
+    if (lea.hasIndex) {
+      out << ", ";
+      output_register(out, lea.index);
+      if (lea.scale != 1) out << ", " << lea.scale;
+    }
+    out << ')';
+
+    out << ", ";
+    output_register(out, lea.dst);
+    out << '\n';
+  }
+  
+  void output_goto_inst(Output::Sink & out, Instruction_goto * goto_inst) {
     /**
      *  goto :label  ==>> jmp _label
      * */
@@ -709,7 +815,7 @@ namespace L1{
     out << '\n';
   }
 
-  void output_inc_inst(std::ofstream & out, Instruction_inc * inc) {
+  void output_inc_inst(Output::Sink & out, Instruction_inc * inc) {
     /**
      *  rdi++ => inc rdi
      * */
@@ -719,7 +825,7 @@ namespace L1{
     out << '\n';
   }
   
-  void output_dec_inst(std::ofstream & out, Instruction_dec * dec) {
+  void output_dec_inst(Output::Sink & out, Instruction_dec * dec) {
     /**
      *  rdi-- => dec rdi
      * */
@@ -729,7 +835,7 @@ namespace L1{
     out << '\n';
   }
 
-  void output_cjump_inst(std::ofstream & out, Instruction_cjump * cjump) {
+  void output_cjump_inst(Output::Sink & out, Instruction_cjump * cjump) {
     /**
      *  cjump rax <= rdi :yes 
      * ==>>
@@ -767,28 +873,9 @@ namespace L1{
        *    cjump op1 {leq | eq | less} op2 :label
        *  =>>
        *    cmpq op2, op1
-       *    set{le|e|l} 8b_register_dest
-       *    movzbq 8b_register_dest, dest
-       * 
-       *    reverse op1 and op2, and set flag when op1 is a constant
+       *    j{le|e|l} _label
        * */
-
-      out << "cmpq ";
-      CmpType cmptype = cmp->cmptype;
-
-      if(cmp->op1->itemtype == ItemType::item_constant) {
-        output_item(out, cmp->op1);
-        out << ", ";
-        output_item(out, cmp->op2);
-        out << "\n";
-        cmptype = get_reverse_cmptype(cmptype);
-
-      }else {
-        output_item(out,cmp->op2);
-        out << ", ";
-        output_item(out,cmp->op1);
-        out << "\n";
-      }
+      CmpType cmptype = output_cmp(out, cmp);
 
       output_jmp_cmp(out, cmptype);
 
@@ -805,7 +892,7 @@ namespace L1{
 
 
 
-  void output_inst(std::ofstream & out, Function * function, Instruction * inst) {
+  void output_inst(Output::Sink & out, Function * function, Instruction * inst) {
     switch(inst->type) {
       case InstType::inst_ret :
       {
@@ -827,7 +914,7 @@ namespace L1{
       case InstType::inst_call : 
       { 
         Instruction_call * call = (Instruction_call *) inst;
-        output_call_inst(out, call );
+        output_call_inst(out, function, call );
         break; 
       }
 
@@ -893,7 +980,26 @@ namespace L1{
 
   
 
-  void output_function(std::ofstream & out, Function * function) {
+  /**
+   *  the table runtime.c finds the arrays on the stack with (stack_map.h)
+   * */
+  void output_stack_maps(Output::Sink & out) {
+    out << ".p2align 2, 0\n";
+    out << "  .globl stack_maps\n";
+    out << "stack_maps:\n";
+
+    for (StackMapWord & word : stack_map_table()) {
+      out << ".long ";
+      if (word.label.empty()) {
+        out << word.value;
+      } else {
+        out << word.label;
+      }
+      out << '\n';
+    }
+  }
+
+  void output_function(Output::Sink & out, Function * function) {
     /**
      *  output function label
      * */
@@ -904,8 +1010,18 @@ namespace L1{
      * */
     alloc_locals(out, function);
 
-    for (auto inst: function->instructions) {
-      output_inst(out, function, inst);
+    std::vector<Instruction *> & insts = function->instructions;
+    for (size_t i = 0; i < insts.size(); ) {
+      LeaIdiom lea;
+      if (lea_idiom(insts, i, lea)) {
+        count_idiom(lea.idiom);
+        output_lea_idiom(out, lea);
+        i += lea.length;
+        continue;
+      }
+
+      output_inst(out, function, insts[i]);
+      i++;
     }
 
 
@@ -915,22 +1031,23 @@ namespace L1{
   void generate_code(Program p){
 
     /* 
-     * Open the output file.
+     * The whole file is built in memory and written once at the end.
      */ 
-    std::ofstream outputFile;
-    outputFile.open("prog.S");
+    Output::Sink outputFile(1 << 20);
    
     /* 
      * Generate target code
      */ 
     //TODO
+    std::vector<Register_type> saved = used_callee_saved(p);
+
     output_header(outputFile);
-    push_caller_save(outputFile);
+    push_caller_save(outputFile, saved);
 
     call_entryPoint(outputFile, p);
 
 
-    pop_caller_save(outputFile);
+    pop_caller_save(outputFile, saved);
     output_ret(outputFile);
 
     empty_lines(outputFile, 2);
@@ -939,11 +1056,15 @@ namespace L1{
       output_function(outputFile, f);
       empty_lines(outputFile, 2);
     }
+
+    output_stack_maps(outputFile);
   
     /* 
-     * Close the output file.
+     * Write the output file.
      */ 
-    outputFile.close();
+    if (!outputFile.flush("prog.S")) {
+      std::cerr << "cannot write prog.S\n";
+    }
    
     return ;
   }
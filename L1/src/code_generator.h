@@ -1,9 +1,20 @@
 #pragma once
 
+#include <string>
+
 #include <L1.h>
 
 namespace L1{
 
   void generate_code(Program p);
 
+  /**
+   *  encode @p straight into an ELF relocatable object, no assembler needed
+   *      the code is the same generate_code writes to prog.S
+   * */
+  void generate_object(Program & p, const std::string & fileName);
+
+  int gen_cmp_result (int64_t val1, int64_t val2, CmpType cmptype);
+  CmpType get_reverse_cmptype(CmpType cmptype);
+
 }
@@ -14,11 +14,18 @@
 
 #include <parser.h>
 #include <code_generator.h>
+#include <peephole.h>
+#include <block_layout.h>
+#include <idioms.h>
+#include <frame.h>
+#include <allocation.h>
+#include <stack_map.h>
 
 using namespace std;
 
 void print_help (char *progName){
-  std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] SOURCE" << std::endl;
+  std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-S] SOURCE" << std::endl;
+  std::cerr << "  writes the object file prog.o, or the assembly prog.S with -S" << std::endl;
   return ;
 }
 
@@ -28,7 +35,8 @@ int main(
   ){
   auto enable_code_generator = true;
   int32_t optLevel = 0;
-  bool verbose;
+  bool verbose = false;
+  bool emitAssembly = false;
 
   /* 
    * Check the compiler arguments.
@@ -38,7 +46,7 @@ int main(
     return 1;
   }
   int32_t opt;
-  while ((opt = getopt(argc, argv, "vg:O:")) != -1) {
+  while ((opt = getopt(argc, argv, "vg:O:S")) != -1) {
     switch (opt){
       case 'O':
         optLevel = strtoul(optarg, NULL, 0);
@@ -52,6 +60,10 @@ int main(
         verbose = true;
         break ;
 
+      case 'S':
+        emitAssembly = true;
+        break ;
+
       default:
         print_help(argv[0]);
         return 1;
@@ -78,10 +90,33 @@ int main(
   }
 
   /*
-   * Generate x86_64 assembly.
+   * Clean up the instructions before they are translated one by one.
+   */
+  L1::peephole(p, optLevel);
+  L1::layout_blocks(p, optLevel);
+  L1::drop_leaf_frames(p, optLevel);
+  L1::inline_allocations(p, optLevel);
+  L1::compute_stack_maps(p, optLevel);
+  if (verbose){
+    L1::print_peephole_stats(std::cerr);
+    L1::print_layout_stats(std::cerr);
+  }
+
+  /*
+   * Generate x86_64 machine code, or assembly for debugging.
    */
   if (enable_code_generator){
-    L1::generate_code(p);
+    if (emitAssembly) {
+      L1::generate_code(p);
+    } else {
+      L1::generate_object(p, "prog.o");
+    }
+    if (verbose){
+      L1::print_idiom_stats(std::cerr);
+      L1::print_frame_stats(std::cerr);
+      L1::print_allocation_stats(std::cerr);
+      L1::print_stack_map_stats(std::cerr);
+    }
   }
 
   return 0;
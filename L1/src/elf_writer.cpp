@@ -0,0 +1,200 @@
+#include <elf.h>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <elf_writer.h>
+
+namespace L1 {
+
+  /**
+   *  section header indices, fixed layout
+   * */
+  enum SectionIdx {
+    sec_null,
+    sec_text,
+    sec_rela_text,
+    sec_symtab,
+    sec_strtab,
+    sec_shstrtab,
+    sec_note_stack,
+    sec_count
+  };
+
+  /**
+   *  NUL-separated string table, offset 0 is the empty string
+   * */
+  struct StringTable {
+    std::vector<char> bytes = {'\0'};
+
+    uint32_t add(const std::string & s) {
+      uint32_t offset = bytes.size();
+      bytes.insert(bytes.end(), s.begin(), s.end());
+      bytes.push_back('\0');
+      return offset;
+    }
+  };
+
+  static void append_bytes(std::vector<uint8_t> & out, const void * data, size_t size) {
+    const uint8_t * p = (const uint8_t *) data;
+    out.insert(out.end(), p, p + size);
+  }
+
+  static void align_to(std::vector<uint8_t> & out, size_t alignment) {
+    while (out.size() % alignment != 0) {
+      out.push_back(0);
+    }
+  }
+
+  void write_elf_object(const std::string & fileName, X86Encoder & encoder) {
+    StringTable strtab;
+    StringTable shstrtab;
+
+    /**
+     *  symbols: null, .text section, local functions, then globals
+     *      (ELF wants every local symbol before the first global one)
+     * */
+    std::vector<Elf64_Sym> symbols;
+    std::unordered_map<std::string, uint32_t> symbolIdx;
+
+    Elf64_Sym sym;
+    memset(&sym, 0, sizeof(sym));
+    symbols.push_back(sym);
+
+    sym.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    sym.st_shndx = sec_text;
+    symbols.push_back(sym);
+
+    for (auto & name : encoder.functions) {
+      memset(&sym, 0, sizeof(sym));
+      sym.st_name = strtab.add(name);
+      sym.st_info = ELF64_ST_INFO(STB_LOCAL, STT_FUNC);
+      sym.st_shndx = sec_text;
+      sym.st_value = encoder.labels.at(name);
+      symbols.push_back(sym);
+    }
+
+    uint32_t firstGlobal = symbols.size();
+
+    for (auto & name : encoder.globals) {
+      memset(&sym, 0, sizeof(sym));
+      sym.st_name = strtab.add(name);
+      sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+      sym.st_shndx = sec_text;
+      sym.st_value = encoder.labels.at(name);
+      symbolIdx[name] = symbols.size();
+      symbols.push_back(sym);
+    }
+
+    std::vector<Elf64_Rela> relas;
+    for (auto & reloc : encoder.relocations) {
+      uint32_t idx = 1;
+
+      if (!reloc.symbol.empty()) {
+        auto it = symbolIdx.find(reloc.symbol);
+
+        if (it == symbolIdx.end()) {
+          memset(&sym, 0, sizeof(sym));
+          sym.st_name = strtab.add(reloc.symbol);
+          sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+          sym.st_shndx = SHN_UNDEF;
+          it = symbolIdx.emplace(reloc.symbol, symbols.size()).first;
+          symbols.push_back(sym);
+        }
+        idx = it->second;
+      }
+
+      Elf64_Rela rela;
+      rela.r_offset = reloc.offset;
+      rela.r_info = ELF64_R_INFO(idx, reloc.type);
+      rela.r_addend = reloc.addend;
+      relas.push_back(rela);
+    }
+
+    /**
+     *  file layout: ELF header, section contents, section header table
+     * */
+    std::vector<Elf64_Shdr> sections(sec_count);
+    memset(sections.data(), 0, sizeof(Elf64_Shdr) * sec_count);
+
+    std::vector<uint8_t> file(sizeof(Elf64_Ehdr), 0);
+
+    auto place = [&](SectionIdx idx, const char * name, const void * data, size_t size, size_t alignment) {
+      align_to(file, alignment);
+      sections[idx].sh_name = shstrtab.add(name);
+      sections[idx].sh_offset = file.size();
+      sections[idx].sh_size = size;
+      sections[idx].sh_addralign = alignment;
+      append_bytes(file, data, size);
+    };
+
+    place(sec_text, ".text", encoder.text.data(), encoder.text.size(), 16);
+    sections[sec_text].sh_type = SHT_PROGBITS;
+    sections[sec_text].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+
+    place(sec_rela_text, ".rela.text", relas.data(), relas.size() * sizeof(Elf64_Rela), 8);
+    sections[sec_rela_text].sh_type = SHT_RELA;
+    sections[sec_rela_text].sh_flags = SHF_INFO_LINK;
+    sections[sec_rela_text].sh_link = sec_symtab;
+    sections[sec_rela_text].sh_info = sec_text;
+    sections[sec_rela_text].sh_entsize = sizeof(Elf64_Rela);
+
+    place(sec_symtab, ".symtab", symbols.data(), symbols.size() * sizeof(Elf64_Sym), 8);
+    sections[sec_symtab].sh_type = SHT_SYMTAB;
+    sections[sec_symtab].sh_link = sec_strtab;
+    sections[sec_symtab].sh_info = firstGlobal;
+    sections[sec_symtab].sh_entsize = sizeof(Elf64_Sym);
+
+    place(sec_strtab, ".strtab", strtab.bytes.data(), strtab.bytes.size(), 1);
+    sections[sec_strtab].sh_type = SHT_STRTAB;
+
+    /**
+     *  an empty .note.GNU-stack keeps the stack non-executable, as `as` does
+     *      names are added before .shstrtab is placed so it sees all of them
+     * */
+    uint32_t noteName = shstrtab.add(".note.GNU-stack");
+    uint32_t shstrtabName = shstrtab.add(".shstrtab");
+
+    align_to(file, 1);
+    sections[sec_shstrtab].sh_name = shstrtabName;
+    sections[sec_shstrtab].sh_type = SHT_STRTAB;
+    sections[sec_shstrtab].sh_offset = file.size();
+    sections[sec_shstrtab].sh_size = shstrtab.bytes.size();
+    sections[sec_shstrtab].sh_addralign = 1;
+    append_bytes(file, shstrtab.bytes.data(), shstrtab.bytes.size());
+
+    sections[sec_note_stack].sh_name = noteName;
+    sections[sec_note_stack].sh_type = SHT_PROGBITS;
+    sections[sec_note_stack].sh_offset = file.size();
+    sections[sec_note_stack].sh_addralign = 1;
+
+    align_to(file, 8);
+    uint64_t shoff = file.size();
+    append_bytes(file, sections.data(), sections.size() * sizeof(Elf64_Shdr));
+
+    Elf64_Ehdr ehdr;
+    memset(&ehdr, 0, sizeof(ehdr));
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    ehdr.e_type = ET_REL;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_shoff = shoff;
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_shentsize = sizeof(Elf64_Shdr);
+    ehdr.e_shnum = sec_count;
+    ehdr.e_shstrndx = sec_shstrtab;
+    memcpy(file.data(), &ehdr, sizeof(ehdr));
+
+    std::ofstream out(fileName, std::ios::binary);
+    if (!out) {
+      throw std::runtime_error("cannot open " + fileName);
+    }
+    out.write((const char *) file.data(), file.size());
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include <x86_encoder.h>
+
+namespace L1 {
+
+  /**
+   *  Write the finished @encoder as an ELF64 relocatable object
+   *      .text holds the code,
+   *      encoder.functions become local symbols, encoder.globals global ones,
+   *      symbols named in relocations but never defined are left undefined for the linker
+   * */
+  void write_elf_object(const std::string & fileName, X86Encoder & encoder);
+
+}
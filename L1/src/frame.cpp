@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <unordered_set>
+
+#include <frame.h>
+
+#define QUADSIZE 8
+#define REG_ARGS_NUM 6
+
+/**
+ *  bytes below rsp that signal handlers leave alone (System V ABI)
+ * */
+#define RED_ZONE_BYTES 128
+
+namespace L1{
+
+  static struct {
+    int64_t leafFrames;
+    int64_t savedRegisters;
+    int64_t tailCalls;
+  } stats;
+
+  /**
+   *  operands of @inst, comparisons are split into their two operands
+   * */
+  static std::vector<Item *> inst_items(Instruction * inst) {
+    std::vector<Item *> items;
+
+    switch (inst->type) {
+      case InstType::inst_assign:
+      {
+        Instruction_assignment * assign = (Instruction_assignment *) inst;
+        items = {assign->dst, assign->src};
+        break;
+      }
+
+      case InstType::inst_call:
+      {
+        Instruction_call * call = (Instruction_call *) inst;
+        if (!call->isRuntimeCall) {
+          items = {((Instruction_call_user *) call)->callee};
+        }
+        break;
+      }
+
+      case InstType::inst_aop:
+      {
+        Instruction_aop * aop = (Instruction_aop *) inst;
+        items = {aop->op1, aop->op2};
+        break;
+      }
+
+      case InstType::inst_sop:
+      {
+        Instruction_sop * sop = (Instruction_sop *) inst;
+        items = {sop->target, sop->offset};
+        break;
+      }
+
+      case InstType::inst_lea:
+      {
+        Instruction_lea * lea = (Instruction_lea *) inst;
+        items = {lea->dst, lea->addr, lea->multr};
+        break;
+      }
+
+      case InstType::inst_inc:
+        items = {((Instruction_inc *) inst)->op};
+        break;
+
+      case InstType::inst_dec:
+        items = {((Instruction_dec *) inst)->op};
+        break;
+
+      case InstType::inst_cjump:
+        items = {((Instruction_cjump *) inst)->condition};
+        break;
+
+      default:
+        break;
+    }
+
+    for (size_t i = 0; i < items.size(); i++) {
+      if (items[i]->itemtype == ItemType::item_cmp) {
+        ItemCmp * cmp = (ItemCmp *) items[i];
+        items[i] = cmp->op1;
+        items.push_back(cmp->op2);
+      }
+    }
+
+    return items;
+  }
+
+  /**
+   *  register named by @it, either directly or as a memory base
+   * */
+  static bool item_register(Item * it, Register_type & r) {
+    if (it->itemtype == ItemType::item_registers) {
+      r = ((ItemRegister *) it)->rType;
+      return true;
+    }
+
+    if (it->itemtype == ItemType::item_memory) {
+      r = ((ItemMemoryAccess *) it)->rType;
+      return true;
+    }
+
+    return false;
+  }
+
+  std::vector<Register_type> used_callee_saved(Program & p) {
+    static const Register_type calleeSaved[] = {rbx, rbp, r12, r13, r14, r15};
+
+    uint32_t mentioned = 0;
+    for (Function * f : p.functions) {
+      for (Instruction * inst : f->instructions) {
+        for (Item * it : inst_items(inst)) {
+          Register_type r;
+          if (item_register(it, r)) mentioned |= 1u << r;
+        }
+      }
+    }
+
+    std::vector<Register_type> used;
+    for (Register_type r : calleeSaved) {
+      if (mentioned & (1u << r)) used.push_back(r);
+    }
+
+    stats.savedRegisters = used.size();
+    return used;
+  }
+
+  /**
+   *  the memory accesses of @f based on rsp,
+   *      empty when @f calls something or uses rsp in any other way
+   * */
+  static bool leaf_stack_accesses(Function * f, std::unordered_set<ItemMemoryAccess *> & accesses) {
+    for (Instruction * inst : f->instructions) {
+      if (inst->type == InstType::inst_call) return false;
+
+      for (Item * it : inst_items(inst)) {
+        if (it->itemtype == ItemType::item_registers && ((ItemRegister *) it)->rType == rsp) {
+          return false;
+        }
+
+        if (it->itemtype != ItemType::item_memory) continue;
+
+        ItemMemoryAccess * mem = (ItemMemoryAccess *) it;
+        if (mem->rType != rsp) continue;
+
+        /**
+         *  something below the frame, only a caller would write there
+         * */
+        if (mem->offset < 0) return false;
+        accesses.insert(mem);
+      }
+    }
+
+    return true;
+  }
+
+  void drop_leaf_frames(Program & p, int32_t optLevel) {
+    if (optLevel < 1) return;
+
+    for (Function * f : p.functions) {
+      int64_t frameBytes = f->locals * QUADSIZE;
+      if (frameBytes == 0 || frameBytes > RED_ZONE_BYTES) continue;
+
+      std::unordered_set<ItemMemoryAccess *> accesses;
+      if (!leaf_stack_accesses(f, accesses)) continue;
+
+      /**
+       *  the same item may be shared by several instructions, move each one once
+       * */
+      for (ItemMemoryAccess * mem : accesses) {
+        mem->offset -= frameBytes;
+      }
+
+      f->locals = 0;
+      stats.leafFrames++;
+    }
+  }
+
+  TailCallFrame tail_call_frame(Function * f, Instruction_call_user * call) {
+    TailCallFrame frame;
+
+    /**
+     *  our return address sits right above the locals and the stack arguments of @f
+     * */
+    int64_t frameBytes = (f->locals + std::max<int64_t>(f->arguments - REG_ARGS_NUM, 0)) * QUADSIZE;
+
+    frame.stackArgs = std::max<int64_t>(((ItemConstant *) call->num_args)->constVal - REG_ARGS_NUM, 0);
+
+    /**
+     *  the first stack argument goes from -16(%rsp) right below the return address
+     * */
+    frame.argShift = frameBytes + QUADSIZE;
+    frame.rspShift = frameBytes - frame.stackArgs * QUADSIZE;
+
+    frame.scratch = rax;
+    if (call->callee->itemtype == ItemType::item_registers && ((ItemRegister *) call->callee)->rType == rax) {
+      frame.scratch = r10;
+    }
+
+    stats.tailCalls++;
+    return frame;
+  }
+
+  void print_frame_stats(std::ostream & out) {
+    out << "frame leaf functions without a frame: " << stats.leafFrames << '\n';
+    out << "frame callee-saved registers saved by go: " << stats.savedRegisters << '\n';
+    out << "frame tail calls: " << stats.tailCalls << '\n';
+  }
+}
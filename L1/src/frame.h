@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <L1.h>
+
+namespace L1{
+
+  /**
+   *  runtime.c's main takes the L1 stack to start 7 words below its rsp:
+   *      the return address of go and 6 words go reserves before calling the entry point
+   *  whatever go does not push it reserves with a subq, so that contract
+   *  and the alignment of the entry point stay as they are
+   * */
+  const int64_t GO_FRAME_BYTES = 48;
+
+  /**
+   *  callee-saved registers some instruction of @p mentions, in the order go pushes them
+   *      the others keep the value of the C caller anyway
+   * */
+  std::vector<Register_type> used_callee_saved(Program & p);
+
+  /**
+   *  Keep the locals of leaf functions in the red zone
+   *      a function that calls nothing and uses rsp only as a memory base
+   *      can hold up to 128 bytes of locals below rsp,
+   *      its rsp accesses move down by the size of the frame and Function::locals becomes 0,
+   *      so neither the subq on entry nor its part of the addq before returning is emitted
+   *  does nothing below -O1
+   * */
+  void drop_leaf_frames(Program & p, int32_t optLevel);
+
+  /**
+   *  How tail-call u N leaves the frame of @f to u
+   *      the caller of @f stored our return address and stack arguments,
+   *      the @stackArgs arguments of u, stored below rsp as for any call,
+   *      move up by @argShift bytes onto those of @f,
+   *      then rsp moves up by @rspShift bytes (down when negative) and we jump to u
+   *  @scratch carries the arguments, it is neither an argument register nor the callee
+   * */
+  struct TailCallFrame {
+    int64_t stackArgs;
+    int64_t argShift;
+    int64_t rspShift;
+    Register_type scratch;
+  };
+
+  TailCallFrame tail_call_frame(Function * f, Instruction_call_user * call);
+
+  void print_frame_stats(std::ostream & out);
+
+}
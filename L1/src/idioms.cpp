@@ -0,0 +1,199 @@
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <idioms.h>
+#include <code_generator.h>
+
+namespace L1{
+
+  static const char * const idiom_names[idiom_count] = {
+    "testq r, r", "xorl r, r", "xorl before setcc",
+    "lea add", "lea displacement", "lea shift-add",
+    "incq", "decq"
+  };
+
+  static int64_t idiom_hits[idiom_count] = {};
+
+  static bool is_register(Item * it) {
+    return it->itemtype == ItemType::item_registers;
+  }
+
+  static bool is_constant(Item * it) {
+    return it->itemtype == ItemType::item_constant;
+  }
+
+  static Register_type register_of(Item * it) {
+    return ((ItemRegister *) it)->rType;
+  }
+
+  static int64_t constant_of(Item * it) {
+    return ((ItemConstant *) it)->constVal;
+  }
+
+  static bool fits_int32(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+  }
+
+  bool test_zero_idiom(ItemCmp * cmp, Register_type & reg, CmpType & cmptype) {
+    if (is_register(cmp->op1) && is_constant(cmp->op2) && constant_of(cmp->op2) == 0) {
+      reg = register_of(cmp->op1);
+      cmptype = cmp->cmptype;
+      return true;
+    }
+
+    /**
+     *  0 {cmp} reg tests reg {reversed cmp} 0
+     * */
+    if (is_constant(cmp->op1) && constant_of(cmp->op1) == 0 && is_register(cmp->op2)) {
+      reg = register_of(cmp->op2);
+      cmptype = get_reverse_cmptype(cmp->cmptype);
+      return true;
+    }
+
+    return false;
+  }
+
+  bool xor_zero_idiom(Instruction_assignment * assign) {
+    return is_register(assign->dst)
+      && is_constant(assign->src)
+      && constant_of(assign->src) == 0;
+  }
+
+  bool xor_setcc_idiom(Instruction_assignment * assign) {
+    if (assign->src->itemtype != ItemType::item_cmp) return false;
+
+    ItemCmp * cmp = (ItemCmp *) assign->src;
+    if (is_constant(cmp->op1) && is_constant(cmp->op2)) return false;
+
+    Register_type dst = register_of(assign->dst);
+    for (Item * op : {cmp->op1, cmp->op2}) {
+      if (is_register(op) && register_of(op) == dst) return false;
+    }
+
+    return true;
+  }
+
+  /**
+   *  dst <- src with both registers
+   * */
+  static bool register_move(Instruction * inst, Register_type & dst, Register_type & src) {
+    if (inst->type != InstType::inst_assign) return false;
+
+    Instruction_assignment * assign = (Instruction_assignment *) inst;
+    if (!is_register(assign->dst) || !is_register(assign->src)) return false;
+
+    dst = register_of(assign->dst);
+    src = register_of(assign->src);
+    return true;
+  }
+
+  /**
+   *  @dst += or -= something, as the aop instruction it is
+   * */
+  static Instruction_aop * add_to(Instruction * inst, Register_type dst) {
+    if (inst->type != InstType::inst_aop) return NULL;
+
+    Instruction_aop * aop = (Instruction_aop *) inst;
+    if (aop->aopType != AopType::plus_eq && aop->aopType != AopType::minus_eq) return NULL;
+    if (!is_register(aop->op1) || register_of(aop->op1) != dst) return NULL;
+
+    return aop;
+  }
+
+  bool lea_idiom(std::vector<Instruction *> & insts, size_t pos, LeaIdiom & lea) {
+    Register_type dst, src;
+    if (pos + 1 >= insts.size() || !register_move(insts[pos], dst, src)) return false;
+
+    lea.dst = dst;
+    lea.scale = 1;
+    lea.disp = 0;
+
+    /**
+     *  d <- s
+     *  d <<= k         k in 1..3
+     *  d += t          t is not d
+     * */
+    if (insts[pos + 1]->type == InstType::inst_sop && pos + 2 < insts.size()) {
+      Instruction_sop * sop = (Instruction_sop *) insts[pos + 1];
+      Instruction_aop * aop = add_to(insts[pos + 2], dst);
+
+      if (sop->direction == ShiftType::left
+        && is_register(sop->target) && register_of(sop->target) == dst
+        && is_constant(sop->offset) && constant_of(sop->offset) >= 1 && constant_of(sop->offset) <= 3
+        && aop != NULL && aop->aopType == AopType::plus_eq
+        && is_register(aop->op2) && register_of(aop->op2) != dst
+        && src != rsp
+      ) {
+        lea.idiom = idiom_lea_shift_add;
+        lea.length = 3;
+        lea.base = register_of(aop->op2);
+        lea.hasIndex = true;
+        lea.index = src;
+        lea.scale = (int64_t) 1 << constant_of(sop->offset);
+        return true;
+      }
+
+      return false;
+    }
+
+    Instruction_aop * aop = add_to(insts[pos + 1], dst);
+    if (aop == NULL) return false;
+    lea.length = 2;
+    lea.base = src;
+
+    /**
+     *  d <- s
+     *  d += t          t is not d, rsp can only be the base
+     * */
+    if (is_register(aop->op2) && aop->aopType == AopType::plus_eq) {
+      Register_type t = register_of(aop->op2);
+      if (t == dst || (t == rsp && src == rsp)) return false;
+
+      lea.idiom = idiom_lea_add;
+      lea.hasIndex = true;
+      lea.index = t;
+      if (t == rsp) std::swap(lea.base, lea.index);
+      return true;
+    }
+
+    /**
+     *  d <- s
+     *  d += c  or  d -= c
+     * */
+    if (is_constant(aop->op2)) {
+      int64_t c = constant_of(aop->op2);
+      if (!fits_int32(c) || c == INT32_MIN) return false;
+
+      lea.idiom = idiom_lea_disp;
+      lea.hasIndex = false;
+      lea.disp = aop->aopType == AopType::plus_eq ? c : -c;
+      return true;
+    }
+
+    return false;
+  }
+
+  Idiom inc_dec_idiom(Instruction_aop * aop) {
+    if (!is_register(aop->op1) || !is_constant(aop->op2)) return idiom_count;
+
+    int64_t c = constant_of(aop->op2);
+    if (!fits_int32(c)) return idiom_count;
+    if (aop->aopType == AopType::minus_eq) c = -c;
+    else if (aop->aopType != AopType::plus_eq) return idiom_count;
+
+    if (c == 1) return idiom_inc;
+    if (c == -1) return idiom_dec;
+    return idiom_count;
+  }
+
+  void count_idiom(Idiom idiom) {
+    idiom_hits[idiom]++;
+  }
+
+  void print_idiom_stats(std::ostream & out) {
+    for (int32_t i = 0; i < idiom_count; i++) {
+      out << "idiom " << idiom_names[i] << ": " << idiom_hits[i] << '\n';
+    }
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <L1.h>
+
+namespace L1{
+
+  /**
+   *  Cheaper x86 forms of some L1 instructions,
+   *      picked the same way by code_generator.cpp and object_generator.cpp
+   * */
+  enum Idiom {
+    idiom_test_zero,      /* cmpq $0, r                 ==>> testq r, r */
+    idiom_xor_zero,       /* movq $0, r                 ==>> xorl r32, r32 */
+    idiom_xor_setcc,      /* cmpq; setcc; movzbq        ==>> xorl; cmpq; setcc */
+    idiom_lea_add,        /* movq s, d; addq t, d       ==>> leaq (s, t), d */
+    idiom_lea_disp,       /* movq s, d; addq $c, d      ==>> leaq c(s), d */
+    idiom_lea_shift_add,  /* movq s, d; salq $k, d; addq t, d  ==>> leaq (t, s, 2^k), d */
+    idiom_inc,            /* addq $1, r                 ==>> incq r */
+    idiom_dec,            /* subq $1, r                 ==>> decq r */
+    idiom_count
+  };
+
+  /**
+   *  leaq disp(base, index, scale), dst
+   *      standing for the @length instructions it replaces
+   * */
+  struct LeaIdiom {
+    Idiom idiom;
+    size_t length;
+    Register_type dst;
+    Register_type base;
+    bool hasIndex;
+    Register_type index;
+    int64_t scale;
+    int64_t disp;
+  };
+
+  /**
+   *  @cmp compares a register against 0,
+   *      sets @reg and the condition to test after testq reg, reg
+   * */
+  bool test_zero_idiom(ItemCmp * cmp, Register_type & reg, CmpType & cmptype);
+
+  /**
+   *  reg <- 0
+   * */
+  bool xor_zero_idiom(Instruction_assignment * assign);
+
+  /**
+   *  reg <- op1 {cmp} op2 where reg is neither op1 nor op2,
+   *      so reg can be cleared before the compare and movzbq is not needed
+   * */
+  bool xor_setcc_idiom(Instruction_assignment * assign);
+
+  /**
+   *  the instructions of @insts starting at @pos compute a single lea,
+   *      only looks at adjacent instructions, a label in between stops the match
+   * */
+  bool lea_idiom(std::vector<Instruction *> & insts, size_t pos, LeaIdiom & lea);
+
+  /**
+   *  idiom_inc or idiom_dec when @aop adds or subtracts 1 to a register,
+   *      idiom_count otherwise
+   * */
+  Idiom inc_dec_idiom(Instruction_aop * aop);
+
+  void count_idiom(Idiom idiom);
+
+  /**
+   *  how often each idiom was emitted so far
+   * */
+  void print_idiom_stats(std::ostream & out);
+
+}
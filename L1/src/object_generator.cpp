@@ -0,0 +1,466 @@
+#include <string>
+#include <iostream>
+#include <stdexcept>
+
+#include <code_generator.h>
+#include <x86_encoder.h>
+#include <elf_writer.h>
+#include <idioms.h>
+#include <frame.h>
+#include <allocation.h>
+#include <stack_map.h>
+
+#define QUADSIZE 8
+#define REG_ARGS_NUM 6
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+
+using namespace std;
+
+namespace L1{
+
+  /**
+   *  Same translation as code_generator.cpp, encoded straight to machine code
+   *      every output_* there has an encode_* here producing the same instructions
+   * */
+
+  static CondCode cond_code(CmpType cmptype) {
+    switch (cmptype) {
+      case CmpType::less:  return cc_l;
+      case CmpType::leq:   return cc_le;
+      case CmpType::eq:    return cc_e;
+      case CmpType::great: return cc_g;
+      case CmpType::geq:   return cc_ge;
+      case CmpType::neq:   return cc_ne;
+      default:
+        throw std::runtime_error("Error cmp type!");
+    }
+  }
+
+  /**
+   *  symbol used for an L1 label, same as the one in prog.S
+   * */
+  static std::string symbol_name(const std::string & labelName) {
+    return "_" + labelName.substr(1, labelName.length() - 1);
+  }
+
+  static Operand item_operand(Item * it) {
+    switch (it->itemtype) {
+      case ItemType::item_registers:
+        return opd_register(hw_register(((ItemRegister *) it)->rType));
+
+      case ItemType::item_constant:
+        return opd_immediate(((ItemConstant *) it)->constVal);
+
+      case ItemType::item_memory:
+      {
+        ItemMemoryAccess * im = (ItemMemoryAccess *) it;
+        return opd_memory(hw_register(im->rType), im->offset);
+      }
+
+      case ItemType::item_labels:
+        return opd_label_addr(symbol_name(((ItemLabel *) it)->labelName));
+
+      default:
+        throw std::runtime_error("item cannot be an instruction operand");
+    }
+  }
+
+  static int32_t item_register(Item * it) {
+    return hw_register(((ItemRegister *) it)->rType);
+  }
+
+  static void encode_stack_grow(X86Encoder & enc, int64_t bytes) {
+    enc.alu(alu_sub, opd_register(hw_register(rsp)), opd_immediate(bytes));
+  }
+
+  static void encode_stack_shrink(X86Encoder & enc, int64_t bytes) {
+    enc.alu(alu_add, opd_register(hw_register(rsp)), opd_immediate(bytes));
+  }
+
+  /**
+   *  cmpq (testq against 0) for op1 {cmp} op2, returns the condition to test afterwards
+   *      reverse op1 and op2 when op1 is a constant
+   * */
+  static CondCode encode_cmp(X86Encoder & enc, ItemCmp * cmp) {
+    Register_type reg;
+    CmpType cmptype;
+    if (test_zero_idiom(cmp, reg, cmptype)) {
+      count_idiom(idiom_test_zero);
+      enc.test(hw_register(reg), hw_register(reg));
+      return cond_code(cmptype);
+    }
+
+    cmptype = cmp->cmptype;
+
+    if (cmp->op1->itemtype == ItemType::item_constant) {
+      enc.alu(alu_cmp, item_operand(cmp->op2), item_operand(cmp->op1));
+      cmptype = get_reverse_cmptype(cmptype);
+    } else {
+      enc.alu(alu_cmp, item_operand(cmp->op1), item_operand(cmp->op2));
+    }
+
+    return cond_code(cmptype);
+  }
+
+  static bool both_constant(ItemCmp * cmp) {
+    return cmp->op1->itemtype == ItemType::item_constant
+      && cmp->op2->itemtype == ItemType::item_constant;
+  }
+
+  static int gen_constant_cmp(ItemCmp * cmp) {
+    return gen_cmp_result(
+      ((ItemConstant *) cmp->op1)->constVal,
+      ((ItemConstant *) cmp->op2)->constVal,
+      cmp->cmptype
+    );
+  }
+
+  static void encode_inst_assign(X86Encoder & enc, Instruction_assignment * assign) {
+    if (assign->src->itemtype != item_cmp) {
+      if (xor_zero_idiom(assign)) {
+        count_idiom(idiom_xor_zero);
+        int32_t dst = item_register(assign->dst);
+        enc.xor32(dst, dst);
+        return;
+      }
+
+      enc.alu(alu_mov, item_operand(assign->dst), item_operand(assign->src));
+      return;
+    }
+
+    ItemCmp * cmp = (ItemCmp *) assign->src;
+    if (both_constant(cmp)) {
+      enc.alu(alu_mov, item_operand(assign->dst), opd_immediate(gen_constant_cmp(cmp)));
+      return;
+    }
+
+    int32_t dst = item_register(assign->dst);
+    bool cleared = xor_setcc_idiom(assign);
+    if (cleared) {
+      count_idiom(idiom_xor_setcc);
+      enc.xor32(dst, dst);
+    }
+
+    CondCode cc = encode_cmp(enc, cmp);
+    enc.setcc(cc, dst);
+    if (!cleared) {
+      enc.movzbq(dst, dst);
+    }
+  }
+
+  /**
+   *  same sequence as output_allocate_fast
+   * */
+  static void encode_allocate_fast(X86Encoder & enc, Instruction_call_runtime * runtime_call) {
+    std::string slow = allocation_label(runtime_call->inlineSite, "slow");
+    std::string fill = allocation_label(runtime_call->inlineSite, "fill");
+    std::string done = allocation_label(runtime_call->inlineSite, "done");
+
+    Operand opdRax = opd_register(hw_register(rax));
+    Operand opdRcx = opd_register(hw_register(rcx));
+    Operand opdRdx = opd_register(hw_register(rdx));
+    Operand opdRsi = opd_register(hw_register(rsi));
+    Operand opdRdi = opd_register(hw_register(rdi));
+    Operand opdR8 = opd_register(hw_register(r8));
+    Operand allocptr = opd_memory(hw_register(rcx), NURSERY_ALLOCPTR_OFFSET);
+    Operand limit = opd_memory(hw_register(rcx), NURSERY_LIMIT_OFFSET);
+
+    enc.alu(alu_mov, opdRcx, opdRdi);
+    enc.alu(alu_and, opdRcx, opd_immediate(1));
+    enc.jcc(cc_e, slow);
+    enc.alu(alu_mov, opdRax, opdRdi);
+    enc.shift(shift_right, opdRax, opd_immediate(1));
+    enc.lea_disp(hw_register(rcx), hw_register(rax), -1);
+    enc.alu(alu_cmp, opdRcx, opd_immediate(ALLOCATE_INLINE_MAX - 1));
+    enc.jcc(cc_a, slow);
+
+    enc.alu(alu_mov, opdRcx, opd_label_addr("nursery"));
+    enc.alu(alu_mov, opdRdx, allocptr);
+    enc.lea(hw_register(r8), hw_register(rdx), hw_register(rax), QUADSIZE);
+    enc.alu(alu_add, opdR8, opd_immediate(QUADSIZE));
+    enc.alu(alu_cmp, opdR8, limit);
+    enc.jcc(cc_ge, slow);
+    enc.alu(alu_mov, allocptr, opdR8);
+
+    enc.alu(alu_mov, opd_memory(hw_register(rdx), 0), opdRax);
+    enc.lea_disp(hw_register(rcx), hw_register(rdx), QUADSIZE);
+    enc.define_label(fill);
+    enc.alu(alu_mov, opd_memory(hw_register(rcx), 0), opdRsi);
+    enc.alu(alu_add, opdRcx, opd_immediate(QUADSIZE));
+    enc.alu(alu_cmp, opdRcx, opdR8);
+    enc.jcc(cc_l, fill);
+    enc.alu(alu_mov, opdRax, opdRdx);
+    enc.jmp(done);
+
+    enc.define_label(slow);
+    enc.call("allocate");
+    enc.define_label(done);
+  }
+
+  static void encode_runtimeCall(X86Encoder & enc, Instruction_call_runtime * runtime_call) {
+    if (runtime_call->inlineSite >= 0) {
+      encode_allocate_fast(enc, runtime_call);
+      return;
+    }
+
+    if (runtime_call->callee != "tensor-error") {
+      enc.call(runtime_call->callee);
+      return;
+    }
+
+    switch (runtime_call->arg_cnt) {
+      case 1:
+        enc.call("array_tensor_error_null");
+        break;
+
+      case 3:
+        enc.call("array_error");
+        break;
+
+      case 4:
+        enc.call("tensor_error");
+        break;
+
+      default:
+        throw std::runtime_error("tensor-error with " + std::to_string(runtime_call->arg_cnt) + " arguments");
+    }
+  }
+
+  /**
+   *  same moves as output_tail_frame
+   * */
+  static void encode_tail_frame(X86Encoder & enc, Function * function, Instruction_call_user * user_call) {
+    TailCallFrame frame = tail_call_frame(function, user_call);
+    Operand scratch = opd_register(hw_register(frame.scratch));
+
+    for (int64_t i = 0; i < frame.stackArgs; i++) {
+      int64_t offset = -2 * QUADSIZE - i * QUADSIZE;
+      enc.alu(alu_mov, scratch, opd_memory(hw_register(rsp), offset));
+      enc.alu(alu_mov, opd_memory(hw_register(rsp), offset + frame.argShift), scratch);
+    }
+
+    if (frame.rspShift > 0) {
+      encode_stack_shrink(enc, frame.rspShift);
+    } else if (frame.rspShift < 0) {
+      encode_stack_grow(enc, -frame.rspShift);
+    }
+  }
+
+  static void encode_userCall(X86Encoder & enc, Function * function, Instruction_call_user * user_call) {
+    if (user_call->isTail) {
+      encode_tail_frame(enc, function, user_call);
+    } else {
+      int64_t quadToGrow = 1;
+      ItemConstant * c = (ItemConstant *) user_call->num_args;
+      quadToGrow += MAX(c->constVal - REG_ARGS_NUM, 0);
+
+      encode_stack_grow(enc, quadToGrow * QUADSIZE);
+    }
+
+    if (user_call->callee->itemtype == ItemType::item_registers) {
+      enc.jmp_indirect(item_register(user_call->callee));
+    } else {
+      enc.jmp(symbol_name(((ItemLabel *) user_call->callee)->labelName));
+    }
+  }
+
+  static void encode_aop_inst(X86Encoder & enc, Instruction_aop * aop) {
+    Operand dst = item_operand(aop->op1);
+    Operand src = item_operand(aop->op2);
+
+    Idiom incDec = inc_dec_idiom(aop);
+    if (incDec != idiom_count) {
+      count_idiom(incDec);
+      if (incDec == idiom_inc) enc.inc(dst);
+      else enc.dec(dst);
+      return;
+    }
+
+    switch (aop->aopType) {
+      case AopType::plus_eq:
+        enc.alu(alu_add, dst, src);
+        break;
+
+      case AopType::minus_eq:
+        enc.alu(alu_sub, dst, src);
+        break;
+
+      case AopType::times_eq:
+        enc.imul(dst, src);
+        break;
+
+      case AopType::bitand_eq:
+        enc.alu(alu_and, dst, src);
+        break;
+    }
+  }
+
+  static void encode_sop_inst(X86Encoder & enc, Instruction_sop * sop) {
+    ShiftOp op = sop->direction == ShiftType::left ? shift_left : shift_right;
+    enc.shift(op, item_operand(sop->target), item_operand(sop->offset));
+  }
+
+  static void encode_cjump_inst(X86Encoder & enc, Instruction_cjump * cjump) {
+    ItemCmp * cmp = (ItemCmp *) cjump->condition;
+    std::string target = symbol_name(((ItemLabel *) cjump->dst)->labelName);
+
+    if (both_constant(cmp)) {
+      if (gen_constant_cmp(cmp)) enc.jmp(target);
+      return;
+    }
+
+    enc.jcc(encode_cmp(enc, cmp), target);
+  }
+
+  static void encode_inst(X86Encoder & enc, Function * function, Instruction * inst) {
+    switch (inst->type) {
+      case InstType::inst_ret:
+      {
+        int64_t growedQuad = function->locals + MAX(function->arguments - REG_ARGS_NUM, 0);
+        if (growedQuad > 0) {
+          encode_stack_shrink(enc, growedQuad * QUADSIZE);
+        }
+        enc.ret();
+        break;
+      }
+
+      case InstType::inst_assign:
+        encode_inst_assign(enc, (Instruction_assignment *) inst);
+        break;
+
+      case InstType::inst_call:
+      {
+        Instruction_call * call = (Instruction_call *) inst;
+        if (call->isRuntimeCall) {
+          encode_runtimeCall(enc, (Instruction_call_runtime *) call);
+        } else {
+          encode_userCall(enc, function, (Instruction_call_user *) call);
+        }
+        break;
+      }
+
+      case InstType::inst_aop:
+        encode_aop_inst(enc, (Instruction_aop *) inst);
+        break;
+
+      case InstType::inst_sop:
+        encode_sop_inst(enc, (Instruction_sop *) inst);
+        break;
+
+      case InstType::inst_lea:
+      {
+        Instruction_lea * lea = (Instruction_lea *) inst;
+        enc.lea(
+          item_register(lea->dst),
+          item_register(lea->addr),
+          item_register(lea->multr),
+          ((ItemConstant *) lea->const_multr)->constVal
+        );
+        break;
+      }
+
+      case InstType::inst_goto:
+        enc.jmp(symbol_name(((ItemLabel *) ((Instruction_goto *) inst)->gotoLabel)->labelName));
+        break;
+
+      case InstType::inst_inc:
+        enc.inc(item_operand(((Instruction_inc *) inst)->op));
+        break;
+
+      case InstType::inst_dec:
+        enc.dec(item_operand(((Instruction_dec *) inst)->op));
+        break;
+
+      case InstType::inst_cjump:
+        encode_cjump_inst(enc, (Instruction_cjump *) inst);
+        break;
+
+      case InstType::inst_label:
+        enc.define_label(symbol_name(((Instruction_label *) inst)->labelName));
+        break;
+    }
+  }
+
+  static void encode_lea_idiom(X86Encoder & enc, LeaIdiom & lea) {
+    if (lea.hasIndex) {
+      enc.lea(hw_register(lea.dst), hw_register(lea.base), hw_register(lea.index), lea.scale);
+    } else {
+      enc.lea_disp(hw_register(lea.dst), hw_register(lea.base), lea.disp);
+    }
+  }
+
+  static void encode_function(X86Encoder & enc, Function * function) {
+    std::string name = symbol_name(function->name);
+    enc.define_label(name);
+    enc.functions.push_back(name);
+
+    if (function->locals > 0) {
+      encode_stack_grow(enc, function->locals * QUADSIZE);
+    }
+
+    std::vector<Instruction *> & insts = function->instructions;
+    for (size_t i = 0; i < insts.size(); ) {
+      LeaIdiom lea;
+      if (lea_idiom(insts, i, lea)) {
+        count_idiom(lea.idiom);
+        encode_lea_idiom(enc, lea);
+        i += lea.length;
+        continue;
+      }
+
+      encode_inst(enc, function, insts[i]);
+      i++;
+    }
+  }
+
+  void generate_object(Program & p, const std::string & fileName) {
+    X86Encoder enc;
+
+    /**
+     *  go: save the callee-saved registers the program uses and call the entry point,
+     *      the same sequence output_header/push_caller_save/... emit
+     * */
+    std::vector<Register_type> saved = used_callee_saved(p);
+    int64_t padding = GO_FRAME_BYTES - (int64_t) saved.size() * QUADSIZE;
+
+    enc.define_label("go");
+    enc.globals.push_back("go");
+
+    for (auto r : saved) {
+      enc.push(hw_register(r));
+    }
+    if (padding > 0) {
+      encode_stack_grow(enc, padding);
+    }
+    enc.call(symbol_name(p.entryPointLabel));
+    if (padding > 0) {
+      encode_stack_shrink(enc, padding);
+    }
+    for (auto r = saved.rbegin(); r != saved.rend(); r++) {
+      enc.pop(hw_register(*r));
+    }
+    enc.ret();
+
+    for (auto f : p.functions) {
+      encode_function(enc, f);
+    }
+
+    /**
+     *  stack_maps, as output_stack_maps writes it
+     * */
+    enc.align(4);
+    enc.define_label("stack_maps");
+    enc.globals.push_back("stack_maps");
+    for (StackMapWord & word : stack_map_table()) {
+      if (word.label.empty()) {
+        enc.data32(word.value);
+      } else {
+        enc.data32_label(word.label);
+      }
+    }
+
+    enc.finish();
+    write_elf_object(fileName, enc);
+  }
+}
@@ -69,6 +69,7 @@ namespace L1 {
    */
   struct str_return : TAOCPP_PEGTL_STRING( "return" ) {};
   struct str_call : TAOCPP_PEGTL_STRING( "call" ) {};
+  struct str_tail_call : TAOCPP_PEGTL_STRING( "tail-call" ) {};
   struct str_cjump : TAOCPP_PEGTL_STRING( "cjump" ) {};
   struct str_mem : TAOCPP_PEGTL_STRING( "mem" ) {};
   struct str_goto : TAOCPP_PEGTL_STRING( "goto" ) {};
@@ -604,6 +605,15 @@ namespace L1 {
       constant_number
     > {}; 
 
+  struct  Instruction_tail_call_rule:
+    pegtl::seq<
+      str_tail_call,
+      seps,
+      pegtl::sor<Label_rule, register_rule>,
+      seps,
+      constant_number
+    > {}; 
+
   
   struct  Instruction_label_rule:
     label {};
@@ -616,6 +626,7 @@ namespace L1 {
       pegtl::seq< pegtl::at<Instruction_assignment_rule>        , Instruction_assignment_rule         >,
       pegtl::seq< pegtl::at<Instruction_call_runtime_rule>      , Instruction_call_runtime_rule       >,
       pegtl::seq< pegtl::at<Instruction_call_user_rule>         , Instruction_call_user_rule       >,
+      pegtl::seq< pegtl::at<Instruction_tail_call_rule>         , Instruction_tail_call_rule       >,
       pegtl::seq< pegtl::at<Instruction_label_rule>             , Instruction_label_rule              >,
       pegtl::seq< pegtl::at<Instruction_aop_rule>               , Instruction_aop_rule                >,
       pegtl::seq< pegtl::at<Instruction_sop_rule>               , Instruction_sop_rule                >,
@@ -1347,6 +1358,19 @@ namespace L1 {
       // std::cerr << "done parsing\n" ;
     }
   };
+
+  /**
+   *  tail-call u N: a call to a user function that reuses the frame of the caller
+   * */
+  template<> struct action < Instruction_tail_call_rule > {
+    template< typename Input >
+	static void apply( const Input & in, Program & p){
+      action< Instruction_call_user_rule >::apply(in, p);
+
+      Instruction_call_user * usercall = (Instruction_call_user *) p.functions.back()->instructions.back();
+      usercall->isTail = true;
+    }
+  };
   
 
   template<> struct action < Instruction_call_runtime_rule > {
@@ -1596,4 +1620,21 @@ namespace L1 {
     return p;
   }
 
+  Program parse_input (const std::string & source, const std::string & sourceName){
+
+    /* 
+     * Check the grammar for some possible issues.
+     */
+    pegtl::analyze< grammar >();
+
+    /*
+     * Parse the in-memory text handed over by the driver.
+     */   
+    memory_input< > memoryInput(source, sourceName);
+    Program p;
+    parse< grammar, action >(memoryInput, p);
+
+    return p;
+  }
+
 }
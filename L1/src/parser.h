@@ -4,4 +4,5 @@
 
 namespace L1{
   Program parse_file (char *fileName);
+  Program parse_input (const std::string & source, const std::string & sourceName);
 }
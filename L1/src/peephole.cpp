@@ -0,0 +1,584 @@
+#include <string>
+#include <iostream>
+
+#include <peephole.h>
+
+#define REG_ARGS_NUM 6
+
+namespace L1{
+
+  static RegSet reg_bit(Register_type r) {
+    return 1u << r;
+  }
+
+  static const RegSet ALL_REGS = 0xFFFF;
+
+  static const RegSet CALLER_SAVED =
+    reg_bit(rax) | reg_bit(rcx) | reg_bit(rdx) | reg_bit(rsi) | reg_bit(rdi)
+    | reg_bit(r8) | reg_bit(r9) | reg_bit(r10) | reg_bit(r11);
+
+  static const Register_type ARG_REGS[REG_ARGS_NUM] = {rdi, rsi, rdx, rcx, r8, r9};
+
+  static RegSet arg_regs(int64_t n) {
+    RegSet set = 0;
+    for (int64_t i = 0; i < n && i < REG_ARGS_NUM; i++) {
+      set |= reg_bit(ARG_REGS[i]);
+    }
+    return set;
+  }
+
+  /**
+   *  registers read when @it is used as a source
+   * */
+  static RegSet item_uses(Item * it) {
+    switch (it->itemtype) {
+      case ItemType::item_registers:
+        return reg_bit(((ItemRegister *) it)->rType);
+
+      case ItemType::item_memory:
+        return reg_bit(((ItemMemoryAccess *) it)->rType);
+
+      case ItemType::item_cmp:
+      {
+        ItemCmp * cmp = (ItemCmp *) it;
+        return item_uses(cmp->op1) | item_uses(cmp->op2);
+      }
+
+      default:
+        return 0;
+    }
+  }
+
+  static bool is_register(Item * it, Register_type & r) {
+    if (it->itemtype != ItemType::item_registers) return false;
+    r = ((ItemRegister *) it)->rType;
+    return true;
+  }
+
+  static bool is_constant(Item * it, int64_t val) {
+    return it->itemtype == ItemType::item_constant && ((ItemConstant *) it)->constVal == val;
+  }
+
+  static bool same_memory(Item * a, Item * b) {
+    if (a->itemtype != ItemType::item_memory || b->itemtype != ItemType::item_memory) return false;
+
+    ItemMemoryAccess * ma = (ItemMemoryAccess *) a;
+    ItemMemoryAccess * mb = (ItemMemoryAccess *) b;
+    return ma->rType == mb->rType && ma->offset == mb->offset;
+  }
+
+  /**
+   *  registers read (@gen) and overwritten (@kill) by @inst
+   * */
+  static void inst_gen_kill(Instruction * inst, RegSet & gen, RegSet & kill) {
+    gen = 0;
+    kill = 0;
+
+    switch (inst->type) {
+      /**
+       *  L1 does not enforce a calling convention between its own functions,
+       *  hand-written tests hand values over in any register,
+       *  so returns and user calls read everything and clobber nothing
+       *  only the runtime is known to follow the C ABI
+       * */
+      case InstType::inst_ret:
+        gen = ALL_REGS;
+        break;
+
+      case InstType::inst_assign:
+      {
+        Instruction_assignment * assign = (Instruction_assignment *) inst;
+        gen = item_uses(assign->src);
+
+        Register_type r;
+        if (is_register(assign->dst, r)) kill = reg_bit(r);
+        else gen |= item_uses(assign->dst);
+        break;
+      }
+
+      case InstType::inst_call:
+      {
+        Instruction_call * call = (Instruction_call *) inst;
+        if (call->isRuntimeCall) {
+          gen = arg_regs(REG_ARGS_NUM);
+          kill = CALLER_SAVED;
+        } else {
+          gen = ALL_REGS;
+        }
+        break;
+      }
+
+      case InstType::inst_aop:
+      {
+        Instruction_aop * aop = (Instruction_aop *) inst;
+        gen = item_uses(aop->op1) | item_uses(aop->op2);
+        break;
+      }
+
+      case InstType::inst_sop:
+      {
+        Instruction_sop * sop = (Instruction_sop *) inst;
+        gen = item_uses(sop->target) | item_uses(sop->offset);
+        break;
+      }
+
+      case InstType::inst_lea:
+      {
+        Instruction_lea * lea = (Instruction_lea *) inst;
+        gen = item_uses(lea->addr) | item_uses(lea->multr);
+        kill = item_uses(lea->dst);
+        break;
+      }
+
+      case InstType::inst_inc:
+        gen = item_uses(((Instruction_inc *) inst)->op);
+        break;
+
+      case InstType::inst_dec:
+        gen = item_uses(((Instruction_dec *) inst)->op);
+        break;
+
+      case InstType::inst_cjump:
+        gen = item_uses(((Instruction_cjump *) inst)->condition);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  /**
+   *  Register liveness over the instructions of one function
+   *      a call to a user function is a jmp, it comes back at one of the labels
+   *      whose address the function stores (its return labels)
+   *  a jump to a label outside the function keeps every register alive
+   *  rsp is always live
+   * */
+  static void compute_liveness(PeepholeWindow & w) {
+    std::vector<Instruction *> & insts = w.insts;
+    size_t n = insts.size();
+
+    std::unordered_map<std::string, size_t> labelIdx;
+    for (size_t i = 0; i < n; i++) {
+      if (insts[i]->type == InstType::inst_label) {
+        labelIdx[((Instruction_label *) insts[i])->labelName] = i;
+      }
+    }
+
+    std::vector<int64_t> returnPoints;
+    for (size_t i = 0; i < n; i++) {
+      if (insts[i]->type != InstType::inst_assign) continue;
+
+      Item * src = ((Instruction_assignment *) insts[i])->src;
+      if (src->itemtype != ItemType::item_labels) continue;
+
+      auto it = labelIdx.find(((ItemLabel *) src)->labelName);
+      if (it != labelIdx.end()) returnPoints.push_back(it->second);
+    }
+
+    std::vector<RegSet> gen(n), kill(n), in(n, 0), out(n, 0);
+    std::vector<std::vector<int64_t>> succs(n);
+
+    for (size_t i = 0; i < n; i++) {
+      inst_gen_kill(insts[i], gen[i], kill[i]);
+
+      std::string target;
+      bool fallThrough = true;
+
+      switch (insts[i]->type) {
+        case InstType::inst_ret:
+          fallThrough = false;
+          break;
+
+        case InstType::inst_goto:
+          target = ((ItemLabel *) ((Instruction_goto *) insts[i])->gotoLabel)->labelName;
+          fallThrough = false;
+          break;
+
+        case InstType::inst_cjump:
+          target = ((ItemLabel *) ((Instruction_cjump *) insts[i])->dst)->labelName;
+          break;
+
+        case InstType::inst_call:
+          if (!((Instruction_call *) insts[i])->isRuntimeCall) {
+            /**
+             *  a tail call never comes back
+             * */
+            if (!((Instruction_call_user *) insts[i])->isTail) succs[i] = returnPoints;
+            fallThrough = false;
+          }
+          break;
+
+        default:
+          break;
+      }
+
+      if (!target.empty()) {
+        auto it = labelIdx.find(target);
+        succs[i].push_back(it == labelIdx.end() ? -1 : (int64_t) it->second);
+      }
+      if (fallThrough && i + 1 < n) {
+        succs[i].push_back(i + 1);
+      }
+    }
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+
+      for (size_t k = n; k-- > 0; ) {
+        RegSet newOut = 0;
+        for (int64_t s : succs[k]) {
+          newOut |= s < 0 ? ALL_REGS : in[s];
+        }
+        RegSet newIn = gen[k] | (newOut & ~kill[k]);
+
+        if (newOut != out[k] || newIn != in[k]) {
+          out[k] = newOut;
+          in[k] = newIn;
+          changed = true;
+        }
+      }
+    }
+
+    w.liveOut.clear();
+    for (size_t i = 0; i < n; i++) {
+      w.liveOut[insts[i]] = out[i] | reg_bit(rsp);
+    }
+  }
+
+  static bool is_live_after(PeepholeWindow & w, Instruction * inst, Register_type r) {
+    auto it = w.liveOut.find(inst);
+    return it == w.liveOut.end() || (it->second & reg_bit(r));
+  }
+
+  /**
+   *  replace @count instructions at @pos with @inst (NULL for none),
+   *      @inst is live out wherever the last replaced instruction was
+   * */
+  static void replace(PeepholeWindow & w, size_t pos, size_t count, Instruction * inst) {
+    RegSet liveOut = ALL_REGS;
+    auto it = w.liveOut.find(w.insts[pos + count - 1]);
+    if (it != w.liveOut.end()) liveOut = it->second;
+
+    w.insts.erase(w.insts.begin() + pos, w.insts.begin() + pos + count);
+
+    if (inst != NULL) {
+      w.insts.insert(w.insts.begin() + pos, inst);
+      w.liveOut[inst] = liveOut;
+    }
+  }
+
+  /**
+   *  register written by @inst when that is all it does, so it can go if the register is dead
+   * */
+  static bool pure_register_def(Instruction * inst, Register_type & r) {
+    switch (inst->type) {
+      case InstType::inst_assign:
+        return is_register(((Instruction_assignment *) inst)->dst, r);
+
+      case InstType::inst_aop:
+        return is_register(((Instruction_aop *) inst)->op1, r);
+
+      case InstType::inst_sop:
+        return is_register(((Instruction_sop *) inst)->target, r);
+
+      case InstType::inst_lea:
+        return is_register(((Instruction_lea *) inst)->dst, r);
+
+      case InstType::inst_inc:
+        return is_register(((Instruction_inc *) inst)->op, r);
+
+      case InstType::inst_dec:
+        return is_register(((Instruction_dec *) inst)->op, r);
+
+      default:
+        return false;
+    }
+  }
+
+  /**
+   *  w <- w
+   * */
+  static bool rewrite_self_move(PeepholeWindow & w, size_t pos) {
+    if (w.insts[pos]->type != InstType::inst_assign) return false;
+
+    Instruction_assignment * assign = (Instruction_assignment *) w.insts[pos];
+    Register_type dst, src;
+    if (!is_register(assign->dst, dst) || !is_register(assign->src, src) || dst != src) return false;
+
+    replace(w, pos, 1, NULL);
+    return true;
+  }
+
+  /**
+   *  w += 0, w -= 0, w *= 1, w &= -1, w <<= 0, w >>= 0
+   * */
+  static bool rewrite_identity_op(PeepholeWindow & w, size_t pos) {
+    Instruction * inst = w.insts[pos];
+
+    if (inst->type == InstType::inst_aop) {
+      Instruction_aop * aop = (Instruction_aop *) inst;
+      int64_t identity;
+      switch (aop->aopType) {
+        case AopType::plus_eq:
+        case AopType::minus_eq:
+          identity = 0;
+          break;
+
+        case AopType::times_eq:
+          identity = 1;
+          break;
+
+        case AopType::bitand_eq:
+          identity = -1;
+          break;
+
+        default:
+          return false;
+      }
+      if (!is_constant(aop->op2, identity)) return false;
+
+    } else if (inst->type == InstType::inst_sop) {
+      if (!is_constant(((Instruction_sop *) inst)->offset, 0)) return false;
+
+    } else {
+      return false;
+    }
+
+    replace(w, pos, 1, NULL);
+    return true;
+  }
+
+  /**
+   *  w <- ... with w dead afterwards
+   * */
+  static bool rewrite_dead_def(PeepholeWindow & w, size_t pos) {
+    Register_type r;
+    if (!pure_register_def(w.insts[pos], r) || r == rsp) return false;
+    if (is_live_after(w, w.insts[pos], r)) return false;
+
+    replace(w, pos, 1, NULL);
+    return true;
+  }
+
+  /**
+   *  the result of a comparison, if @inst is  w <- a cmp b
+   * */
+  static ItemCmp * cmp_assign(Instruction * inst, Register_type & w) {
+    if (inst->type != InstType::inst_assign) return NULL;
+
+    Instruction_assignment * assign = (Instruction_assignment *) inst;
+    if (assign->src->itemtype != ItemType::item_cmp || !is_register(assign->dst, w)) return NULL;
+
+    return (ItemCmp *) assign->src;
+  }
+
+  static bool invert_cmptype(CmpType cmptype, CmpType & inverted) {
+    switch (cmptype) {
+      case CmpType::less:  inverted = CmpType::geq;  return true;
+      case CmpType::leq:   inverted = CmpType::great; return true;
+      case CmpType::great: inverted = CmpType::leq;  return true;
+      case CmpType::geq:   inverted = CmpType::less; return true;
+      case CmpType::eq:    inverted = CmpType::neq;  return true;
+      case CmpType::neq:   inverted = CmpType::eq;   return true;
+      default:
+        return false;
+    }
+  }
+
+  /**
+   *  w <- a cmp b
+   *  cjump w = 1 :L      ==>>  cjump a cmp b :L
+   *  (cjump w = 0 :L     ==>>  cjump a !cmp b :L)
+   *  when w is dead after the cjump, so no set/movzbq is needed at all
+   * */
+  static bool rewrite_cmp_into_cjump(PeepholeWindow & w, size_t pos) {
+    Register_type r;
+    ItemCmp * cmp = cmp_assign(w.insts[pos], r);
+    if (cmp == NULL || w.insts[pos + 1]->type != InstType::inst_cjump) return false;
+
+    Instruction_cjump * cjump = (Instruction_cjump *) w.insts[pos + 1];
+    ItemCmp * cond = (ItemCmp *) cjump->condition;
+    if (cond->cmptype != CmpType::eq) return false;
+
+    Register_type tested;
+    Item * other;
+    if (is_register(cond->op1, tested)) other = cond->op2;
+    else if (is_register(cond->op2, tested)) other = cond->op1;
+    else return false;
+    if (tested != r || is_live_after(w, cjump, r)) return false;
+
+    ItemCmp * fused = new ItemCmp();
+    fused->itemtype = ItemType::item_cmp;
+    fused->op1 = cmp->op1;
+    fused->op2 = cmp->op2;
+
+    if (is_constant(other, 1)) {
+      fused->cmptype = cmp->cmptype;
+    } else if (!is_constant(other, 0) || !invert_cmptype(cmp->cmptype, fused->cmptype)) {
+      return false;
+    }
+
+    Instruction_cjump * newJump = new Instruction_cjump();
+    newJump->type = InstType::inst_cjump;
+    newJump->dst = cjump->dst;
+    newJump->condition = fused;
+
+    replace(w, pos, 2, newJump);
+    return true;
+  }
+
+  /**
+   *  w <- a cmp b
+   *  w2 <- w             ==>>  w2 <- a cmp b
+   *  when w is dead after the copy
+   * */
+  static bool rewrite_cmp_copy(PeepholeWindow & w, size_t pos) {
+    Register_type r;
+    ItemCmp * cmp = cmp_assign(w.insts[pos], r);
+    if (cmp == NULL || w.insts[pos + 1]->type != InstType::inst_assign) return false;
+
+    Instruction_assignment * copy = (Instruction_assignment *) w.insts[pos + 1];
+    Register_type src, dst;
+    if (!is_register(copy->src, src) || src != r || !is_register(copy->dst, dst) || dst == rsp) return false;
+    if (is_live_after(w, copy, r)) return false;
+
+    Instruction_assignment * fused = new Instruction_assignment();
+    fused->type = InstType::inst_assign;
+    fused->dst = copy->dst;
+    fused->src = cmp;
+
+    replace(w, pos, 2, fused);
+    return true;
+  }
+
+  /**
+   *  w <- a cmp b
+   *  w &= 1              ==>>  w <- a cmp b
+   *  movzbq already cleared everything above bit 0
+   * */
+  static bool rewrite_cmp_mask(PeepholeWindow & w, size_t pos) {
+    Register_type r;
+    if (cmp_assign(w.insts[pos], r) == NULL || w.insts[pos + 1]->type != InstType::inst_aop) return false;
+
+    Instruction_aop * aop = (Instruction_aop *) w.insts[pos + 1];
+    Register_type masked;
+    if (aop->aopType != AopType::bitand_eq || !is_register(aop->op1, masked) || masked != r) return false;
+    if (!is_constant(aop->op2, 1)) return false;
+
+    replace(w, pos + 1, 1, NULL);
+    return true;
+  }
+
+  /**
+   *  mem x M <- s
+   *  w <- mem x M        ==>>  w <- s
+   * */
+  static bool rewrite_store_load(PeepholeWindow & w, size_t pos) {
+    if (w.insts[pos]->type != InstType::inst_assign || w.insts[pos + 1]->type != InstType::inst_assign) return false;
+
+    Instruction_assignment * store = (Instruction_assignment *) w.insts[pos];
+    Instruction_assignment * load = (Instruction_assignment *) w.insts[pos + 1];
+    if (!same_memory(store->dst, load->src)) return false;
+    if (store->src->itemtype == ItemType::item_memory) return false;
+
+    Instruction_assignment * forwarded = new Instruction_assignment();
+    forwarded->type = InstType::inst_assign;
+    forwarded->dst = load->dst;
+    forwarded->src = store->src;
+
+    replace(w, pos + 1, 1, forwarded);
+    return true;
+  }
+
+  /**
+   *  goto :L / cjump ... :L  followed by labels that include :L
+   * */
+  static bool rewrite_jump_to_next(PeepholeWindow & w, size_t pos) {
+    Instruction * inst = w.insts[pos];
+    std::string target;
+
+    if (inst->type == InstType::inst_goto) {
+      target = ((ItemLabel *) ((Instruction_goto *) inst)->gotoLabel)->labelName;
+    } else if (inst->type == InstType::inst_cjump) {
+      target = ((ItemLabel *) ((Instruction_cjump *) inst)->dst)->labelName;
+    } else {
+      return false;
+    }
+
+    for (size_t i = pos + 1; i < w.insts.size() && w.insts[i]->type == InstType::inst_label; i++) {
+      if (((Instruction_label *) w.insts[i])->labelName == target) {
+        replace(w, pos, 1, NULL);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   *  the pattern table, tried in order at every position
+   * */
+  static std::vector<PeepholePattern> patterns = {
+    {"self_move",       1, rewrite_self_move,       0},
+    {"identity_op",     1, rewrite_identity_op,     0},
+    {"cmp_into_cjump",  2, rewrite_cmp_into_cjump,  0},
+    {"cmp_copy",        2, rewrite_cmp_copy,        0},
+    {"cmp_mask",        2, rewrite_cmp_mask,        0},
+    {"store_load",      2, rewrite_store_load,      0},
+    {"jump_to_next",    2, rewrite_jump_to_next,    0},
+    {"dead_def",        1, rewrite_dead_def,        0},
+  };
+
+  /**
+   *  @return true if any pattern fired
+   * */
+  static bool peephole_round(Function * f) {
+    PeepholeWindow w(f->instructions);
+    compute_liveness(w);
+
+    bool changed = false;
+    size_t pos = 0;
+
+    while (pos < w.insts.size()) {
+      bool hit = false;
+
+      for (PeepholePattern & pattern : patterns) {
+        if (pos + pattern.window > w.insts.size()) continue;
+
+        if (pattern.rewrite(w, pos)) {
+          pattern.hits++;
+          hit = true;
+          break;
+        }
+      }
+
+      if (!hit) {
+        pos++;
+        continue;
+      }
+
+      /**
+       *  the rewritten instructions may now match with the one before them
+       * */
+      changed = true;
+      if (pos > 0) pos--;
+    }
+
+    return changed;
+  }
+
+  void peephole(Program & p, int32_t optLevel) {
+    if (optLevel < 1) return;
+
+    for (auto f : p.functions) {
+      while (peephole_round(f)) {}
+    }
+  }
+
+  void print_peephole_stats(std::ostream & out) {
+    for (PeepholePattern & pattern : patterns) {
+      out << "peephole " << pattern.name << ": " << pattern.hits << '\n';
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <L1.h>
+
+namespace L1{
+
+  /**
+   *  one bit per Register_type
+   * */
+  typedef uint32_t RegSet;
+
+  /**
+   *  Instructions of the function being optimized
+   *      with the registers live after each of them
+   *  liveOut is computed once per round, rewrites only ever shorten live ranges
+   *  so a stale entry is still a safe over-approximation
+   * */
+  struct PeepholeWindow {
+    std::vector<Instruction *> & insts;
+    std::unordered_map<Instruction *, RegSet> liveOut;
+
+    PeepholeWindow(std::vector<Instruction *> & insts) : insts(insts) {}
+  };
+
+  /**
+   *  One row of the pattern table
+   *      @rewrite looks at the @window instructions starting at @pos,
+   *      edits them in place and returns true when the pattern matched
+   * */
+  struct PeepholePattern {
+    std::string name;
+    size_t window;
+    bool (*rewrite)(PeepholeWindow & w, size_t pos);
+    int64_t hits;
+  };
+
+  /**
+   *  Run the peephole patterns over every function of @p until none applies
+   *      does nothing below -O1
+   * */
+  void peephole(Program & p, int32_t optLevel);
+
+  /**
+   *  hit counters of every pattern so far
+   * */
+  void print_peephole_stats(std::ostream & out);
+
+}
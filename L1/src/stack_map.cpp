@@ -0,0 +1,610 @@
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+
+#include <bit_vector.h>
+#include <cfg.h>
+#include <stack_map.h>
+#include <allocation.h>
+
+#define QUADSIZE 8
+#define REG_ARGS_NUM 6
+#define REG_NUM 16
+
+namespace L1{
+
+  using Dataflow::BitVector;
+  using Dataflow::BasicBlock;
+  using Dataflow::ControlFlowGraph;
+  using Dataflow::BlockLivenessSolver;
+
+  static struct {
+    int64_t sites;
+    int64_t frameWords;
+    int64_t slots;
+    int64_t conservative;
+  } stats;
+
+  static std::vector<StackMap> maps;
+
+  /**
+   *  callee-saved registers in the order the allocate stub of runtime.c stores them
+   * */
+  static const Register_type STUB_SAVED[] = {rbx, rbp, r12, r13, r14, r15};
+
+  static const Register_type CALLER_SAVED[] = {rax, rcx, rdx, rsi, rdi, r8, r9, r10, r11};
+
+  /**
+   *  one bit per register (REG_NUM of them) followed by one per word of the frame
+   * */
+  typedef BitVector WordSet;
+
+  static void assign_word(WordSet & words, int64_t idx, bool value) {
+    if (value) {
+      words.set(idx);
+    } else {
+      words.reset(idx);
+    }
+  }
+
+  /**
+   *  word of the frame @it stands for, if it is  mem rsp K  with K inside a frame of @frameWords words
+   * */
+  static bool frame_word(Item * it, int64_t frameWords, int64_t & word) {
+    if (it->itemtype != ItemType::item_memory) return false;
+
+    ItemMemoryAccess * mem = (ItemMemoryAccess *) it;
+    if (mem->rType != rsp || mem->offset < 0 || mem->offset >= frameWords * QUADSIZE) return false;
+
+    word = mem->offset / QUADSIZE;
+    return true;
+  }
+
+  /**
+   *  operands @inst reads and the one it writes (NULL for none),
+   *      @derived: the value written comes from the operands read, not from a comparison
+   *  calls are left to the callers, they clobber registers instead
+   * */
+  static void inst_operands(Instruction * inst, std::vector<Item *> & reads, Item * & dst, bool & derived) {
+    reads.clear();
+    dst = NULL;
+    derived = true;
+
+    switch (inst->type) {
+      case InstType::inst_assign:
+      {
+        Instruction_assignment * assign = (Instruction_assignment *) inst;
+        dst = assign->dst;
+        if (assign->src->itemtype == ItemType::item_cmp) {
+          ItemCmp * cmp = (ItemCmp *) assign->src;
+          reads = {cmp->op1, cmp->op2};
+          derived = false;
+        } else {
+          reads = {assign->src};
+        }
+        break;
+      }
+
+      case InstType::inst_aop:
+      {
+        Instruction_aop * aop = (Instruction_aop *) inst;
+        reads = {aop->op1, aop->op2};
+        dst = aop->op1;
+        break;
+      }
+
+      case InstType::inst_sop:
+      {
+        Instruction_sop * sop = (Instruction_sop *) inst;
+        reads = {sop->target, sop->offset};
+        dst = sop->target;
+        break;
+      }
+
+      case InstType::inst_lea:
+      {
+        Instruction_lea * lea = (Instruction_lea *) inst;
+        reads = {lea->addr, lea->multr};
+        dst = lea->dst;
+        break;
+      }
+
+      case InstType::inst_inc:
+        reads = {((Instruction_inc *) inst)->op};
+        dst = reads[0];
+        break;
+
+      case InstType::inst_dec:
+        reads = {((Instruction_dec *) inst)->op};
+        dst = reads[0];
+        break;
+
+      case InstType::inst_cjump:
+      {
+        ItemCmp * cmp = (ItemCmp *) ((Instruction_cjump *) inst)->condition;
+        reads = {cmp->op1, cmp->op2};
+        break;
+      }
+
+      case InstType::inst_call:
+      {
+        Instruction_call * call = (Instruction_call *) inst;
+        if (!call->isRuntimeCall) reads = {((Instruction_call_user *) call)->callee};
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  /**
+   *  whether the frame of @f is only reached through  mem rsp K  inside of it,
+   *  or below it for the arguments of a call
+   * */
+  static bool follows_frame(Function * f, int64_t frameWords) {
+    std::vector<Item *> reads;
+    Item * dst;
+    bool derived;
+
+    for (Instruction * inst : f->instructions) {
+      inst_operands(inst, reads, dst, derived);
+      if (dst != NULL) reads.push_back(dst);
+
+      for (Item * it : reads) {
+        if (it->itemtype == ItemType::item_registers && ((ItemRegister *) it)->rType == rsp) return false;
+        if (it->itemtype != ItemType::item_memory) continue;
+
+        ItemMemoryAccess * mem = (ItemMemoryAccess *) it;
+        if (mem->rType != rsp || mem->offset < 0) continue;
+        if (mem->offset >= frameWords * QUADSIZE || mem->offset % QUADSIZE != 0) return false;
+      }
+    }
+
+    return true;
+  }
+
+  static bool may_hold_array(Item * it, WordSet & words, int64_t frameWords) {
+    switch (it->itemtype) {
+      case ItemType::item_registers:
+        return words.test(((ItemRegister *) it)->rType);
+
+      case ItemType::item_memory:
+      {
+        int64_t word;
+        return frame_word(it, frameWords, word) ? words.test(REG_NUM + word) : true;
+      }
+
+      /**
+       *  numbers, labels and comparisons
+       * */
+      default:
+        return false;
+    }
+  }
+
+  /**
+   *  registers and words of the frame that may hold an array after @inst
+   * */
+  static void transfer(Instruction * inst, WordSet & words, int64_t frameWords) {
+    if (inst->type == InstType::inst_call) {
+      Instruction_call * call = (Instruction_call *) inst;
+
+      /**
+       *  the runtime follows the C ABI, user functions may leave anything in any register
+       * */
+      if (call->isRuntimeCall) {
+        for (Register_type r : CALLER_SAVED) words.set(r);
+      } else {
+        for (int64_t r = 0; r < REG_NUM; r++) words.set(r);
+      }
+      return;
+    }
+
+    std::vector<Item *> reads;
+    Item * dst;
+    bool derived;
+    inst_operands(inst, reads, dst, derived);
+    if (dst == NULL) return;
+
+    bool value = false;
+    if (derived) {
+      for (Item * it : reads) value = value || may_hold_array(it, words, frameWords);
+    }
+
+    int64_t word;
+    if (dst->itemtype == ItemType::item_registers) {
+      assign_word(words, ((ItemRegister *) dst)->rType, value);
+    } else if (frame_word(dst, frameWords, word)) {
+      assign_word(words, REG_NUM + word, value);
+    }
+  }
+
+  /**
+   *  words of the frame read (@gen) and overwritten (@kill) by @inst
+   * */
+  static void frame_gen_kill(Instruction * inst, int64_t frameWords, BitVector & gen, BitVector & kill) {
+    std::vector<Item *> reads;
+    Item * dst;
+    bool derived;
+    inst_operands(inst, reads, dst, derived);
+
+    int64_t word;
+    for (Item * it : reads) {
+      if (frame_word(it, frameWords, word)) gen.set(word);
+    }
+    if (inst->type == InstType::inst_assign && frame_word(dst, frameWords, word)) {
+      kill.set(word);
+    }
+  }
+
+  /**
+   *  label -> function of every label defined in @p
+   * */
+  static std::unordered_map<std::string, Function *> label_owners(Program & p) {
+    std::unordered_map<std::string, Function *> owners;
+
+    for (Function * f : p.functions) {
+      for (Instruction * inst : f->instructions) {
+        if (inst->type == InstType::inst_label) owners[((Instruction_label *) inst)->labelName] = f;
+      }
+    }
+
+    return owners;
+  }
+
+  /**
+   *  the label the user call @insts[call] returns to, -1 when it cannot be told:
+   *      the one stored at  mem rsp -8  in the straight-line run before the call
+   * */
+  static int32_t return_point(
+    std::vector<Instruction *> & insts,
+    int32_t call,
+    std::unordered_map<std::string, int32_t> & labelIdx
+  ) {
+    std::vector<Item *> reads;
+    Item * dst;
+    bool derived;
+
+    for (int32_t k = call - 1; k >= 0; k--) {
+      Instruction * inst = insts[k];
+      if (inst->type == InstType::inst_label || inst->type == InstType::inst_goto
+          || inst->type == InstType::inst_ret || inst->type == InstType::inst_call) {
+        return -1;
+      }
+
+      inst_operands(inst, reads, dst, derived);
+      if (dst == NULL || dst->itemtype != ItemType::item_memory) continue;
+
+      ItemMemoryAccess * mem = (ItemMemoryAccess *) dst;
+      if (mem->rType != rsp || mem->offset != -QUADSIZE) continue;
+
+      Item * src = (inst->type == InstType::inst_assign) ? ((Instruction_assignment *) inst)->src : NULL;
+      if (src == NULL || src->itemtype != ItemType::item_labels) return -1;
+
+      auto it = labelIdx.find(((ItemLabel *) src)->labelName);
+      return (it == labelIdx.end()) ? -1 : it->second;
+    }
+
+    return -1;
+  }
+
+  /**
+   *  successors of each instruction of @f, @returnPoints the labels whose address @f stores
+   *      a call to a user function is a jmp, it comes back at the return label stored for it,
+   *      or at any of them when that one cannot be told
+   *  false when @f jumps to, or stores, a label of another function
+   * */
+  static bool function_flow(
+    Function * f,
+    std::unordered_map<std::string, Function *> & owners,
+    std::vector<std::vector<int32_t>> & succs,
+    std::vector<int32_t> & returnPoints
+  ) {
+    std::vector<Instruction *> & insts = f->instructions;
+    int32_t n = insts.size();
+
+    std::unordered_map<std::string, int32_t> labelIdx;
+    for (int32_t i = 0; i < n; i++) {
+      if (insts[i]->type == InstType::inst_label) {
+        labelIdx[((Instruction_label *) insts[i])->labelName] = i;
+      }
+    }
+
+    for (int32_t i = 0; i < n; i++) {
+      if (insts[i]->type != InstType::inst_assign) continue;
+
+      Item * src = ((Instruction_assignment *) insts[i])->src;
+      if (src->itemtype != ItemType::item_labels) continue;
+
+      const std::string & labelName = ((ItemLabel *) src)->labelName;
+      auto it = labelIdx.find(labelName);
+      if (it != labelIdx.end()) {
+        returnPoints.push_back(it->second);
+      } else if (owners.count(labelName)) {
+        return false;
+      }
+    }
+
+    succs.assign(n, {});
+    for (int32_t i = 0; i < n; i++) {
+      std::string target;
+      bool fallThrough = true;
+
+      switch (insts[i]->type) {
+        case InstType::inst_ret:
+          fallThrough = false;
+          break;
+
+        case InstType::inst_goto:
+          target = ((ItemLabel *) ((Instruction_goto *) insts[i])->gotoLabel)->labelName;
+          fallThrough = false;
+          break;
+
+        case InstType::inst_cjump:
+          target = ((ItemLabel *) ((Instruction_cjump *) insts[i])->dst)->labelName;
+          break;
+
+        case InstType::inst_call:
+          if (!((Instruction_call *) insts[i])->isRuntimeCall) {
+            if (!((Instruction_call_user *) insts[i])->isTail) {
+              int32_t back = return_point(insts, i, labelIdx);
+              if (back >= 0) {
+                succs[i].push_back(back);
+              } else {
+                succs[i] = returnPoints;
+              }
+            }
+            fallThrough = false;
+          }
+          break;
+
+        default:
+          break;
+      }
+
+      if (!target.empty()) {
+        auto it = labelIdx.find(target);
+        if (it == labelIdx.end()) return false;
+        succs[i].push_back(it->second);
+      }
+      if (fallThrough && i + 1 < n) {
+        succs[i].push_back(i + 1);
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   *  what may hold an array before each instruction,
+   *      everything does on entry: the arguments and whatever the words of the frame held before
+   *  a forward worklist over the blocks of @cfg in reverse postorder,
+   *  the transfer copies bits from operand to operand, so it is not one for BlockLivenessSolver
+   * */
+  static std::vector<WordSet> may_hold_arrays(
+    Function * f,
+    int64_t frameWords,
+    ControlFlowGraph & cfg
+  ) {
+    int32_t width = REG_NUM + frameWords;
+    int32_t n = f->instructions.size();
+    std::vector<WordSet> in(n, WordSet(width));
+    if (n == 0) return in;
+
+    int32_t block_num = cfg.blocks.size();
+    std::vector<WordSet> blockIn(block_num, WordSet(width));
+    std::vector<WordSet> blockOut(block_num, WordSet(width));
+    for (int32_t w = 0; w < width; w++) blockIn[0].set(w);
+
+    /**
+     *  worklist ordered by reverse postorder rank,
+     *      so a block is preferably visited after the blocks that flow into it
+     * */
+    std::vector<int32_t> rank(block_num);
+    for (int32_t r = 0; r < block_num; r++) {
+      rank[cfg.postorder[r]] = block_num - 1 - r;
+    }
+
+    std::set<int32_t> worklist;
+    for (int32_t r = 0; r < block_num; r++) {
+      worklist.insert(r);
+    }
+
+    while (!worklist.empty()) {
+      int32_t b = cfg.postorder[block_num - 1 - *worklist.begin()];
+      worklist.erase(worklist.begin());
+
+      BasicBlock & bb = cfg.blocks[b];
+      WordSet words = blockIn[b];
+      for (int32_t i = bb.first; i <= bb.last; i++) {
+        transfer(f->instructions[i], words, frameWords);
+      }
+
+      /**
+       *  the transfer is monotone, the block OUT only grows
+       * */
+      if (!blockOut[b].union_with(words)) continue;
+
+      for (int32_t succ : bb.succs) {
+        if (blockIn[succ].union_with(blockOut[b])) worklist.insert(rank[succ]);
+      }
+    }
+
+    for (int32_t b = 0; b < block_num; b++) {
+      BasicBlock & bb = cfg.blocks[b];
+      WordSet words = blockIn[b];
+      for (int32_t i = bb.first; i <= bb.last; i++) {
+        in[i] = words;
+        transfer(f->instructions[i], words, frameWords);
+      }
+    }
+
+    return in;
+  }
+
+  /**
+   *  the maps of the calls of @f, in code order,
+   *      false when @f cannot have any
+   * */
+  static bool function_maps(
+    Function * f,
+    std::unordered_map<std::string, Function *> & owners,
+    std::vector<StackMap> & fmaps
+  ) {
+    int64_t frameWords = f->locals + std::max<int64_t>(f->arguments - REG_ARGS_NUM, 0);
+    if (!follows_frame(f, frameWords)) return false;
+
+    std::vector<std::vector<int32_t>> succs;
+    std::vector<int32_t> returnPoints;
+    if (!function_flow(f, owners, succs, returnPoints)) return false;
+
+    ControlFlowGraph cfg;
+    cfg.build(succs);
+
+    std::vector<WordSet> arrays = may_hold_arrays(f, frameWords, cfg);
+
+    /**
+     *  words of the frame read later on, after each instruction
+     * */
+    std::vector<Instruction *> & insts = f->instructions;
+    std::vector<BitVector> gen(insts.size(), BitVector(frameWords));
+    std::vector<BitVector> kill(insts.size(), BitVector(frameWords));
+    for (size_t k = 0; k < insts.size(); k++) {
+      frame_gen_kill(insts[k], frameWords, gen[k], kill[k]);
+    }
+
+    BlockLivenessSolver live(cfg, gen, kill, frameWords);
+    live.solve();
+
+    std::vector<bool> isReturnPoint(insts.size(), false);
+    for (int32_t k : returnPoints) isReturnPoint[k] = true;
+
+    /**
+     *  only labels take no bytes, a map for a label right after another site
+     *  has the same return address and joins it
+     * */
+    bool sameAddress = false;
+
+    for (size_t k = 0; k < insts.size(); k++) {
+      Instruction * inst = insts[k];
+      StackMap site;
+      WordSet words;
+      BitVector * liveAfter;
+
+      if (inst->type == InstType::inst_label) {
+        if (!isReturnPoint[k]) continue;
+
+        site.label = ((Instruction_label *) inst)->labelName;
+        site.label = "_" + site.label.substr(1);
+        words = arrays[k];
+
+        /**
+         *  live after a label is live before the instruction that follows it
+         * */
+        liveAfter = &live.get_OUT(k);
+
+      } else if (inst->type == InstType::inst_call && ((Instruction_call *) inst)->isRuntimeCall
+                 && ((Instruction_call_runtime *) inst)->callee == "allocate") {
+        Instruction_call_runtime * call = (Instruction_call_runtime *) inst;
+        if (call->inlineSite < 0) return false;
+
+        site.label = allocation_label(call->inlineSite, "done");
+        words = arrays[k];
+        transfer(inst, words, frameWords);
+        liveAfter = &live.get_OUT(k);
+        sameAddress = false;
+
+      } else {
+        sameAddress = false;
+        continue;
+      }
+
+      site.frameWords = frameWords;
+      site.registers = 0;
+      if (inst->type == InstType::inst_call) {
+        for (size_t i = 0; i < sizeof(STUB_SAVED) / sizeof(STUB_SAVED[0]); i++) {
+          if (words.test(STUB_SAVED[i])) site.registers |= 1u << i;
+        }
+      }
+      for (int64_t w = 0; w < frameWords; w++) {
+        if (liveAfter->test(w) && words.test(REG_NUM + w)) site.slots.push_back(w);
+      }
+
+      if (sameAddress) {
+        StackMap & previous = fmaps.back();
+        previous.registers |= site.registers;
+        std::vector<int64_t> slots;
+        std::set_union(
+          previous.slots.begin(), previous.slots.end(),
+          site.slots.begin(), site.slots.end(),
+          std::back_inserter(slots)
+        );
+        previous.slots = slots;
+      } else {
+        fmaps.push_back(site);
+      }
+      sameAddress = true;
+    }
+
+    return true;
+  }
+
+  void compute_stack_maps(Program & p, int32_t optLevel) {
+    maps.clear();
+    if (optLevel < 1) return;
+
+    std::unordered_map<std::string, Function *> owners = label_owners(p);
+
+    /**
+     *  a function without maps only costs its own frames:
+     *      the runtime scans conservatively from the first frame it finds no map for
+     * */
+    for (Function * f : p.functions) {
+      std::vector<StackMap> fmaps;
+      if (!function_maps(f, owners, fmaps)) {
+        stats.conservative++;
+        continue;
+      }
+      maps.insert(maps.end(), fmaps.begin(), fmaps.end());
+    }
+
+    for (StackMap & map : maps) {
+      stats.sites++;
+      stats.frameWords += map.frameWords;
+      stats.slots += map.slots.size();
+    }
+  }
+
+  std::vector<StackMapWord> stack_map_table() {
+    std::vector<StackMapWord> table;
+    table.push_back({"", (int64_t) maps.size()});
+
+    int64_t offset = (1 + 2 * (int64_t) maps.size()) * 4;
+    for (StackMap & map : maps) {
+      table.push_back({map.label, 0});
+      table.push_back({"", offset});
+      offset += (3 + (int64_t) map.slots.size()) * 4;
+    }
+
+    for (StackMap & map : maps) {
+      table.push_back({"", map.frameWords});
+      table.push_back({"", map.registers});
+      table.push_back({"", (int64_t) map.slots.size()});
+      for (int64_t slot : map.slots) {
+        table.push_back({"", slot});
+      }
+    }
+
+    return table;
+  }
+
+  void print_stack_map_stats(std::ostream & out) {
+    out << "stack maps: " << stats.sites << " call sites, "
+        << stats.slots << " of " << stats.frameWords << " frame words may hold arrays\n";
+    if (stats.conservative > 0) {
+      out << "stack maps: none for " << stats.conservative << " functions that use their frame in a way they cannot describe\n";
+    }
+  }
+}
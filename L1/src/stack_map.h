@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <L1.h>
+
+namespace L1{
+
+  /**
+   *  Where the arrays are in a frame that waits for a call
+   *      @label is the return address of the call:
+   *      the end of a call allocate or a return label of a call to a user function,
+   *      the frame is the @frameWords words above rsp (the locals and the stack arguments),
+   *      the return address of the function sits right above it
+   *  @slots are the words of the frame that may hold an array and are read afterwards,
+   *  @registers the callee-saved registers that may hold one across call allocate
+   *  (bit i for the i-th one the allocate stub stores: rbx, rbp, r12, r13, r14, r15)
+   * */
+  struct StackMap {
+    std::string label;
+    int64_t frameWords;
+    uint32_t registers;
+    std::vector<int64_t> slots;
+  };
+
+  /**
+   *  one 32-bit word of the table runtime.c reads as stack_maps:
+   *      the address of @label when it is not empty, @value otherwise
+   *  the number of maps, a (return address, offset of the map) pair for each one,
+   *  sorted by return address, then the maps: frame words, registers, number of slots, slots
+   * */
+  struct StackMapWord {
+    std::string label;
+    int64_t value;
+  };
+
+  /**
+   *  Compute the stack maps of @p, so the gc only looks at the words that may hold arrays
+   *      a word is left out when it is never read again
+   *      or when it can only hold a number, a label or a comparison
+   *  no map for the calls of a function that uses its frame in a way this cannot follow
+   *  (rsp other than as a memory base, words above its frame, labels of other functions),
+   *  the runtime then scans the stack from that function's frame down
+   *  has to run after inline_allocations, whose labels end the call allocate
+   *  does nothing below -O1
+   * */
+  void compute_stack_maps(Program & p, int32_t optLevel);
+
+  /**
+   *  the words of stack_maps, the same in prog.S and prog.o
+   * */
+  std::vector<StackMapWord> stack_map_table();
+
+  void print_stack_map_stats(std::ostream & out);
+
+}
@@ -0,0 +1,401 @@
+#include <stdexcept>
+
+#include <x86_encoder.h>
+
+namespace L1 {
+
+  int32_t hw_register(Register_type rtype) {
+    switch (rtype) {
+      case rax: return 0;
+      case rcx: return 1;
+      case rdx: return 2;
+      case rbx: return 3;
+      case rsp: return 4;
+      case rbp: return 5;
+      case rsi: return 6;
+      case rdi: return 7;
+      case r8:  return 8;
+      case r9:  return 9;
+      case r10: return 10;
+      case r11: return 11;
+      case r12: return 12;
+      case r13: return 13;
+      case r14: return 14;
+      case r15: return 15;
+      default:
+        throw std::runtime_error("no hardware register for register type " + std::to_string(rtype));
+    }
+  }
+
+  Operand opd_register(int32_t reg) {
+    Operand opd = {opd_reg, reg, 0, 0, ""};
+    return opd;
+  }
+
+  Operand opd_memory(int32_t base, int64_t disp) {
+    Operand opd = {opd_mem, base, disp, 0, ""};
+    return opd;
+  }
+
+  Operand opd_immediate(int64_t imm) {
+    Operand opd = {opd_imm, -1, 0, imm, ""};
+    return opd;
+  }
+
+  Operand opd_label_addr(const std::string & label) {
+    Operand opd = {opd_label, -1, 0, 0, label};
+    return opd;
+  }
+
+  static bool fits_int8(int64_t v) {
+    return v >= INT8_MIN && v <= INT8_MAX;
+  }
+
+  static bool fits_int32(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+  }
+
+  void X86Encoder::emit8(uint8_t b) {
+    text.push_back(b);
+  }
+
+  void X86Encoder::emit32(int32_t v) {
+    for (int32_t i = 0; i < 4; i++) {
+      emit8((uint32_t) v >> (8 * i));
+    }
+  }
+
+  void X86Encoder::emit64(int64_t v) {
+    for (int32_t i = 0; i < 8; i++) {
+      emit8((uint64_t) v >> (8 * i));
+    }
+  }
+
+  void X86Encoder::emit_rex(bool w, int32_t reg, int32_t index, int32_t base, bool force) {
+    uint8_t rex = 0x40;
+    if (w) rex |= 0x08;
+    if (reg >= 8) rex |= 0x04;
+    if (index >= 8) rex |= 0x02;
+    if (base >= 8) rex |= 0x01;
+
+    if (rex != 0x40 || force) emit8(rex);
+  }
+
+  void X86Encoder::emit_modrm(int32_t reg, Operand & rm) {
+    if (rm.kind == opd_reg) {
+      emit8(0xC0 | ((reg & 7) << 3) | (rm.reg & 7));
+      return;
+    }
+
+    if (rm.kind != opd_mem) {
+      throw std::runtime_error("operand is neither a register nor memory");
+    }
+
+    /**
+     *  rbp/r13 as base always need a displacement,
+     *  rsp/r12 as base always need a SIB byte
+     * */
+    uint8_t mod;
+    if (rm.disp == 0 && (rm.reg & 7) != 5) mod = 0x00;
+    else if (fits_int8(rm.disp)) mod = 0x40;
+    else if (fits_int32(rm.disp)) mod = 0x80;
+    else throw std::runtime_error("memory displacement does not fit in 32 bits");
+
+    emit8(mod | ((reg & 7) << 3) | (rm.reg & 7));
+    if ((rm.reg & 7) == 4) emit8(0x24);
+
+    if (mod == 0x40) emit8(rm.disp);
+    else if (mod == 0x80) emit32(rm.disp);
+  }
+
+  void X86Encoder::emit_rm(std::vector<uint8_t> opcode, int32_t reg, Operand & rm) {
+    emit_rex(true, reg, 0, rm.reg, false);
+    for (uint8_t b : opcode) {
+      emit8(b);
+    }
+    emit_modrm(reg, rm);
+  }
+
+  void X86Encoder::emit_label_imm32(const std::string & label) {
+    fixups.push_back({text.size(), label, fix_abs});
+    emit32(0);
+  }
+
+  void X86Encoder::define_label(const std::string & label) {
+    /**
+     *  the same label twice in a row is harmless (as accepts it too)
+     * */
+    auto it = labels.find(label);
+    if (it != labels.end() && it->second != (int64_t) text.size()) {
+      throw std::runtime_error("label " + label + " defined twice");
+    }
+    labels[label] = text.size();
+  }
+
+  /**
+   *  opcodes of  op r/m, reg | op reg, r/m | op r/m, imm (the /digit)
+   * */
+  struct AluEncoding {
+    uint8_t rm_reg;
+    uint8_t reg_rm;
+    uint8_t ext;
+  };
+
+  static AluEncoding alu_encoding(AluOp op) {
+    switch (op) {
+      case alu_add: return {0x01, 0x03, 0};
+      case alu_sub: return {0x29, 0x2B, 5};
+      case alu_and: return {0x21, 0x23, 4};
+      case alu_cmp: return {0x39, 0x3B, 7};
+      case alu_mov: return {0x89, 0x8B, 0};
+      default:
+        throw std::runtime_error("unknown alu operation");
+    }
+  }
+
+  void X86Encoder::alu(AluOp op, Operand dst, Operand src) {
+    AluEncoding enc = alu_encoding(op);
+
+    if (dst.kind != opd_reg && dst.kind != opd_mem) {
+      throw std::runtime_error("destination of an alu operation must be a register or memory");
+    }
+
+    switch (src.kind) {
+      case opd_reg:
+        emit_rm({enc.rm_reg}, src.reg, dst);
+        return;
+
+      case opd_mem:
+        if (dst.kind != opd_reg) {
+          throw std::runtime_error("alu operation with two memory operands");
+        }
+        emit_rm({enc.reg_rm}, dst.reg, src);
+        return;
+
+      case opd_label:
+        emit_rm({(uint8_t) (op == alu_mov ? 0xC7 : 0x81)}, enc.ext, dst);
+        emit_label_imm32(src.label);
+        return;
+
+      case opd_imm:
+        if (op != alu_mov && fits_int8(src.imm)) {
+          emit_rm({0x83}, enc.ext, dst);
+          emit8(src.imm);
+        } else if (fits_int32(src.imm)) {
+          emit_rm({(uint8_t) (op == alu_mov ? 0xC7 : 0x81)}, enc.ext, dst);
+          emit32(src.imm);
+        } else if (op == alu_mov && dst.kind == opd_reg) {
+          /**
+           *  movabs $imm64, %reg
+           * */
+          emit_rex(true, 0, 0, dst.reg, false);
+          emit8(0xB8 | (dst.reg & 7));
+          emit64(src.imm);
+        } else {
+          throw std::runtime_error("immediate " + std::to_string(src.imm) + " does not fit in 32 bits");
+        }
+        return;
+    }
+  }
+
+  void X86Encoder::imul(Operand dst, Operand src) {
+    if (dst.kind != opd_reg) {
+      throw std::runtime_error("destination of imul must be a register");
+    }
+
+    switch (src.kind) {
+      case opd_reg:
+      case opd_mem:
+        emit_rm({0x0F, 0xAF}, dst.reg, src);
+        return;
+
+      case opd_imm:
+        if (fits_int8(src.imm)) {
+          emit_rm({0x6B}, dst.reg, dst);
+          emit8(src.imm);
+        } else if (fits_int32(src.imm)) {
+          emit_rm({0x69}, dst.reg, dst);
+          emit32(src.imm);
+        } else {
+          throw std::runtime_error("immediate " + std::to_string(src.imm) + " does not fit in 32 bits");
+        }
+        return;
+
+      default:
+        throw std::runtime_error("label operand of imul");
+    }
+  }
+
+  void X86Encoder::shift(ShiftOp op, Operand dst, Operand count) {
+    if (count.kind == opd_reg) {
+      if (count.reg != 1) {
+        throw std::runtime_error("shift count must be in rcx");
+      }
+      emit_rm({0xD3}, op, dst);
+    } else if (count.kind == opd_imm && count.imm == 1) {
+      emit_rm({0xD1}, op, dst);
+    } else if (count.kind == opd_imm) {
+      emit_rm({0xC1}, op, dst);
+      emit8(count.imm);
+    } else {
+      throw std::runtime_error("shift count must be rcx or a constant");
+    }
+  }
+
+  void X86Encoder::lea(int32_t dst, int32_t base, int32_t index, int64_t scale) {
+    if ((index & 15) == 4) {
+      throw std::runtime_error("rsp cannot be an index register");
+    }
+
+    uint8_t ss;
+    switch (scale) {
+      case 1: ss = 0; break;
+      case 2: ss = 1; break;
+      case 4: ss = 2; break;
+      case 8: ss = 3; break;
+      default:
+        throw std::runtime_error("invalid lea scale " + std::to_string(scale));
+    }
+
+    emit_rex(true, dst, index, base, false);
+    emit8(0x8D);
+
+    /**
+     *  rbp/r13 as base need mod 01 with a zero disp8
+     * */
+    bool needDisp = (base & 7) == 5;
+    emit8((needDisp ? 0x44 : 0x04) | ((dst & 7) << 3));
+    emit8((ss << 6) | ((index & 7) << 3) | (base & 7));
+    if (needDisp) emit8(0);
+  }
+
+  void X86Encoder::lea_disp(int32_t dst, int32_t base, int64_t disp) {
+    Operand addr = opd_memory(base, disp);
+    emit_rm({0x8D}, dst, addr);
+  }
+
+  void X86Encoder::test(int32_t dst, int32_t src) {
+    Operand rm = opd_register(dst);
+    emit_rm({0x85}, src, rm);
+  }
+
+  void X86Encoder::xor32(int32_t dst, int32_t src) {
+    emit_rex(false, src, 0, dst, false);
+    emit8(0x31);
+    emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+  }
+
+  void X86Encoder::setcc(CondCode cc, int32_t reg8) {
+    /**
+     *  without REX, 4-7 would mean ah/ch/dh/bh instead of spl/bpl/sil/dil
+     * */
+    emit_rex(false, 0, 0, reg8, reg8 >= 4);
+    emit8(0x0F);
+    emit8(0x90 | cc);
+    emit8(0xC0 | (reg8 & 7));
+  }
+
+  void X86Encoder::movzbq(int32_t dst, int32_t src8) {
+    Operand src = opd_register(src8);
+    emit_rm({0x0F, 0xB6}, dst, src);
+  }
+
+  void X86Encoder::inc(Operand dst) {
+    emit_rm({0xFF}, 0, dst);
+  }
+
+  void X86Encoder::dec(Operand dst) {
+    emit_rm({0xFF}, 1, dst);
+  }
+
+  void X86Encoder::push(int32_t reg) {
+    emit_rex(false, 0, 0, reg, false);
+    emit8(0x50 | (reg & 7));
+  }
+
+  void X86Encoder::pop(int32_t reg) {
+    emit_rex(false, 0, 0, reg, false);
+    emit8(0x58 | (reg & 7));
+  }
+
+  void X86Encoder::ret() {
+    emit8(0xC3);
+  }
+
+  void X86Encoder::jmp(const std::string & label) {
+    emit8(0xE9);
+    fixups.push_back({text.size(), label, fix_rel});
+    emit32(0);
+  }
+
+  void X86Encoder::jmp_indirect(int32_t reg) {
+    emit_rex(false, 0, 0, reg, false);
+    emit8(0xFF);
+    emit8(0xE0 | (reg & 7));
+  }
+
+  void X86Encoder::jcc(CondCode cc, const std::string & label) {
+    emit8(0x0F);
+    emit8(0x80 | cc);
+    fixups.push_back({text.size(), label, fix_rel});
+    emit32(0);
+  }
+
+  void X86Encoder::call(const std::string & label) {
+    emit8(0xE8);
+    fixups.push_back({text.size(), label, fix_call});
+    emit32(0);
+  }
+
+  void X86Encoder::align(int64_t bytes) {
+    while (text.size() % bytes != 0) {
+      emit8(0);
+    }
+  }
+
+  void X86Encoder::data32(int32_t value) {
+    emit32(value);
+  }
+
+  void X86Encoder::data32_label(const std::string & label) {
+    fixups.push_back({text.size(), label, fix_data});
+    emit32(0);
+  }
+
+  void X86Encoder::finish() {
+    for (Fixup & fix : fixups) {
+      auto it = labels.find(fix.label);
+
+      if (fix.kind == fix_abs || fix.kind == fix_data) {
+        uint32_t type = fix.kind == fix_abs ? RELOC_32S : RELOC_32;
+        if (it == labels.end()) {
+          /**
+           *  data of the runtime, the linker fills it in
+           * */
+          relocations.push_back({fix.offset, type, fix.label, 0});
+        } else {
+          relocations.push_back({fix.offset, type, "", it->second});
+        }
+        continue;
+      }
+
+      if (it == labels.end()) {
+        if (fix.kind != fix_call) {
+          throw std::runtime_error("jump to undefined label " + fix.label);
+        }
+
+        /**
+         *  call into the runtime, the linker fills it in
+         * */
+        relocations.push_back({fix.offset, RELOC_PLT32, fix.label, -4});
+        continue;
+      }
+
+      int64_t rel = it->second - (int64_t) (fix.offset + 4);
+      for (int32_t i = 0; i < 4; i++) {
+        text[fix.offset + i] = (uint32_t) rel >> (8 * i);
+      }
+    }
+    fixups.clear();
+  }
+}
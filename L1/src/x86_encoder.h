@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <L1.h>
+
+namespace L1 {
+
+  /**
+   *  x86-64 relocation types we emit (System V ABI)
+   * */
+  const uint32_t RELOC_PLT32 = 4;   /* call to an external function */
+  const uint32_t RELOC_32 = 10;     /* label address as a zero-extended 32-bit word of data */
+  const uint32_t RELOC_32S = 11;    /* label address as a sign-extended imm32, needs -no-pie */
+
+  /**
+   *  a relocation against .text
+   *      @symbol empty means the .text section itself (@addend is then the label offset)
+   * */
+  struct Relocation {
+    uint64_t offset;
+    uint32_t type;
+    std::string symbol;
+    int64_t addend;
+  };
+
+  enum OperandKind {opd_reg, opd_mem, opd_imm, opd_label};
+
+  /**
+   *  operand of a single machine instruction
+   *      reg/base are hardware register numbers (rax = 0 ... r15 = 15)
+   * */
+  struct Operand {
+    OperandKind kind;
+    int32_t reg;
+    int64_t disp;
+    int64_t imm;
+    std::string label;
+  };
+
+  enum AluOp {alu_add, alu_sub, alu_and, alu_cmp, alu_mov};
+  enum CondCode {cc_e = 0x4, cc_ne = 0x5, cc_a = 0x7, cc_l = 0xC, cc_ge = 0xD, cc_le = 0xE, cc_g = 0xF};
+  enum ShiftOp {shift_left = 4, shift_right = 7};
+
+  int32_t hw_register(Register_type rtype);
+
+  Operand opd_register(int32_t reg);
+  Operand opd_memory(int32_t base, int64_t disp);
+  Operand opd_immediate(int64_t imm);
+  Operand opd_label_addr(const std::string & label);
+
+  /**
+   *  Encodes x86-64 instructions straight into the bytes of .text
+   *      labels may be used before they are defined,
+   *      jumps and calls to them are patched by finish(),
+   *      label addresses become relocations against .text
+   *      and calls to, or addresses of, anything that is never defined
+   *      become relocations against that symbol
+   *  jumps are always encoded with a 32-bit displacement
+   * */
+  class X86Encoder {
+    public:
+      std::vector<uint8_t> text;
+      std::vector<Relocation> relocations;
+
+      /**
+       *  label -> offset in .text
+       * */
+      std::unordered_map<std::string, int64_t> labels;
+
+      /**
+       *  labels that become symbols of the object, in definition order
+       * */
+      std::vector<std::string> functions;
+      std::vector<std::string> globals;
+
+      void define_label(const std::string & label);
+
+      void alu(AluOp op, Operand dst, Operand src);
+      void imul(Operand dst, Operand src);
+      void shift(ShiftOp op, Operand dst, Operand count);
+      void lea(int32_t dst, int32_t base, int32_t index, int64_t scale);
+      void lea_disp(int32_t dst, int32_t base, int64_t disp);
+      void test(int32_t dst, int32_t src);
+
+      /**
+       *  xorl, 32-bit so it needs no REX.W, writing the low half clears the upper one
+       * */
+      void xor32(int32_t dst, int32_t src);
+      void setcc(CondCode cc, int32_t reg8);
+      void movzbq(int32_t dst, int32_t src8);
+      void inc(Operand dst);
+      void dec(Operand dst);
+      void push(int32_t reg);
+      void pop(int32_t reg);
+      void ret();
+
+      void jmp(const std::string & label);
+      void jmp_indirect(int32_t reg);
+      void jcc(CondCode cc, const std::string & label);
+      void call(const std::string & label);
+
+      /**
+       *  data in .text: zero bytes up to a multiple of @bytes,
+       *  a 32-bit word, the address of @label as a 32-bit word
+       * */
+      void align(int64_t bytes);
+      void data32(int32_t value);
+      void data32_label(const std::string & label);
+
+      /**
+       *  resolve the jumps/calls to defined labels, turn the rest into relocations
+       *      throws std::runtime_error for a jump to a label that is never defined
+       * */
+      void finish();
+
+    private:
+      /**
+       *  32-bit field at @offset that must hold @label,
+       *      fix_rel/fix_call: relative to the end of the field
+       *      fix_abs: its address, fix_data: its address as data
+       *  only calls and addresses may refer to labels defined outside of .text
+       * */
+      enum FixupKind {fix_rel, fix_call, fix_abs, fix_data};
+      struct Fixup {
+        uint64_t offset;
+        std::string label;
+        FixupKind kind;
+      };
+      std::vector<Fixup> fixups;
+
+      void emit8(uint8_t b);
+      void emit32(int32_t v);
+      void emit64(int64_t v);
+
+      void emit_rex(bool w, int32_t reg, int32_t index, int32_t base, bool force);
+
+      /**
+       *  ModRM (+SIB +displacement) for @rm, @reg goes into the reg field
+       * */
+      void emit_modrm(int32_t reg, Operand & rm);
+
+      /**
+       *  REX + @opcode + ModRM for a 64-bit operation on @rm
+       * */
+      void emit_rm(std::vector<uint8_t> opcode, int32_t reg, Operand & rm);
+
+      void emit_label_imm32(const std::string & label);
+  };
+}
@@ -206,6 +206,74 @@ namespace L2 {
         return  "stack-arg " + offset;
     }
 
+    /**
+     *  names indexed by Register_type
+     * */
+    static const char * const register_names[] = {
+        "rdi", "rax", "rsi", "rdx", "rcx", "r8", "r9", "rbx", "rbp", "r10", "r11", "r12", "r13", "r14", "r15", "rsp"
+    };
+
+    void ItemRegister::print(Output::Sink & out) {
+        if (this->rType < rdi || this->rType > rsp) {
+            std::cerr << "wrong register type in ItemRegister::print\n";
+            return;
+        }
+        out << register_names[this->rType];
+    }
+
+    void ItemConstant::print(Output::Sink & out) {
+        out << this->constVal;
+    }
+
+    void ItemLabel::print(Output::Sink & out) {
+        out << this->labelName;
+    }
+
+    void ItemMemoryAccess::print(Output::Sink & out) {
+        out << "mem ";
+        this->reg->print(out);
+        out << ' ';
+        this->offset->print(out);
+    }
+
+    void ItemAop::print(Output::Sink &) {
+    }
+
+    void ItemCmp::print(Output::Sink & out) {
+        const char * cmp_str;
+        switch (this->cmptype)
+        {
+        case CmpType::eq :
+            cmp_str = "=";
+            break;
+        
+        case CmpType::less :
+            cmp_str = "<";
+            break;
+        
+        case CmpType::leq :
+            cmp_str = "<=";
+            break;
+
+        default:
+            std::cerr << "wrong cmp type in ItemCmp::print\n";
+            return;
+        }
+
+        this->op1->print(out);
+        out << ' ' << cmp_str << ' ';
+        this->op2->print(out);
+    }
+
+    void ItemVariable::print(Output::Sink & out) {
+        out << this->name;
+    }
+
+    void ItemStackArg::print(Output::Sink & out) {
+        out << "stack-arg ";
+        this->offset->print(out);
+    }
+
 
     void ItemRegister::accept(ItemVisitor & visitor){
         visitor.visit(this);
@@ -393,7 +461,7 @@ namespace L2 {
         std::string callee = this->callee->to_string();
         std::string num_args = this->num_args->to_string();
 
-        ret += "call ";
+        ret += this->isTail ? "tail-call " : "call ";
         ret += callee;
         ret += " ";
         ret += num_args;
@@ -641,6 +709,7 @@ namespace L2 {
         call_user->num_args = this->num_args->copy();
         call_user->type = InstType::inst_call;
         call_user->isRuntimeCall = false;
+        call_user->isTail = this->isTail;
 
         return call_user;
     }
@@ -735,6 +804,13 @@ namespace L2 {
         this->varName2ptr = std::unordered_map<std::string, Item *>();
     }
 
+    /**
+     *  a function does not own its instructions,
+     *      the allocator groups instructions of F into scratch functions
+     * */
+    Function::~Function() {
+    }
+
     void Function::print() {
 #ifdef PRINT_FUNC_DEBUG
 
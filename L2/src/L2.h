@@ -4,6 +4,8 @@
 #include <string>
 #include <iostream>
 #include <unordered_map>
+
+#include <output_sink.h>
 // #include "analysis.h"
 
 namespace L2 {
@@ -50,6 +52,11 @@ namespace L2 {
         ItemType itemtype;
 
         virtual std::string to_string() = 0;
+
+        /**
+         *  same text as to_string, appended to @out without building a string
+         * */
+        virtual void print(Output::Sink & out) = 0;
         virtual void accept(ItemVisitor &) = 0;
         virtual Item * copy() = 0;
     };
@@ -60,6 +67,7 @@ namespace L2 {
         ItemRegister(Register_type rType); 
         
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemRegister * copy() override;
     };
@@ -71,6 +79,7 @@ namespace L2 {
         ItemConstant(int64_t constVal);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemConstant * copy() override;
     }; 
@@ -81,6 +90,7 @@ namespace L2 {
         ItemLabel(std::string str);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemLabel * copy() override;
     };
@@ -93,6 +103,7 @@ namespace L2 {
         ItemMemoryAccess(Item * reg, Item * offset);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemMemoryAccess * copy() override;
     };
@@ -101,6 +112,7 @@ namespace L2 {
         AopType aopType;
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemAop * copy() override;
     };
@@ -114,6 +126,7 @@ namespace L2 {
         ItemCmp(Item *op1, Item *op2, CmpType cmpType);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemCmp * copy() override;
     };
@@ -124,6 +137,7 @@ namespace L2 {
         ItemVariable(std::string str);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemVariable * copy() override;
     };
@@ -135,6 +149,7 @@ namespace L2 {
         ItemStackArg(Item *offset);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemStackArg * copy() override;
     };
@@ -281,6 +296,12 @@ namespace L2 {
         Item * callee;
         Item * num_args;
 
+        /**
+         *  the call is the last thing the function does,
+         *      the callee reuses the frame and returns straight to our caller
+         * */
+        bool isTail = false;
+
         std::string to_string() override;
         void accept(InstVisitor & visitor) override;
         Instruction_call_user * copy();
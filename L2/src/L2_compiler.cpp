@@ -19,12 +19,14 @@
 #include <code_generator.h>
 #include <spiller.h>
 #include <register_allocation.h>
+#include <linear_scan.h>
 #include <utils.h>
+#include <thread_pool.h>
 
 using namespace std;
 
 void print_help (char *progName){
-    std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-s] [-l] [-i] SOURCE" << std::endl;
+    std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-j JOBS] [-s] [-l] [-i] SOURCE" << std::endl;
     return ;
 }
 
@@ -36,6 +38,7 @@ int main(
     auto spill_only = false;
     auto interference_only = false;
     auto liveness_only = false;
+    auto verbose = false;
     int32_t optLevel = 3;
 
     // std::cout << "begin!\n";
@@ -48,7 +51,7 @@ int main(
         return 1;
     }
     int32_t opt;
-    while ((opt = getopt(argc, argv, "vg:O:sli")) != -1) {
+    while ((opt = getopt(argc, argv, "vg:O:j:sli")) != -1) {
         switch (opt){
 
             case 'l':
@@ -67,12 +70,17 @@ int main(
                 optLevel = strtoul(optarg, NULL, 0);
                 break ;
 
+            case 'j':
+                ThreadPool::set_jobs(strtoul(optarg, NULL, 0));
+                break ;
+
             case 'g':
                 enable_code_generator = (strtoul(optarg, NULL, 0) == 0) ? false : true ;
                 break ;
 
             case 'v':
                 // Utils::verbose = true;
+                verbose = true;
                 break ;
 
             default:
@@ -147,7 +155,19 @@ int main(
      */
     if (enable_code_generator){
         // TODO
-        L2::run_register_allocation(p);
+        /**
+         *  -O0 trades code quality for compile time
+         * */
+        if (optLevel == 0) {
+            L2::run_linear_scan(p);
+        } else {
+            L2::find_tail_calls(p);
+            L2::save_callee_registers(p);
+            L2::run_register_allocation(p);
+        }
+        if (verbose) {
+            L2::output_allocation_stats(std::cerr);
+        }
         L2::generate_code(p);
         return 0;
     }
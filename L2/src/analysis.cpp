@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 
 #include "analysis.h"
 
@@ -74,39 +75,13 @@ namespace L2
         }
     }
 
-    bool calc_live_OUT2IN(
-        Instruction *inst,
-        LiveSet &GEN,
-        LiveSet &KILL,
-        LiveSet &IN,
-        LiveSet &OUT)
-    {
-        std::set<Item *> tempIN;
-        /**
-             *  p = &x;
-             *  IN[i] = GEN[i] U (OUT[i] – KILL[i])
-             * */
-        std::set<Item *> outMinusKill;
-        set_diff(
-            OUT[inst],   /* srcA */
-            KILL[inst],  /* srcB */
-            outMinusKill /* target */
-        );
-
-        set_union(
-            outMinusKill, /* srcA */
-            GEN[inst],    /* srcB */
-            tempIN        /* target */
-        );
-
-        bool diff = tempIN != IN[inst];
-        IN[inst] = tempIN;
-        return diff;
-    }
-
     FunctionLivenessAnalyzer::FunctionLivenessAnalyzer(Function * F){
         this->F = F;
-        
+        this->solver = NULL;
+    }
+
+    FunctionLivenessAnalyzer::~FunctionLivenessAnalyzer(){
+        delete this->solver;
     }
 
     void FunctionLivenessAnalyzer::calculate_GENKILL() {
@@ -184,77 +159,101 @@ OUT[return] = {}
 
      * */
 
+    void FunctionLivenessAnalyzer::number_items() {
+        this->id2item.clear();
+        this->item2id.clear();
+
+        for (Instruction * inst : this->F->instructions) {
+            for (LiveSet * sets : {&this->live_visitor.GEN, &this->live_visitor.KILL}) {
+                auto it = sets->find(inst);
+                if (it == sets->end()) continue;
+
+                for (Item * item : it->second) {
+                    if (IN_MAP(this->item2id, item)) continue;
+
+                    this->item2id[item] = this->id2item.size();
+                    this->id2item.push_back(item);
+                }
+            }
+        }
+    }
+
+    void FunctionLivenessAnalyzer::to_bit_vector(std::set<Item *> & items, BitVector & bits) {
+        for (Item * item : items) {
+            bits.set(this->item2id[item]);
+        }
+    }
+
+    void FunctionLivenessAnalyzer::to_live_set(BitVector & bits, std::set<Item *> & items) {
+        items.clear();
+        bits.for_each([&](int32_t id) {
+            items.insert(this->id2item[id]);
+        });
+    }
+
     void FunctionLivenessAnalyzer::calculate_INOUT() {
         /**
          *  Find successors for each instruction
          * */
         this->succVisitor.find_successors(this->F);
+        this->number_items();
 
-        bool changed;
+        std::vector<Instruction *> & insts = this->F->instructions;
+        int32_t inst_num = insts.size();
+        int32_t width = this->id2item.size();
 
-        do {
-            changed = false;
-            for (auto inst_it= F->instructions.rbegin(); inst_it != F->instructions.rend(); inst_it++ ){
-                Instruction * inst = *inst_it;
-                
-                // std::cerr <<  "successor size "<< this->succVisitor.successor[inst].size() << '\n';
-                this->OUT[inst].clear();
-                for (Instruction * succ : this->succVisitor.successor[inst]){
-                    this->OUT[inst].insert(
-                        this->IN[succ].begin(),
-                        this->IN[succ].end()
-                    );
-                }
-                
-                // output_INOUT();
-
-                bool in_changed = calc_live_OUT2IN(
-                                    inst,
-                                    this->live_visitor.GEN,
-                                    this->live_visitor.KILL,
-                                    this->IN,
-                                    this->OUT
-                                );
-                
-                if (!changed) changed = in_changed;
+        std::unordered_map<Instruction *, int32_t> inst2idx;
+        for (int32_t i = 0; i < inst_num; i++) {
+            inst2idx[insts[i]] = i;
+        }
 
-                // output_INOUT();
+        this->instGEN = std::vector<BitVector>(inst_num, BitVector(width));
+        this->instKILL = std::vector<BitVector>(inst_num, BitVector(width));
+        std::vector<std::vector<int32_t>> successors(inst_num);
+
+        for (int32_t i = 0; i < inst_num; i++) {
+            this->to_bit_vector(this->live_visitor.GEN[insts[i]], this->instGEN[i]);
+            this->to_bit_vector(this->live_visitor.KILL[insts[i]], this->instKILL[i]);
+
+            for (Instruction * succ : this->succVisitor.successor[insts[i]]) {
+                /**
+                 *  jumping to an undefined label gives a NULL successor
+                 * */
+                if (succ == NULL) continue;
+                successors[i].push_back(inst2idx[succ]);
             }
+        }
 
-            // for (Instruction * inst : F->instructions){
-            //     // Instruction * inst = *inst_it;
-                
-            //     bool in_changed = calc_live_OUT2IN(
-            //                         inst,
-            //                         this->live_visitor.GEN,
-            //                         this->live_visitor.KILL,
-            //                         this->IN,
-            //                         this->OUT
-            //                     );
-
-            //     std::set<Item *> tempOut;            
-            //     /**
-            //      *  Calculate OUT of current instruction from IN of successors
-            //      * */
-            //     for (Instruction * succ : this->succVisitor.successor[inst]){
-            //         this->OUT[inst].insert(
-            //             this->IN[inst].begin(),
-            //             this->IN[inst].end()
-            //         );
-            //     }
-            //     bool out_changed = this->OUT[inst] != tempOut;
+        /**
+         *  solve on basic blocks, per-instruction sets are filled in lazily
+         * */
+        this->cfg.build(successors);
 
-                
-                
-            //     changed = changed || in_changed || out_changed;
+        delete this->solver;
+        this->solver = new BlockLivenessSolver(this->cfg, this->instGEN, this->instKILL, width);
+        this->solver->solve();
 
-            // }
+        this->IN.clear();
+        this->OUT.clear();
+        this->blockInLiveSet = std::vector<bool>(this->cfg.blocks.size(), false);
+    }
 
-        } while(changed);
-        
+    void FunctionLivenessAnalyzer::materialize_block(int32_t block) {
+        if (this->blockInLiveSet[block]) return;
+
+        BasicBlock & bb = this->cfg.blocks[block];
+        for (int32_t i = bb.first; i <= bb.last; i++) {
+            Instruction * inst = this->F->instructions[i];
+            this->to_live_set(this->solver->get_IN(i), this->IN[inst]);
+            this->to_live_set(this->solver->get_OUT(i), this->OUT[inst]);
+        }
+
+        this->blockInLiveSet[block] = true;
     }
 
     void FunctionLivenessAnalyzer::output_INOUT() {
+        this->get_live_IN();
+
         std::cout << '(' << '\n'; 
         std::cout << '(' << "in" << '\n';
         
@@ -305,18 +304,34 @@ OUT[return] = {}
         std::cout << ')' << '\n';
     }
 
+    LiveSet & FunctionLivenessAnalyzer::get_live_GEN()
+    {
+        return this->live_visitor.GEN;
+    }
+
     LiveSet & FunctionLivenessAnalyzer::get_live_KILL()
     {
         return this->live_visitor.KILL;
     }
 
+    ControlFlowGraph & FunctionLivenessAnalyzer::get_cfg()
+    {
+        return this->cfg;
+    }
+
     LiveSet & FunctionLivenessAnalyzer::get_live_IN() 
     {
+        for (int32_t b = 0; b < (int32_t) this->cfg.blocks.size(); b++) {
+            this->materialize_block(b);
+        }
         return this->IN;
     }
 
     LiveSet & FunctionLivenessAnalyzer::get_live_OUT()
     {
+        for (int32_t b = 0; b < (int32_t) this->cfg.blocks.size(); b++) {
+            this->materialize_block(b);
+        }
         return this->OUT;
     }
 
@@ -376,6 +391,16 @@ OUT[return] = {}
             std::begin(L2::caller_saved), 
             std::end(L2::caller_saved)
         );
+
+        /**
+         *  a tail call returns to our caller, like a return
+         * */
+        if (user_call->isTail) {
+            this->GEN[user_call].insert(
+                std::begin(callee_saved), 
+                std::end(callee_saved)
+            );
+        }
         
     }
 
@@ -605,9 +630,12 @@ OUT[return] = {}
     void SuccessorVisitor::visit(Instruction_call_user *user_call)
     {
         /**
-         *  do nothing, handled by general case
-         *      next instruction is just the next instruction in instructin list
+         *  a tail call never comes back, it has no successor
          * */
+        if (user_call->isTail) {
+            this->successor[user_call].clear();
+        }
+
         return;
 
     }
@@ -709,65 +737,89 @@ OUT[return] = {}
     }
 
     InterferenceGraph::InterferenceGraph() {
-        this->nodes = std::set<Item *>();
-        this->edges =  std::map<Item *, std::set<Item *>>();
     }
 
-    InterferenceGraph::InterferenceGraph(
-        std::set<Item *> & nodes,
-        std::map<Item *, std::set<Item *>> & edges
-    ) {
-        this->nodes = nodes;
-        this->edges = edges;
+    void InterferenceGraph::set_nodes(std::set<Item *> & nodes) {
+        this->id2node.assign(nodes.begin(), nodes.end());
+        this->node2id.clear();
+
+        for (int32_t id = 0; id < (int32_t) this->id2node.size(); id++) {
+            this->node2id[this->id2node[id]] = id;
+        }
+
+        int64_t n = this->id2node.size();
+        int64_t bits = n * (n - 1) / 2;
+        this->matrix = std::vector<uint64_t>((bits + 63) / 64, 0);
+        this->adjacency = std::vector<std::vector<int32_t>>(n);
     }
 
-    bool InterferenceGraph::add_edge(Item *v1, Item *v2) {
-        this->nodes.insert(v1);
-        this->nodes.insert(v2);
+    int64_t InterferenceGraph::matrix_index(int32_t id1, int32_t id2) {
+        int64_t hi = MAX(id1, id2);
+        int64_t lo = MIN(id1, id2);
+        return hi * (hi - 1) / 2 + lo;
+    }
+
+    bool InterferenceGraph::add_edge(int32_t id1, int32_t id2) {
+        if (id1 == id2) return false;
 
-        this->edges[v1].insert(v2);
-        this->edges[v2].insert(v1);
+        int64_t idx = this->matrix_index(id1, id2);
+        uint64_t mask = (uint64_t) 1 << (idx % 64);
+        if (this->matrix[idx / 64] & mask) return false;
+
+        this->matrix[idx / 64] |= mask;
+        this->adjacency[id1].push_back(id2);
+        this->adjacency[id2].push_back(id1);
 
         return true;
     }
 
-    bool InterferenceGraph::remove_node(Item * toRemove) {
-        if (!IN_SET(this->nodes, toRemove)) {
-            std::cerr << "cannot find node " << toRemove->to_string() << '\n';
-            return false;
-        }
+    bool InterferenceGraph::add_edge(Item *v1, Item *v2) {
+        return this->add_edge(this->get_id(v1), this->get_id(v2));
+    }
 
-    
-        /** 
-         *  toRemove -- v
-         *  delete (v, toRemove) 
-         * */
-        for (Item * v : this->edges[toRemove]) {
-            this->edges[v].erase(toRemove);
-        }
+    bool InterferenceGraph::interfere(int32_t id1, int32_t id2) {
+        if (id1 == id2) return false;
 
-        /**
-         *  Delete (toRemove, v)
-         * */
-        this->edges.erase(toRemove);
+        int64_t idx = this->matrix_index(id1, id2);
+        return (this->matrix[idx / 64] >> (idx % 64)) & 1;
+    }
 
-        this->nodes.erase(toRemove);
+    bool InterferenceGraph::interfere(Item *v1, Item *v2) {
+        if (!this->has_node(v1) || !this->has_node(v2)) return false;
+        return this->interfere(this->get_id(v1), this->get_id(v2));
+    }
 
-        return true;
+    int32_t InterferenceGraph::size() {
+        return this->id2node.size();
     }
-    
-    void InterferenceGraph::get_nodes_stats(std::map<int32_t, std::set<Item * >> & edgeCnt2nodes) {
-        for (Item * n : this->nodes) {
-            edgeCnt2nodes[this->edges[n].size()].insert(n);
-        }
+
+    bool InterferenceGraph::has_node(Item * node) {
+        return IN_MAP(this->node2id, node);
     }
-    
-    std::set<Item *> & InterferenceGraph::get_neighbors(Item * node) {
-        if (!IN_MAP(this->edges, node)){
 
+    int32_t InterferenceGraph::get_id(Item * node) {
+        auto it = this->node2id.find(node);
+        if (it == this->node2id.end()) {
             std::cerr << "cannot find node " << node->to_string() << '\n';
+            abort();
         }
-        return this->edges[node];
+        return it->second;
+    }
+
+    Item * InterferenceGraph::get_node(int32_t id) {
+        return this->id2node[id];
+    }
+
+    int32_t InterferenceGraph::get_degree(int32_t id) {
+        return this->adjacency[id].size();
+    }
+
+    std::vector<int32_t> & InterferenceGraph::get_neighbors(int32_t id) {
+        return this->adjacency[id];
+    }
+
+    std::vector<int32_t> & InterferenceGraph::get_neighbors(Item * node) {
+        return this->adjacency[this->get_id(node)];
     }
 
 
@@ -781,9 +833,6 @@ OUT[return] = {}
         this->KILL = KILL;
         this->IN = IN;
         this->OUT = OUT;
-
-        nodes = std::set<Item *>();
-        edges = std::map<Item *, std::set<Item *>>();
     }
 
     /**
@@ -793,17 +842,12 @@ OUT[return] = {}
     void FunctionInterferenceAnalyzer::connect_two_sets(std::set<Item *> &varsA, std::set<Item *> &varsB) 
     {
         for (Item * v1: varsA) {
-            this->nodes.insert(v1);
-            this->edges[v1].insert(varsB.begin(), varsB.end());
-            this->edges[v1].erase(v1);
-        }
+            int32_t id1 = this->intGraph.get_id(v1);
 
-        for (Item * v2: varsB) {
-            this->nodes.insert(v2);
-            this->edges[v2].insert(varsA.begin(), varsA.end());
-            this->edges[v2].erase(v2);
+            for (Item * v2: varsB) {
+                this->intGraph.add_edge(id1, this->intGraph.get_id(v2));
+            }
         }
-
     }
 
     /**
@@ -811,23 +855,35 @@ OUT[return] = {}
      * */
     void FunctionInterferenceAnalyzer::full_connect(std::set<Item *> &vars)
     {
+        std::vector<int32_t> ids;
         for (Item *var : vars) {
-            this->nodes.insert(var);
+            ids.push_back(this->intGraph.get_id(var));
         }
 
-        for (Item *a : vars) {
-            for (Item *b : vars) {
-                if (a != b) {
-                    this->edges[a].insert(b);
-                    this->edges[b].insert(a);
+        for (uint32_t a = 0; a < ids.size(); a++) {
+            for (uint32_t b = a + 1; b < ids.size(); b++) {
+                this->intGraph.add_edge(ids[a], ids[b]);
+            }
+        }
+    }
+
+    void FunctionInterferenceAnalyzer::collect_nodes(std::set<Item *> & nodes) {
+        nodes.insert(std::begin(GP_regs), std::end(GP_regs));
+
+        for (Instruction * inst : this->F->instructions) {
+            nodes.insert(this->IN[inst].begin(), this->IN[inst].end());
+            nodes.insert(this->OUT[inst].begin(), this->OUT[inst].end());
+            nodes.insert(this->KILL[inst].begin(), this->KILL[inst].end());
+
+            if (inst->type == InstType::inst_sop) {
+                Instruction_sop * sop = (Instruction_sop *) inst;
+                if (IS_REG_VAR(sop->offset)) {
+                    nodes.insert(sop->offset);
                 }
             }
         }
     }
 
-    /**
-     *  Add connections within GP registers
-     * */
     void FunctionInterferenceAnalyzer::add_GPRegisters_edges() {
         std::set<Item *> GP_reg_set(std::begin(GP_regs), std::end(GP_regs));
 
@@ -879,33 +935,36 @@ OUT[return] = {}
     }
 
     void FunctionInterferenceAnalyzer::build_Inteference_graph() {
+        std::set<Item *> nodes;
+        this->collect_nodes(nodes);
+        this->intGraph.set_nodes(nodes);
+
         this->add_GPRegisters_edges();
         this->add_INOUT_edges();
         this->add_KILLOUT_edges();
         this->add_shift_edges();
     }
 
-    /**
-     *  TODO: Optimize for future performance 
-     * */
-    InterferenceGraph FunctionInterferenceAnalyzer::getIntGraph() {
-        InterferenceGraph intG (
-            this->nodes,
-            this->edges
-        );
-        return intG;
+    InterferenceGraph & FunctionInterferenceAnalyzer::getIntGraph() {
+        return this->intGraph;
     }
 
     void FunctionInterferenceAnalyzer::output_Inteference() {
         // (*it)->accept(this->item_output_visitor);
 
-        for (Item * node : this->nodes) {
+        for (int32_t id = 0; id < this->intGraph.size(); id++) {
 
-            node->accept(this->item_output_visitor);
+            this->intGraph.get_node(id)->accept(this->item_output_visitor);
             std::cout << ' ';
             
-            for (Item * v: this->edges[node]) {
-                std::cout << v->to_string();
+            /**
+             *  ids follow Item * order, sort to print neighbors in that order
+             * */
+            std::vector<int32_t> neighbors = this->intGraph.get_neighbors(id);
+            std::sort(neighbors.begin(), neighbors.end());
+
+            for (int32_t v: neighbors) {
+                std::cout << this->intGraph.get_node(v)->to_string();
                 // v->accept(this->item_output_visitor);
                 
                 std::cout << ' ';
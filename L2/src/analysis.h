@@ -7,9 +7,16 @@
 #include <vector>
 #include "L2.h"
 #include "utils.h"
+#include <bit_vector.h>
+#include <cfg.h>
 
 namespace L2
 {
+    using Dataflow::BitVector;
+    using Dataflow::BasicBlock;
+    using Dataflow::ControlFlowGraph;
+    using Dataflow::BlockLivenessSolver;
+
     void run_liveAnalysis(Program &p);
     void run_Interference(Program &p);
 
@@ -89,8 +96,20 @@ namespace L2
         void output_GENKILL();
 
         FunctionLivenessAnalyzer(Function *F);
+        ~FunctionLivenessAnalyzer();
         
+        LiveSet & get_live_GEN();
         LiveSet & get_live_KILL();
+
+        /**
+         *  basic blocks built by calculate_INOUT
+         * */
+        ControlFlowGraph & get_cfg();
+
+        /**
+         *  IN/OUT of every instruction
+         *      materializes the blocks that have not been queried yet
+         * */
         LiveSet & get_live_IN();
         LiveSet & get_live_OUT();
     private:
@@ -99,36 +118,83 @@ namespace L2
         LiveSet IN;
         LiveSet OUT;
 
+        /**
+         *  dense numbering of the registers and variables of F
+         *      the fixed point runs on BitVectors indexed by these ids
+         *      and IN/OUT are only materialized as LiveSet on request
+         * */
+        std::vector<Item *> id2item;
+        std::unordered_map<Item *, int32_t> item2id;
+
+        void number_items();
+        void to_bit_vector(std::set<Item *> & items, BitVector & bits);
+        void to_live_set(BitVector & bits, std::set<Item *> & items);
+
+        /**
+         *  block-level dataflow state built by calculate_INOUT
+         * */
+        std::vector<BitVector> instGEN;
+        std::vector<BitVector> instKILL;
+        ControlFlowGraph cfg;
+        BlockLivenessSolver * solver;
+
+        /**
+         *  copy the per-instruction sets of @block into IN/OUT
+         * */
+        void materialize_block(int32_t block);
+        std::vector<bool> blockInLiveSet;
+
         LivenessVisitor live_visitor;
         ItemOutputVisitor item_output_visitor;
 
         SuccessorVisitor succVisitor;
     };
     
+    /**
+     *  Interference graph over a fixed set of nodes
+     *      nodes are numbered 0..n-1 in increasing Item * order
+     *      edges are kept twice:
+     *          a lower-triangular bit matrix for O(1) interference queries
+     *          an adjacency vector per node for neighbor iteration
+     * */
     class InterferenceGraph {
         public:
             InterferenceGraph();
-            
-            InterferenceGraph(
-                std::set<Item *> & nodes,
-                std::map<Item *, std::set<Item *>> & edges
-            );
 
-            bool add_edge(Item *v1, Item *v2);
-            bool remove_edge();
-            bool remove_node(Item * toRemove);
+            /**
+             *  number @nodes and allocate the bit matrix
+             *      must be called once before any add_edge
+             * */
+            void set_nodes(std::set<Item *> & nodes);
 
             /**
-             *  populate the stats map
-             *      where @edgeCnt2nodes will be populated as a map from number of edges 
-             *          to a set of nodes that have such number of edges
+             *  return true if the edge was not there before
              * */
-            void get_nodes_stats(std::map<int32_t, std::set<Item * >> & edgeCnt2nodes);
+            bool add_edge(Item *v1, Item *v2);
+            bool add_edge(int32_t id1, int32_t id2);
+
+            bool interfere(int32_t id1, int32_t id2);
+            bool interfere(Item *v1, Item *v2);
+
+            int32_t size();
+            bool has_node(Item * node);
+            int32_t get_id(Item * node);
+            Item * get_node(int32_t id);
+            int32_t get_degree(int32_t id);
 
-            std::set<Item *> & get_neighbors(Item * node);
+            std::vector<int32_t> & get_neighbors(int32_t id);
+            std::vector<int32_t> & get_neighbors(Item * node);
         private:
-            std::set<Item *> nodes;
-            std::map<Item *, std::set<Item *>> edges;
+            std::vector<Item *> id2node;
+            std::unordered_map<Item *, int32_t> node2id;
+
+            /**
+             *  bit (i, j) with i > j lives at i * (i - 1) / 2 + j
+             * */
+            std::vector<uint64_t> matrix;
+            std::vector<std::vector<int32_t>> adjacency;
+
+            int64_t matrix_index(int32_t id1, int32_t id2);
     };
     
 
@@ -144,7 +210,7 @@ namespace L2
         void build_Inteference_graph();
         void output_Inteference();
 
-        InterferenceGraph getIntGraph();
+        InterferenceGraph & getIntGraph();
         
         private:
             
@@ -163,8 +229,12 @@ namespace L2
             /**
              *  Inteference Graph data structure
              * */
-            std::set<Item *> nodes;
-            std::map<Item *, std::set<Item *>> edges;
+            InterferenceGraph intGraph;
+
+            /**
+             *  every register/variable that becomes a node
+             * */
+            void collect_nodes(std::set<Item *> & nodes);
 
             /**
              *  connect everything in varsA with everything in VarsB
@@ -19,41 +19,76 @@ namespace L2 {
         this->out = NULL;
     }
     
-    L2ToL1_GeneratorVisitor::L2ToL1_GeneratorVisitor(std::ofstream *outputFile) {
+    L2ToL1_GeneratorVisitor::L2ToL1_GeneratorVisitor(Output::Sink *outputFile) {
         this->out = outputFile;
     }
 
-    void L2ToL1_GeneratorVisitor::visit(Instruction_ret *ret)  {
-        *this->out << ret->to_string();
+    /**
+     *  Every instruction is printed item by item straight into the sink,
+     *      the text matches Instruction::to_string
+     * */
+    void L2ToL1_GeneratorVisitor::visit(Instruction_ret *)  {
+        *this->out << "return\n";
     }
 
     void L2ToL1_GeneratorVisitor::visit(Instruction_label *label)  {
-        *this->out << label->to_string() ;
-        
+        label->item_label->print(*this->out);
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_call_runtime *runtime_call)  {
-        *this->out << runtime_call->to_string() ;
+        *this->out << "call ";
+        runtime_call->runtime_callee->print(*this->out);
+        *this->out << ' ';
+        runtime_call->num_args->print(*this->out);
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_call_user *user_call)  {
-        *this->out << user_call->to_string() ;
+        *this->out << (user_call->isTail ? "tail-call " : "call ");
+        user_call->callee->print(*this->out);
+        *this->out << ' ';
+        user_call->num_args->print(*this->out);
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_aop *aop)  {
-        *this->out << aop->to_string() ;
+        const char * aop_op;
+        switch (aop->aopType)
+        {
+        case AopType::plus_eq :
+            aop_op = " += ";
+            break;
+        
+        case AopType::minus_eq :
+            aop_op = " -= ";
+            break;
+    
+        case AopType::times_eq :
+            aop_op = " *= ";
+            break;
+
+        case AopType::bitand_eq :
+            aop_op = " &= ";
+            break;
+
+        default:
+            std::cerr << "wrong aop type in L2ToL1_GeneratorVisitor\n";
+            return;
+        } 
+
+        aop->op1->print(*this->out);
+        *this->out << aop_op;
+        aop->op2->print(*this->out);
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_assignment *assignment)  {
 
         assert(this->out != NULL);
 
-        std::string dst_str = assignment->dst->to_string();
-        
-        *this->out << dst_str;
+        assignment->dst->print(*this->out);
         *this->out << " <- ";
-        
-        std::string src_str = "";
 
         if (assignment->src->itemtype == item_stack_arg) {
             ItemStackArg * stack_arg = (ItemStackArg *) assignment->src;
@@ -61,38 +96,71 @@ namespace L2 {
             int32_t offset = this->numlocals * QUADSIZE;
             offset += ((ItemConstant *) stack_arg->offset)->constVal;
 
-            src_str += "mem rsp ";
-            src_str += std::to_string(offset);
+            *this->out << "mem rsp " << offset;
             
         } else {
-            src_str = assignment->src->to_string();
+            assignment->src->print(*this->out);
         }
         
-        *this->out << src_str << '\n';
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_sop *sop)  {
-        *this->out << sop->to_string();
+        const char * dirStr;
+        switch (sop->direction)
+        {
+        case ShiftType::left :
+            dirStr = " <<= ";
+            break;
+        
+        case ShiftType::right :
+            dirStr = " >>= ";
+            break;
+
+        default:
+            std::cerr << "wrong sop type in L2ToL1_GeneratorVisitor\n";
+            return;
+        }
+
+        sop->target->print(*this->out);
+        *this->out << dirStr;
+        sop->offset->print(*this->out);
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_lea *lea)  {
-        *this->out << lea->to_string() ;
+        lea->dst->print(*this->out);
+        *this->out << " @ ";
+        lea->addr->print(*this->out);
+        *this->out << ' ';
+        lea->multr->print(*this->out);
+        *this->out << ' ';
+        lea->const_multr->print(*this->out);
+        *this->out << '\n';
     }
 
     void L2ToL1_GeneratorVisitor::visit(Instruction_goto *inst_goto)  {
-        *this->out << inst_goto->to_string(); 
+        *this->out << "goto ";
+        inst_goto->gotoLabel->print(*this->out);
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_dec *dec)  {
-         *this->out << dec->to_string(); 
+        dec->op->print(*this->out);
+        *this->out << "--\n";
     }
 
     void L2ToL1_GeneratorVisitor::visit(Instruction_inc *inc)  {
-         *this->out << inc->to_string(); 
+        inc->op->print(*this->out);
+        *this->out << "++\n";
     }
     
     void L2ToL1_GeneratorVisitor::visit(Instruction_cjump *cjump)  {
-         *this->out << cjump->to_string(); 
+        *this->out << "cjump ";
+        cjump->condition->print(*this->out);
+        *this->out << ' ';
+        cjump->dst->print(*this->out);
+        *this->out << '\n';
     }
     
     void L2ToL1_GeneratorVisitor::set_numlocals(int32_t numlocals) {
@@ -106,7 +174,7 @@ namespace L2 {
     //     this->instGenerator = L2ToL1_GeneratorVisitor(&this->out);
     // }
 
-    CodeGenerator_L2ToL1::CodeGenerator_L2ToL1(std::ofstream * out, Program * p){
+    CodeGenerator_L2ToL1::CodeGenerator_L2ToL1(Output::Sink * out, Program * p){
         this->out = out;
         this->p = p;
         this->instGenerator = L2ToL1_GeneratorVisitor(this->out);
@@ -137,26 +205,28 @@ namespace L2 {
         *this->out << ")";
         *this->out << "\n";
     }
-    
-    void CodeGenerator_L2ToL1::close() {
-        this->out->close();
-    }
 
     void generate_code(Program & p){
 
         /* 
-        * Open the output file.
+        * Build the whole file in memory, then write it at once.
         */ 
-        std::ofstream outputFile;
-        outputFile.open("prog.L1");
+        Output::Sink outputFile(1 << 20);
+
+        generate_code(p, outputFile);
+
+        if (!outputFile.flush("prog.L1")) {
+            std::cerr << "cannot write prog.L1\n";
+        }
+    }
 
+    void generate_code(Program & p, Output::Sink & out){
         CodeGenerator_L2ToL1 gen(
-            &outputFile,
+            &out,
             &p
         );
 
         gen.generate();
-        gen.close();
          
         /* 
         * Generate target code
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <L2.h>
-#include <fstream>
 #include <string>
 #include <iostream>
 
@@ -9,6 +8,7 @@
 namespace L2{
 
     void generate_code(Program & p);
+    void generate_code(Program & p, Output::Sink & out);
 
     class L2ToL1_GeneratorVisitor : public InstVisitor
     {
@@ -27,11 +27,11 @@ namespace L2{
             void visit(Instruction_cjump *) override;
 
             L2ToL1_GeneratorVisitor();
-            L2ToL1_GeneratorVisitor(std::ofstream * outputFile);
+            L2ToL1_GeneratorVisitor(Output::Sink * outputFile);
 
             void set_numlocals(int32_t numlocals);
         private:
-            std::ofstream *out;
+            Output::Sink *out;
             int32_t numlocals;
 
     };
@@ -39,12 +39,11 @@ namespace L2{
     class CodeGenerator_L2ToL1 {
         public:
             // CodeGenerator_L2ToL1 (std::string outFilename, Program * p);
-            CodeGenerator_L2ToL1(std::ofstream * out, Program * p);
+            CodeGenerator_L2ToL1(Output::Sink * out, Program * p);
 
             void generate();
-            void close();
         private:
-            std::ofstream *out;
+            Output::Sink *out;
             L2ToL1_GeneratorVisitor instGenerator;
             Program * p;
     };
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <thread_pool.h>
+#include "linear_scan.h"
+
+#define IN_MAP(map, key) (map.find(key) != map.end())
+#define IN_SET(set, key) (set.find(key) != set.end())
+
+// #define LSCAN_DEBUG 0
+
+#ifdef LSCAN_DEBUG
+#define DEBUG_OUT (std::cerr << "DEBUG-Linear-Scan: ") // or any other ostream
+#else
+#define DEBUG_OUT 0 && std::cerr
+#endif
+
+namespace L2 {
+
+    LinearScanAllocator::LinearScanAllocator(Function * F, Function ** F_addr) {
+        this->F = F;
+        this->F_addr = F_addr;
+    }
+
+    void LinearScanAllocator::build_intervals() {
+        FunctionLivenessAnalyzer live_analyzer(this->F);
+        live_analyzer.calculate_GENKILL();
+        live_analyzer.calculate_INOUT();
+
+        LiveSet & IN = live_analyzer.get_live_IN();
+        LiveSet & OUT = live_analyzer.get_live_OUT();
+        LiveSet & KILL = live_analyzer.get_live_KILL();
+
+        std::unordered_map<Item *, int32_t> var2interval;
+        this->intervals.clear();
+        this->fixed.clear();
+        this->rcx_only.clear();
+
+        for (int32_t i = 0; i < (int32_t) this->F->instructions.size(); i++) {
+            Instruction * inst = this->F->instructions[i];
+
+            if (inst->type == InstType::inst_sop) {
+                Instruction_sop * sop = (Instruction_sop *) inst;
+                if (sop->offset->itemtype == ItemType::item_variable) {
+                    this->rcx_only.insert(sop->offset);
+                }
+            }
+
+            for (LiveSet * sets : {&IN, &OUT, &KILL}) {
+                auto it = sets->find(inst);
+                if (it == sets->end()) continue;
+
+                for (Item * item : it->second) {
+                    if (item->itemtype == ItemType::item_registers) {
+                        std::vector<int32_t> & points = this->fixed[item];
+                        if (points.empty() || points.back() != i) points.push_back(i);
+                        continue;
+                    }
+
+                    if (!IN_MAP(var2interval, item)) {
+                        var2interval[item] = this->intervals.size();
+                        this->intervals.push_back({item, i, i});
+                    }
+                    this->intervals[var2interval[item]].end = i;
+                }
+            }
+        }
+
+        /**
+         *  by increasing start point, names break ties so the output does not depend on addresses
+         * */
+        std::sort(this->intervals.begin(), this->intervals.end(), [](const LiveInterval & a, const LiveInterval & b) {
+            if (a.start != b.start) return a.start < b.start;
+            if (a.end != b.end) return a.end < b.end;
+            return a.var->to_string() < b.var->to_string();
+        });
+    }
+
+    bool LinearScanAllocator::register_free(Item * reg, LiveInterval & interval) {
+        auto it = this->fixed.find(reg);
+        if (it == this->fixed.end()) return true;
+
+        std::vector<int32_t> & points = it->second;
+        auto next = std::lower_bound(points.begin(), points.end(), interval.start);
+
+        return next == points.end() || *next > interval.end;
+    }
+
+    bool LinearScanAllocator::register_usable(Color c, LiveInterval & interval) {
+        if (IN_SET(this->rcx_only, interval.var) && c != rcx_color) return false;
+
+        return this->register_free(color2reg[c], interval);
+    }
+
+    void LinearScanAllocator::scan(
+        std::unordered_map<Item *, Color> & item2color,
+        std::vector<Item *> & spilled,
+        std::set<Item *> & noSpill
+    ) {
+        /**
+         *  intervals holding a register, by increasing end point
+         * */
+        std::vector<LiveInterval *> active;
+        bool taken[L2::COLOR_NUM] = {false};
+
+        for (LiveInterval & current : this->intervals) {
+            /**
+             *  expire the intervals that ended before current starts
+             * */
+            while (!active.empty() && active.front()->end < current.start) {
+                taken[item2color[active.front()->var]] = false;
+                active.erase(active.begin());
+            }
+
+            bool found = false;
+            for (Color c : this->sorted_color) {
+                if (!taken[c] && this->register_usable(c, current)) {
+                    item2color[current.var] = c;
+                    taken[c] = true;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found) {
+                /**
+                 *  take the register of the active interval ending last
+                 *      if current could use it and ends earlier
+                 * */
+                LiveInterval * victim = NULL;
+                for (LiveInterval * other : active) {
+                    if (IN_SET(noSpill, other->var)) continue;
+                    if (!this->register_usable(item2color[other->var], current)) continue;
+
+                    if (victim == NULL || other->end > victim->end) victim = other;
+                }
+
+                bool current_first = victim == NULL
+                                  || (victim->end <= current.end && !IN_SET(noSpill, current.var));
+                if (current_first) {
+                    spilled.push_back(current.var);
+                    continue;
+                }
+
+                item2color[current.var] = item2color[victim->var];
+                item2color.erase(victim->var);
+                spilled.push_back(victim->var);
+                active.erase(std::find(active.begin(), active.end(), victim));
+            }
+
+            active.insert(
+                std::upper_bound(active.begin(), active.end(), &current, [](LiveInterval * a, LiveInterval * b) {
+                    return a->end < b->end;
+                }),
+                &current
+            );
+        }
+    }
+
+    void LinearScanAllocator::allocate() {
+        std::string SpillPrefixPre = "%LSCAN_SPILL_VAR_SYMBOL_";
+        std::set<Item *> noSpill;
+
+        allocation_stats.functions++;
+
+        for (int32_t round = 0; ; round++) {
+            std::unordered_map<Item *, Color> item2color;
+            std::vector<Item *> spilled;
+
+            allocation_stats.rounds++;
+            this->build_intervals();
+            this->scan(item2color, spilled, noSpill);
+
+            DEBUG_OUT << this->F->name << " round " << round << ": " << this->intervals.size()
+                      << " intervals, " << spilled.size() << " spilled\n";
+
+            if (spilled.empty()) {
+                VarColorVisitor var_color_visitor(item2color, this->F);
+                for (Instruction * inst : this->F->instructions) {
+                    inst->accept(var_color_visitor);
+                }
+
+                remove_redundant_moves(this->F);
+                return;
+            }
+
+            /**
+             *  spill temporaries are a few instructions long,
+             *      if even they cannot get a register fall back to graph coloring
+             * */
+            for (Item * var : spilled) {
+                if (IN_SET(noSpill, var)) {
+                    DEBUG_OUT << "cannot allocate " << var->to_string() << ", falling back to graph coloring\n";
+
+                    RegisterAllocator reg_alloc(this->F, this->F_addr);
+                    reg_alloc.allcoate();
+                    return;
+                }
+            }
+
+            allocation_stats.spilled += spilled.size();
+
+            BatchSpiller sp(this->F);
+            for (uint32_t j = 0; j < spilled.size(); j++) {
+                /**
+                 * "%LSCAN_SPILL_VAR_SYMBOL_%d_%d", iteration, index of varsToSpill
+                 * */
+                std::string prefix_str =    SpillPrefixPre
+                                        +   std::to_string(round) + "_"
+                                        +   std::to_string(j) + "_";
+
+                sp.add_var((ItemVariable *) spilled[j], new ItemVariable(prefix_str), spill_per_use);
+            }
+
+            sp.spill_variables();
+            allocation_stats.rematerialized += sp.get_rematerialized();
+
+            std::vector<ItemVariable *> var_replacements = sp.get_var_replacement();
+            noSpill.insert(var_replacements.begin(), var_replacements.end());
+        }
+    }
+
+    void run_linear_scan(Program &p) {
+        ThreadPool::parallel_for(p.functions.size(), [&p](int32_t i) {
+            LinearScanAllocator allocator(p.functions[i], &p.functions[i]);
+
+            DEBUG_OUT << "Begin allocation for " << p.functions[i]->name << '\n';
+            allocator.allocate();
+        });
+    }
+}
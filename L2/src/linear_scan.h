@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include "register_allocation.h"
+
+namespace L2 {
+    void run_linear_scan(Program &p);
+
+    /**
+     *  [start, end]: first and last instruction index where @var is live or defined
+     * */
+    struct LiveInterval {
+        Item * var;
+        int32_t start;
+        int32_t end;
+    };
+
+    /**
+     *  Linear-scan register allocation (Poletto & Sarkar)
+     *      every variable gets a single interval over the instruction order,
+     *      a register can hold it if no other active interval holds that register
+     *      and the register is neither live nor written anywhere inside the interval
+     *      when registers run out the interval ending last is spilled
+     * */
+    class LinearScanAllocator {
+        public:
+            LinearScanAllocator(Function * F, Function ** F_addr);
+
+            void allocate();
+
+        private:
+            Function * F;
+            Function ** F_addr;
+
+            std::vector<LiveInterval> intervals;
+
+            /**
+             *  register -> sorted instruction indices where it is live or written
+             * */
+            std::unordered_map<Item *, std::vector<int32_t>> fixed;
+
+            /**
+             *  variables used as a shift offset, they can only live in rcx
+             * */
+            std::set<Item *> rcx_only;
+
+            void build_intervals();
+            bool register_free(Item * reg, LiveInterval & interval);
+            bool register_usable(Color c, LiveInterval & interval);
+
+            /**
+             *  assign a color to every interval it can
+             *      @spilled gets the variables left without one
+             *      variables in @noSpill are only given up if nothing else can be
+             * */
+            void scan(
+                std::unordered_map<Item *, Color> & item2color,
+                std::vector<Item *> & spilled,
+                std::set<Item *> & noSpill
+            );
+
+            /**
+             *  same order as ColorSelector: caller saved registers first
+             * */
+            Color sorted_color[L2::COLOR_NUM] = {
+                r10_color,
+                r11_color,
+                r8_color,
+                r9_color,
+                rax_color,
+                rcx_color,
+                rdi_color,
+                rdx_color,
+                rsi_color,
+
+                rbx_color,
+                rbp_color,
+                r12_color,
+                r13_color,
+                r14_color,
+                r15_color
+            };
+    };
+}
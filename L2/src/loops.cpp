@@ -0,0 +1,149 @@
+#include <set>
+#include "loops.h"
+
+namespace L2 {
+
+    LoopAnalyzer::LoopAnalyzer(ControlFlowGraph * cfg) {
+        this->cfg = cfg;
+    }
+
+    void LoopAnalyzer::analyze() {
+        this->compute_dominators();
+        this->find_loops();
+    }
+
+    int32_t LoopAnalyzer::intersect(int32_t a, int32_t b) {
+        while (a != b) {
+            while (this->rpo_rank[a] > this->rpo_rank[b]) a = this->idom[a];
+            while (this->rpo_rank[b] > this->rpo_rank[a]) b = this->idom[b];
+        }
+        return a;
+    }
+
+    void LoopAnalyzer::compute_dominators() {
+        int32_t block_num = this->cfg->blocks.size();
+
+        this->idom = std::vector<int32_t>(block_num, -1);
+        this->rpo_rank = std::vector<int32_t>(block_num, -1);
+        if (block_num == 0) return;
+
+        /**
+         *  reverse postorder of the blocks reachable from the entry
+         * */
+        std::vector<int32_t> rpo;
+        std::vector<bool> visited(block_num, false);
+        std::vector<std::pair<int32_t, int32_t>> stack = {{0, 0}};
+        visited[0] = true;
+
+        while (!stack.empty()) {
+            int32_t b = stack.back().first;
+            int32_t & next = stack.back().second;
+
+            if (next < (int32_t) this->cfg->blocks[b].succs.size()) {
+                int32_t succ = this->cfg->blocks[b].succs[next++];
+                if (!visited[succ]) {
+                    visited[succ] = true;
+                    stack.push_back({succ, 0});
+                }
+            } else {
+                rpo.push_back(b);
+                stack.pop_back();
+            }
+        }
+        std::vector<int32_t>(rpo.rbegin(), rpo.rend()).swap(rpo);
+
+        for (int32_t r = 0; r < (int32_t) rpo.size(); r++) {
+            this->rpo_rank[rpo[r]] = r;
+        }
+
+        /**
+         *  the entry temporarily dominates itself to seed intersect()
+         * */
+        this->idom[0] = 0;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+
+            for (int32_t r = 1; r < (int32_t) rpo.size(); r++) {
+                int32_t b = rpo[r];
+                int32_t new_idom = -1;
+
+                for (int32_t pred : this->cfg->blocks[b].preds) {
+                    if (this->idom[pred] < 0) continue;
+
+                    new_idom = (new_idom < 0) ? pred : this->intersect(pred, new_idom);
+                }
+
+                if (new_idom != this->idom[b]) {
+                    this->idom[b] = new_idom;
+                    changed = true;
+                }
+            }
+        }
+
+        this->idom[0] = -1;
+    }
+
+    bool LoopAnalyzer::dominates(int32_t a, int32_t b) {
+        if (this->rpo_rank[a] < 0 || this->rpo_rank[b] < 0) return false;
+
+        while (b >= 0 && b != a) {
+            b = this->idom[b];
+        }
+        return b == a;
+    }
+
+    void LoopAnalyzer::find_loops() {
+        int32_t block_num = this->cfg->blocks.size();
+        this->depth = std::vector<int32_t>(block_num, 0);
+
+        /**
+         *  header -> body, loops sharing a header are merged into one
+         * */
+        std::vector<std::set<int32_t>> bodies(block_num);
+
+        for (int32_t b = 0; b < block_num; b++) {
+            for (int32_t h : this->cfg->blocks[b].succs) {
+                if (!this->dominates(h, b)) continue;
+
+                /**
+                 *  back edge b -> h: walk predecessors from b until h
+                 * */
+                std::set<int32_t> & body = bodies[h];
+                body.insert(h);
+
+                std::vector<int32_t> work;
+                if (body.insert(b).second) work.push_back(b);
+
+                while (!work.empty()) {
+                    int32_t n = work.back();
+                    work.pop_back();
+
+                    for (int32_t pred : this->cfg->blocks[n].preds) {
+                        if (this->rpo_rank[pred] < 0) continue;
+                        if (body.insert(pred).second) work.push_back(pred);
+                    }
+                }
+            }
+        }
+
+        for (std::set<int32_t> & body : bodies) {
+            for (int32_t b : body) {
+                this->depth[b]++;
+            }
+        }
+    }
+
+    int32_t LoopAnalyzer::get_idom(int32_t block) {
+        return this->idom[block];
+    }
+
+    int32_t LoopAnalyzer::get_block_depth(int32_t block) {
+        return this->depth[block];
+    }
+
+    int32_t LoopAnalyzer::get_inst_depth(int32_t inst) {
+        return this->depth[this->cfg->inst2block[inst]];
+    }
+}
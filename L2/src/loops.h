@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <cfg.h>
+
+namespace L2 {
+
+    using Dataflow::ControlFlowGraph;
+
+    /**
+     *  Dominator tree and natural loops of a ControlFlowGraph
+     *      dominators follow Cooper, Harvey and Kennedy's iterative algorithm,
+     *      every back edge (b -> h where h dominates b) forms a natural loop
+     *      and the loop depth of a block is the number of loops it sits in
+     * */
+    class LoopAnalyzer {
+        public:
+            LoopAnalyzer(ControlFlowGraph * cfg);
+
+            void analyze();
+
+            /**
+             *  immediate dominator of @block
+             *      -1 for the entry block and blocks unreachable from it
+             * */
+            int32_t get_idom(int32_t block);
+            bool dominates(int32_t a, int32_t b);
+
+            int32_t get_block_depth(int32_t block);
+            int32_t get_inst_depth(int32_t inst);
+
+        private:
+            ControlFlowGraph * cfg;
+
+            std::vector<int32_t> idom;
+            std::vector<int32_t> depth;
+
+            /**
+             *  rank of every block in reverse postorder from the entry
+             *      -1 if unreachable
+             * */
+            std::vector<int32_t> rpo_rank;
+
+            void compute_dominators();
+            void find_loops();
+            int32_t intersect(int32_t a, int32_t b);
+    };
+}
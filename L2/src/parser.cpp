@@ -1745,6 +1745,23 @@ namespace L2 {
     return p;
     }
 
+    Program parse_input (const std::string & source, const std::string & sourceName){
+
+    /* 
+     * Check the grammar for some possible issues.
+     */
+    pegtl::analyze< grammar >();
+
+    /*
+     * Parse the in-memory text handed over by the previous stage.
+     */   
+    memory_input< > memoryInput(source, sourceName);
+    Program p;
+    parse< grammar, action >(memoryInput, p);
+
+    return p;
+    }
+
     Program parse_function_file (char *fileName){
         // std::cerr << "parse function file" << fileName << '\n';
         /* 
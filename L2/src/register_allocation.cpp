@@ -1,8 +1,16 @@
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <thread_pool.h>
 #include "register_allocation.h"
 
 #define IN_MAP(map, key) (map.find(key) != map.end())
 #define IN_SET(set, key) (set.find(key) != set.end())
+#define IS_REG_VAR(item) (item->itemtype == ItemType::item_registers || item->itemtype == ItemType::item_variable)
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 // #define REG_DEBUG 0
 
@@ -46,9 +54,26 @@ namespace L2 {
         {r14_color, &reg_r14},
         {r15_color, &reg_r15},
         {rbp_color, &reg_rbp},
-        {rbx_color, &reg_rbp}
+        {rbx_color, &reg_rbx}
     };
 
+    AllocationStats allocation_stats = {};
+
+    void output_allocation_stats(std::ostream & out) {
+        out << "register allocation:"
+            << " functions " << allocation_stats.functions
+            << " rounds " << allocation_stats.rounds
+            << " moves " << allocation_stats.moves
+            << " coalesced " << allocation_stats.coalesced
+            << " constrained " << allocation_stats.constrained
+            << " frozen " << allocation_stats.frozen
+            << " removed-copies " << allocation_stats.removed_copies
+            << " spilled " << allocation_stats.spilled
+            << " split " << allocation_stats.split
+            << " rematerialized " << allocation_stats.rematerialized
+            << '\n';
+    }
+
 
     VarColorVisitor::VarColorVisitor(
         std::unordered_map<Item *, Color> & item2color,
@@ -398,10 +423,38 @@ namespace L2 {
 
     // }
     
-    bool RegisterAllocator::analysisAndColoring(
+    void RegisterAllocator::compute_spill_costs(
         Function * F,
-        std::set<Item *> & NonColorItems
-    ){
+        FunctionLivenessAnalyzer & live_analyzer,
+        SpillCosts & spillCosts
+    ) {
+        LoopAnalyzer loop_analyzer(&live_analyzer.get_cfg());
+        loop_analyzer.analyze();
+
+        LiveSet & GEN = live_analyzer.get_live_GEN();
+        LiveSet & KILL = live_analyzer.get_live_KILL();
+
+        spillCosts.clear();
+        this->instWeight.clear();
+        for (int32_t i = 0; i < (int32_t) F->instructions.size(); i++) {
+            Instruction * inst = F->instructions[i];
+            double weight = std::pow(10.0, loop_analyzer.get_inst_depth(i));
+            this->instWeight[inst] = weight;
+
+            for (LiveSet * sets : {&GEN, &KILL}) {
+                auto it = sets->find(inst);
+                if (it == sets->end()) continue;
+
+                for (Item * item : it->second) {
+                    if (item->itemtype == ItemType::item_variable) {
+                        spillCosts[item] += weight;
+                    }
+                }
+            }
+        }
+    }
+
+    void RegisterAllocator::analysis(Function * F) {
         /**
          *  run liveness analysis
          * */
@@ -412,6 +465,7 @@ namespace L2 {
         DEBUG_OUT << "Done: " << "liveness analysis!" << '\n';
         // live_analyzer.output_INOUT();
 
+        this->compute_spill_costs(F, live_analyzer, this->spillCosts);
 
 
         /**
@@ -433,10 +487,23 @@ namespace L2 {
         // int_analyzer.output_Inteference();
         DEBUG_OUT << "Done: " << "Interference Graph!" << '\n';
 
+        this->intGraph = int_analyzer.getIntGraph();
+        this->liveOUT = live_analyzer.get_live_OUT();
+        this->replacedBy.clear();
+        this->spilledVars.clear();
+    }
 
-        InterferenceGraph intGraph = int_analyzer.getIntGraph();
+    bool RegisterAllocator::coloring(
+        Function * F,
+        std::set<Item *> & NonColorItems,
+        std::set<Item *> & noSpill,
+        std::unordered_map<Item *, Color> & item2color
+    ){
+        /**
+         *  coalescing adds edges, keep intGraph as the plain interference
+         * */
+        InterferenceGraph workGraph = this->intGraph;
         std::stack<Item *>  nodeStack;
-        std::unordered_map<Item *, Color> item2color;
         
 
 
@@ -444,8 +511,11 @@ namespace L2 {
          *  color_num default to be 15, number of L2 GP register
          * */
         NodeSelector node_selector(
-            intGraph,
-            L2::COLOR_NUM
+            &workGraph,
+            F,
+            L2::COLOR_NUM,
+            &this->spillCosts,
+            &noSpill
         );
 
         /**
@@ -453,11 +523,15 @@ namespace L2 {
          * */
         node_selector.populate_stack(nodeStack);
 
+        std::unordered_map<Item *, Item *> coalesced;
+        node_selector.get_coalesced(coalesced);
+
         DEBUG_OUT << "Done: " << "Node selection!" << '\n';
 
         ColorSelector color_selector(
-            &intGraph,
-            &nodeStack
+            &workGraph,
+            &nodeStack,
+            &coalesced
         );
 
         bool AllAssigned = color_selector.assignColorForAll(
@@ -471,9 +545,141 @@ namespace L2 {
         this->color_variables(F, item2color);
         DEBUG_OUT << "Done: " << "Color variables!" << '\n';
 
+        remove_redundant_moves(F);
+
         return AllAssigned;
     }
 
+    bool RegisterAllocator::analysisAndColoring(
+        Function * F,
+        std::set<Item *> & NonColorItems,
+        std::set<Item *> & noSpill
+    ){
+        std::unordered_map<Item *, Color> item2color;
+
+        this->analysis(F);
+        return this->coloring(F, NonColorItems, noSpill, item2color);
+    }
+
+    Item * RegisterAllocator::get_replacement(Item * item) {
+        auto it = this->replacedBy.find(item);
+        return (it == this->replacedBy.end()) ? item : it->second;
+    }
+
+    void RegisterAllocator::update_after_spill(
+        std::unordered_map<Item *, Color> & item2color,
+        std::vector<Item *> & varsToSpill,
+        std::vector<SpillSite> & sites,
+        std::set<Item *> & splitReplacements
+    ) {
+        for (auto & kv : item2color) {
+            if (kv.first->itemtype == ItemType::item_variable) {
+                this->replacedBy[kv.first] = color2reg[kv.second];
+            }
+        }
+        this->spilledVars.insert(varsToSpill.begin(), varsToSpill.end());
+
+        /**
+         *  straight-line liveness over every spilled segment
+         *      what is live at the end of the segment is what was live behind
+         *      its anchor, spill temporaries never outlive their segment
+         * */
+        Function siteF;
+        LivenessVisitor live_visitor;
+        LiveSet IN;
+        LiveSet OUT;
+
+        for (SpillSite & site : sites) {
+            std::vector<Instruction *> & insts = site.insts;
+
+            std::set<Item *> live;
+            for (Item * item : this->liveOUT[site.anchor]) {
+                if (IN_SET(this->spilledVars, item)) continue;
+                live.insert(this->get_replacement(item));
+            }
+
+            /**
+             *  a segment sits in a single basic block, so it has a single loop depth
+             * */
+            double weight = this->instWeight[site.anchor];
+
+            for (int32_t k = insts.size() - 1; k >= 0; k--) {
+                Instruction * inst = insts[k];
+                inst->accept(live_visitor);
+
+                OUT[inst] = live;
+                for (Item * item : live_visitor.KILL[inst]) {
+                    live.erase(item);
+                }
+                live.insert(live_visitor.GEN[inst].begin(), live_visitor.GEN[inst].end());
+                IN[inst] = live;
+
+                this->liveOUT[inst] = OUT[inst];
+                this->instWeight[inst] = weight;
+
+                for (LiveSet * sets : {&live_visitor.GEN, &live_visitor.KILL}) {
+                    for (Item * item : (*sets)[inst]) {
+                        if (IN_SET(splitReplacements, item)) {
+                            this->spillCosts[item] += weight;
+                        }
+                    }
+                }
+            }
+
+            siteF.instructions.insert(siteF.instructions.end(), insts.begin(), insts.end());
+        }
+
+        FunctionInterferenceAnalyzer site_analyzer(
+            &siteF,
+            live_visitor.KILL,
+            IN,
+            OUT
+        );
+        site_analyzer.build_Inteference_graph();
+        InterferenceGraph & siteGraph = site_analyzer.getIntGraph();
+
+        /**
+         *  nodes of the next round: every surviving node under its replacement
+         *      plus whatever the spill sites introduced
+         * */
+        InterferenceGraph & oldGraph = this->intGraph;
+        std::set<Item *> nodes;
+        for (int32_t n = 0; n < oldGraph.size(); n++) {
+            Item * item = oldGraph.get_node(n);
+            if (IN_SET(this->spilledVars, item)) continue;
+            nodes.insert(this->get_replacement(item));
+        }
+        for (int32_t n = 0; n < siteGraph.size(); n++) {
+            nodes.insert(siteGraph.get_node(n));
+        }
+
+        InterferenceGraph newGraph;
+        newGraph.set_nodes(nodes);
+
+        for (int32_t a = 0; a < oldGraph.size(); a++) {
+            Item * itemA = oldGraph.get_node(a);
+            if (IN_SET(this->spilledVars, itemA)) continue;
+
+            for (int32_t b : oldGraph.get_neighbors(a)) {
+                Item * itemB = oldGraph.get_node(b);
+                if (b < a || IN_SET(this->spilledVars, itemB)) continue;
+
+                Item * u = this->get_replacement(itemA);
+                Item * v = this->get_replacement(itemB);
+                if (u != v) newGraph.add_edge(u, v);
+            }
+        }
+
+        for (int32_t a = 0; a < siteGraph.size(); a++) {
+            for (int32_t b : siteGraph.get_neighbors(a)) {
+                if (b < a) continue;
+                newGraph.add_edge(siteGraph.get_node(a), siteGraph.get_node(b));
+            }
+        }
+
+        this->intGraph = newGraph;
+    }
+
     void RegisterAllocator::allcoate() {
         
         Function * F_copy = this->F->copy();
@@ -487,21 +693,45 @@ namespace L2 {
         bool AllAssigned = false;
         
         std::set<Item *> prevSpillReplace;
+
+        /**
+         *  variables made by splitting live ranges,
+         *      spilled again they fall back to a load/store per use
+         * */
+        std::set<Item *> splitTemps;
+
+        allocation_stats.functions++;
+        for (Instruction * inst : this->F->instructions) {
+            if (inst->type != InstType::inst_assign) continue;
+
+            Instruction_assignment * assign = (Instruction_assignment *) inst;
+            if (IS_REG_VAR(assign->dst) && IS_REG_VAR(assign->src)) {
+                allocation_stats.moves++;
+            }
+        }
+
+        this->analysis(this->F);
+
         do {
 
 
             std::set<Item *> NonColorItems;
             std::vector<Item *> varsToSpill;
+            std::unordered_map<Item *, Color> item2color;
 
-            AllAssigned = this->analysisAndColoring(
+            allocation_stats.rounds++;
+            AllAssigned = this->coloring(
                 this->F,
-                NonColorItems
+                NonColorItems,
+                prevSpillReplace,
+                item2color
             );
 
 
-            SpillVarSelector spill_selector(&NonColorItems, &prevSpillReplace);
+            SpillVarSelector spill_selector(&NonColorItems, &prevSpillReplace, &this->spillCosts);
             // spill_selector.
             spill_selector.selectVarsToSpill(varsToSpill);
+            allocation_stats.spilled += varsToSpill.size();
 
             if (!NonColorItems.empty() && varsToSpill.empty()) {
                 /***
@@ -519,6 +749,15 @@ namespace L2 {
                 break;
             }
 
+            if (AllAssigned) {
+                break;
+            }
+
+            /**
+             *  rewrite every chosen variable in one walk over F
+             * */
+            BatchSpiller sp(this->F);
+
             for (uint32_t j = 0 ; j < varsToSpill.size(); j++) {
 
                 /**
@@ -532,24 +771,31 @@ namespace L2 {
                     prefix_str
                 );
                 
-                Spiller sp (
-                    this->F,
-                    (ItemVariable *) varsToSpill[j],
-                    prefix
-                );
+                SpillMode mode = IN_SET(splitTemps, varsToSpill[j]) ? spill_per_use : spill_segment;
+                sp.add_var((ItemVariable *) varsToSpill[j], prefix, mode);
+            }
 
-                sp.spill_variables();
+            sp.spill_variables();
+            allocation_stats.rematerialized += sp.get_rematerialized();
                 
-                std::vector<ItemVariable *> var_replacements = sp.get_var_replacement();
+            std::vector<ItemVariable *> var_replacements = sp.get_var_replacement();
+            std::vector<ItemVariable *> split_replacements = sp.get_split_replacement();
+            std::set<Item *> newSplitTemps(split_replacements.begin(), split_replacements.end());
+            allocation_stats.split += newSplitTemps.size();
 
-                /**
-                 * append variables created by spilling to the prevSpillReplace
-                 * */
-                prevSpillReplace.insert(
-                    var_replacements.begin(),
-                    var_replacements.end()
-                );
+            /**
+             * append variables created by spilling to the prevSpillReplace
+             *      split variables can still be spilled
+             * */
+            for (ItemVariable * var : var_replacements) {
+                if (IN_SET(newSplitTemps, var)) {
+                    splitTemps.insert(var);
+                } else {
+                    prevSpillReplace.insert(var);
+                }
             }
+
+            this->update_after_spill(item2color, varsToSpill, sp.get_sites(), newSplitTemps);
             
             i++;
 
@@ -597,9 +843,11 @@ namespace L2 {
             std::set<Item *> NonColorItems;
             std::vector<Item *> varsToSpill;
 
+            std::set<Item *> noSpill;
             this->analysisAndColoring(
                 F_copy,
-                NonColorItems
+                NonColorItems,
+                noSpill
             );
             // F_copy->print();
 
@@ -611,6 +859,25 @@ namespace L2 {
     }
 
 
+    void remove_redundant_moves(Function * F) {
+        std::vector<Instruction *> kept;
+
+        for (Instruction * inst : F->instructions) {
+            if (inst->type == InstType::inst_assign) {
+                Instruction_assignment * assign = (Instruction_assignment *) inst;
+
+                if (assign->dst == assign->src && assign->dst->itemtype == ItemType::item_registers) {
+                    allocation_stats.removed_copies++;
+                    continue;
+                }
+            }
+
+            kept.push_back(inst);
+        }
+
+        F->instructions = kept;
+    }
+
     void RegisterAllocator::color_variables(
         Function * F,
         std::unordered_map<Item *, Color> & item2color
@@ -645,76 +912,393 @@ namespace L2 {
 
 
     NodeSelector::NodeSelector(
-                InterferenceGraph & intGraph, 
-                int32_t color_num
+                InterferenceGraph * intGraph, 
+                Function * F,
+                int32_t color_num,
+                SpillCosts * spillCosts,
+                std::set<Item *> * noSpill
     ) {
         this->intGraph = intGraph;
+        this->F = F;
         this->color_num = color_num;
+        this->spillCosts = spillCosts;
+        this->noSpill = noSpill;
+
+        this->build();
+        this->make_worklist();
     }
 
-    void NodeSelector::populate_stack(std::stack<Item *> & nodeStack) {
-        while (Item * it = this->select_next_node())
-        {   
-            if(it->itemtype == ItemType::item_variable) {
-                DEBUG_OUT << "push on stack " << it->to_string() << '\n';
-                nodeStack.push(it);
+    bool NodeSelector::is_precolored(int32_t n) {
+        return this->state[n] == node_precolored;
+    }
+
+    void NodeSelector::build() {
+        int32_t node_num = this->intGraph->size();
+
+        this->state = std::vector<NodeState>(node_num, node_simplify);
+        this->alias = std::vector<int32_t>(node_num);
+        this->degree = std::vector<int32_t>(node_num);
+        this->moveList = std::vector<std::vector<int32_t>>(node_num);
+
+        for (int32_t id = 0; id < node_num; id++) {
+            this->alias[id] = id;
+
+            if (this->intGraph->get_node(id)->itemtype == ItemType::item_registers) {
+                /**
+                 *  registers never leave the graph, their degree is never looked at
+                 * */
+                this->state[id] = node_precolored;
             }
-            
+            this->degree[id] = this->intGraph->get_degree(id);
+        }
+
+        /**
+         *  every reg/var <- reg/var is a move, registers included
+         * */
+        for (Instruction * inst : this->F->instructions) {
+            if (inst->type != InstType::inst_assign) continue;
+
+            Instruction_assignment * assign = (Instruction_assignment *) inst;
+            if (!this->intGraph->has_node(assign->dst) || !this->intGraph->has_node(assign->src)) continue;
+
+            Move m;
+            m.dst = this->intGraph->get_id(assign->dst);
+            m.src = this->intGraph->get_id(assign->src);
+            m.inst = inst;
+
+            int32_t move_id = this->moves.size();
+            this->moves.push_back(m);
+            this->moveState.push_back(move_worklist);
+            this->worklistMoves.insert(move_id);
+
+            this->moveList[m.dst].push_back(move_id);
+            if (m.src != m.dst) this->moveList[m.src].push_back(move_id);
         }
-        
     }
 
-    Item * NodeSelector::select_next_node() {
+    void NodeSelector::make_worklist() {
+        for (int32_t n = 0; n < (int32_t) this->state.size(); n++) {
+            if (this->is_precolored(n)) continue;
+
+            if (this->degree[n] >= this->color_num) {
+                this->state[n] = node_spill;
+                this->spillWorklist.insert(n);
+            } else if (this->move_related(n)) {
+                this->state[n] = node_freeze;
+                this->freezeWorklist.insert(n);
+            } else {
+                this->state[n] = node_simplify;
+                this->simplifyWorklist.insert(n);
+            }
+        }
+    }
+
+    void NodeSelector::node_moves(int32_t n, std::vector<int32_t> & result) {
+        for (int32_t m : this->moveList[n]) {
+            if (this->moveState[m] == move_active || this->moveState[m] == move_worklist) {
+                result.push_back(m);
+            }
+        }
+    }
+
+    bool NodeSelector::move_related(int32_t n) {
+        std::vector<int32_t> m;
+        this->node_moves(n, m);
+        return !m.empty();
+    }
+
+    void NodeSelector::adjacent(int32_t n, std::vector<int32_t> & result) {
+        for (int32_t t : this->intGraph->get_neighbors(n)) {
+            if (this->state[t] == node_selected || this->state[t] == node_coalesced) continue;
+            result.push_back(t);
+        }
+    }
+
+    void NodeSelector::add_edge(int32_t u, int32_t v) {
+        if (!this->intGraph->add_edge(u, v)) return;
+
+        if (!this->is_precolored(u)) this->degree[u]++;
+        if (!this->is_precolored(v)) this->degree[v]++;
+    }
+
+    void NodeSelector::move_to_worklist(int32_t n, NodeState to) {
+        switch (this->state[n]) {
+            case node_simplify: this->simplifyWorklist.erase(n); break;
+            case node_freeze:   this->freezeWorklist.erase(n); break;
+            case node_spill:    this->spillWorklist.erase(n); break;
+            default: break;
+        }
+
+        this->state[n] = to;
+
+        switch (to) {
+            case node_simplify: this->simplifyWorklist.insert(n); break;
+            case node_freeze:   this->freezeWorklist.insert(n); break;
+            case node_spill:    this->spillWorklist.insert(n); break;
+            default: break;
+        }
+    }
+
+    void NodeSelector::enable_moves(int32_t n) {
+        std::vector<int32_t> nodes = {n};
+        this->adjacent(n, nodes);
+
+        for (int32_t node : nodes) {
+            std::vector<int32_t> node_moves;
+            this->node_moves(node, node_moves);
+
+            for (int32_t m : node_moves) {
+                if (this->moveState[m] == move_active) {
+                    this->activeMoves.erase(m);
+                    this->moveState[m] = move_worklist;
+                    this->worklistMoves.insert(m);
+                }
+            }
+        }
+    }
+
+    void NodeSelector::decrement_degree(int32_t m) {
+        if (this->is_precolored(m)) return;
+
+        int32_t d = this->degree[m];
+        this->degree[m]--;
+
+        if (d == this->color_num && this->state[m] == node_spill) {
+            this->enable_moves(m);
+            this->move_to_worklist(m, this->move_related(m) ? node_freeze : node_simplify);
+        }
+    }
+
+    int32_t NodeSelector::get_alias(int32_t n) {
+        while (this->state[n] == node_coalesced) {
+            n = this->alias[n];
+        }
+        return n;
+    }
+
+    void NodeSelector::add_worklist(int32_t u) {
+        if (!this->is_precolored(u) && !this->move_related(u) && this->degree[u] < this->color_num) {
+            this->move_to_worklist(u, node_simplify);
+        }
+    }
+
+    bool NodeSelector::george_ok(int32_t t, int32_t r) {
+        return this->degree[t] < this->color_num
+            || this->is_precolored(t)
+            || this->intGraph->interfere(t, r);
+    }
+
+    bool NodeSelector::briggs_conservative(int32_t u, int32_t v) {
+        std::vector<int32_t> nodes;
+        this->adjacent(u, nodes);
+        this->adjacent(v, nodes);
+
+        std::set<int32_t> significant;
+        for (int32_t n : nodes) {
+            if (this->is_precolored(n) || this->degree[n] >= this->color_num) {
+                significant.insert(n);
+            }
+        }
+
+        return (int32_t) significant.size() < this->color_num;
+    }
+
+    void NodeSelector::combine(int32_t u, int32_t v) {
+        this->move_to_worklist(v, node_coalesced);
+        this->alias[v] = u;
+
+        this->moveList[u].insert(
+            this->moveList[u].end(),
+            this->moveList[v].begin(),
+            this->moveList[v].end()
+        );
+        this->enable_moves(v);
+
+        std::vector<int32_t> neighbors;
+        this->adjacent(v, neighbors);
+        for (int32_t t : neighbors) {
+            this->add_edge(t, u);
+            this->decrement_degree(t);
+        }
+
+        if (this->degree[u] >= this->color_num && this->state[u] == node_freeze) {
+            this->move_to_worklist(u, node_spill);
+        }
+    }
+
+    void NodeSelector::simplify() {
+        int32_t n = *this->simplifyWorklist.begin();
+        this->move_to_worklist(n, node_selected);
+        this->selectStack.push_back(n);
+
+        std::vector<int32_t> neighbors;
+        this->adjacent(n, neighbors);
+        for (int32_t m : neighbors) {
+            this->decrement_degree(m);
+        }
+    }
+
+    void NodeSelector::coalesce() {
+        int32_t m = *this->worklistMoves.begin();
+        this->worklistMoves.erase(this->worklistMoves.begin());
+
+        int32_t x = this->get_alias(this->moves[m].dst);
+        int32_t y = this->get_alias(this->moves[m].src);
 
         /**
-         *  edgeCnt2nodes contains the following information
-         *      (number_of_edges, set of nodes tha have such number_of_edges)
-         *   
-         *  Note that map keeps an increasing on number_of_edges
+         *  keep a precolored node as the representative
          * */
-        std::map<int32_t, std::set<Item * >> edgeCnt2nodes;
-        this->intGraph.get_nodes_stats(edgeCnt2nodes);
-        
-        // DEBUG_OUT << "edgeCnt2nodes.size() = " << edgeCnt2nodes.size() << '\n';
-        Item * toRemove = NULL;
-        if (edgeCnt2nodes.size() == 0) return NULL;
+        int32_t u = this->is_precolored(y) ? y : x;
+        int32_t v = this->is_precolored(y) ? x : y;
 
-        int32_t lowest_num_edges = edgeCnt2nodes.begin()->first;
+        if (u == v) {
+            this->moveState[m] = move_coalesced;
+            this->add_worklist(u);
 
-        if (lowest_num_edges <= this->color_num) {
-            /**
-             *  toRemove = the one with most number of edges <= this->color_num
-             * */
-            for (auto & kv : edgeCnt2nodes) {
-                int32_t number_of_edges = kv.first;
-            
-                if (number_of_edges > this->color_num) {
-                    break;
+        } else if (this->is_precolored(v) || this->intGraph->interfere(u, v)) {
+            this->moveState[m] = move_constrained;
+            allocation_stats.constrained++;
+            this->add_worklist(u);
+            this->add_worklist(v);
+
+        } else {
+            bool ok;
+            if (this->is_precolored(u)) {
+                /**
+                 *  George: every neighbor of v already interferes with u or is harmless
+                 * */
+                std::vector<int32_t> neighbors;
+                this->adjacent(v, neighbors);
+
+                ok = true;
+                for (int32_t t : neighbors) {
+                    if (!this->george_ok(t, u)) {
+                        ok = false;
+                        break;
+                    }
                 }
+            } else {
+                /**
+                 *  Briggs: the merged node has fewer than K significant neighbors
+                 * */
+                ok = this->briggs_conservative(u, v);
+            }
 
-                toRemove = *kv.second.begin();
+            if (ok) {
+                this->moveState[m] = move_coalesced;
+                allocation_stats.coalesced++;
+                this->combine(u, v);
+                this->add_worklist(u);
+            } else {
+                this->moveState[m] = move_active;
+                this->activeMoves.insert(m);
             }
+        }
+    }
 
-        } else {
-            /**
-             *  toRemove = the one with most number of edges 
-             * */
-            toRemove = *(edgeCnt2nodes.rbegin()->second.begin());
+    void NodeSelector::freeze_moves(int32_t u) {
+        std::vector<int32_t> node_moves;
+        this->node_moves(u, node_moves);
+
+        for (int32_t m : node_moves) {
+            int32_t x = this->moves[m].dst;
+            int32_t y = this->moves[m].src;
+
+            int32_t v = (this->get_alias(y) == this->get_alias(u)) ? this->get_alias(x) : this->get_alias(y);
+
+            if (this->moveState[m] == move_active) {
+                this->activeMoves.erase(m);
+            } else {
+                this->worklistMoves.erase(m);
+            }
+            this->moveState[m] = move_frozen;
+            allocation_stats.frozen++;
+
+            if (this->state[v] == node_freeze && !this->move_related(v) && this->degree[v] < this->color_num) {
+                this->move_to_worklist(v, node_simplify);
+            }
+        }
+    }
+
+    void NodeSelector::freeze() {
+        int32_t u = *this->freezeWorklist.begin();
+        this->move_to_worklist(u, node_simplify);
+        this->freeze_moves(u);
+    }
+
+    double NodeSelector::spill_priority(int32_t n) {
+        Item * item = this->intGraph->get_node(n);
+
+        if (IN_SET((*this->noSpill), item)) {
+            return std::numeric_limits<double>::infinity();
+        }
+
+        double cost = IN_MAP((*this->spillCosts), item) ? (*this->spillCosts)[item] : 0;
+        return cost / MAX(this->degree[n], 1);
+    }
+
+    void NodeSelector::select_spill() {
+        int32_t m = *this->spillWorklist.begin();
+        double m_priority = this->spill_priority(m);
+
+        for (int32_t n : this->spillWorklist) {
+            double priority = this->spill_priority(n);
+            if (priority < m_priority) {
+                m = n;
+                m_priority = priority;
+            }
         }
 
-        this->intGraph.remove_node(toRemove);
+        this->move_to_worklist(m, node_simplify);
+        this->freeze_moves(m);
+    }
+
+    void NodeSelector::populate_stack(std::stack<Item *> & nodeStack) {
+        while (true) {
+            if (!this->simplifyWorklist.empty()) {
+                this->simplify();
+            } else if (!this->worklistMoves.empty()) {
+                this->coalesce();
+            } else if (!this->freezeWorklist.empty()) {
+                this->freeze();
+            } else if (!this->spillWorklist.empty()) {
+                this->select_spill();
+            } else {
+                break;
+            }
+        }
 
-        return toRemove;
-   
+        for (int32_t n : this->selectStack) {
+            Item * it = this->intGraph->get_node(n);
+            DEBUG_OUT << "push on stack " << it->to_string() << '\n';
+            nodeStack.push(it);
+        }
+    }
+
+    void NodeSelector::get_coalesced(std::unordered_map<Item *, Item *> & coalesced) {
+        for (int32_t n = 0; n < (int32_t) this->state.size(); n++) {
+            if (this->state[n] == node_coalesced) {
+                coalesced[this->intGraph->get_node(n)] = this->intGraph->get_node(this->alias[n]);
+            }
+        }
     }
 
 
     ColorSelector::ColorSelector (
         InterferenceGraph * intGraph, 
-        std::stack<Item *> *nodeStack
+        std::stack<Item *> *nodeStack,
+        std::unordered_map<Item *, Item *> * coalesced
     ) {
         this->intGraph = intGraph;
         this->nodeStack = nodeStack;
+        this->coalesced = coalesced;
+    }
+
+    Item * ColorSelector::get_alias(Item * item) {
+        while (IN_MAP((*this->coalesced), item)) {
+            item = (*this->coalesced)[item];
+        }
+        return item;
     }
 
     /**
@@ -760,6 +1344,17 @@ namespace L2 {
             }
         }
 
+        /**
+         *  coalesced nodes share the color of the node they were merged into
+         *      if that one got no color they stay variables for the next round
+         * */
+        for (auto & kv : *this->coalesced) {
+            Item * alias = this->get_alias(kv.first);
+            if (IN_MAP(item2color, alias)) {
+                item2color[kv.first] = item2color[alias];
+            }
+        }
+
         return NonColorItems.size() == 0;        
     }
 
@@ -776,10 +1371,10 @@ namespace L2 {
          *  • Sort the colors at design time starting from caller save registers
          *  • Use the lowest free color
          */
-        std::set<Item *> neighbors = this->intGraph->get_neighbors(toColor);
         std::set<Color> neighbor_colors;
 
-        for (Item * n : neighbors) {
+        for (int32_t id : this->intGraph->get_neighbors(toColor)) {
+            Item * n = this->get_alias(this->intGraph->get_node(id));
             if (IN_MAP(item2color, n)) {
                 neighbor_colors.insert(item2color[n]);
             }
@@ -800,10 +1395,12 @@ namespace L2 {
 
     SpillVarSelector::SpillVarSelector(
         std::set<Item *> * NonColorItems,
-        std::set<Item *> * prevSpillReplace
+        std::set<Item *> * prevSpillReplace,
+        SpillCosts * spillCosts
     ) {
         this->NonColorItems = NonColorItems;
         this->prevSpillReplace = prevSpillReplace;
+        this->spillCosts = spillCosts;
     }
 
     /**
@@ -823,16 +1420,28 @@ namespace L2 {
             target.begin(),                 /* first iterator */
             target.end()                    /* end iterator */
         );
+
+        /**
+         *  cheapest first, names break ties so the output does not depend on addresses
+         * */
+        SpillCosts & costs = *this->spillCosts;
+        std::sort(varsToSpill.begin(), varsToSpill.end(), [&costs](Item * a, Item * b) {
+            if (costs[a] != costs[b]) return costs[a] < costs[b];
+            return a->to_string() < b->to_string();
+        });
     }
 
     void run_register_allocation(Program &p) {
-        for (int32_t i = 0; i < p.functions.size(); i++) {
+        /**
+         *  functions share nothing but the registers and allocation_stats
+         * */
+        ThreadPool::parallel_for(p.functions.size(), [&p](int32_t i) {
             RegisterAllocator reg_alloc(p.functions[i], &p.functions[i]);
 
             DEBUG_OUT << "Begin allocation for " << p.functions[i]->name << '\n';
             reg_alloc.allcoate();
 
             p.functions[i]->print();
-        }
+        });
     }
 }   
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <stack>
+#include <atomic>
 #include <unordered_map>
 #include "analysis.h"
+#include "loops.h"
 #include "spiller.h"
 
 namespace L2 {
@@ -33,36 +35,145 @@ namespace L2 {
 
     extern std::unordered_map<Color, Item *> color2reg;
 
+    /**
+     *  Counters of the register allocator, summed over every function
+     *      reported with -v
+     *      functions are allocated in parallel, hence atomic
+     * */
+    struct AllocationStats {
+        std::atomic<int64_t> functions;
+        std::atomic<int64_t> rounds;
+        std::atomic<int64_t> moves;
+        std::atomic<int64_t> coalesced;
+        std::atomic<int64_t> constrained;
+        std::atomic<int64_t> frozen;
+        std::atomic<int64_t> removed_copies;
+        std::atomic<int64_t> spilled;
+        std::atomic<int64_t> split;
+        std::atomic<int64_t> rematerialized;
+    };
+
+    extern AllocationStats allocation_stats;
+
+    /**
+     *  variable -> sum over its uses and defs of 10^(loop depth)
+     * */
+    typedef std::unordered_map<Item *, double> SpillCosts;
+
+    void output_allocation_stats(std::ostream & out);
+
+    /**
+     *  drop `r <- r` left behind once both sides of a copy got the same register
+     * */
+    void remove_redundant_moves(Function * F);
+
+    /**
+     *  a copy between two registers/variables, candidate for coalescing
+     * */
+    struct Move {
+        int32_t dst;
+        int32_t src;
+        Instruction * inst;
+    };
+
+    enum NodeState {
+        node_precolored,
+        node_simplify,
+        node_freeze,
+        node_spill,
+        node_coalesced,
+        node_selected
+    };
+
+    enum MoveState {
+        move_worklist,
+        move_active,
+        move_coalesced,
+        move_constrained,
+        move_frozen
+    };
+
     class NodeSelector {
         public:
         /**
          *  Constructor of node selector
-         *      will copy intGraph to its own member
-         *      so pass by reference but no change to intGraph
+         *      runs iterated register coalescing (Appel & George) on @intGraph
+         *      coalescing merges nodes, so edges get added to the graph
          * */
             NodeSelector(
-                InterferenceGraph & intGraph, 
-                int32_t color_num
+                InterferenceGraph * intGraph, 
+                Function * F,
+                int32_t color_num,
+                SpillCosts * spillCosts,
+                std::set<Item *> * noSpill
             );
 
             void populate_stack(std::stack<Item *> & nodeStack);
+
+            /**
+             *  coalesced node -> node it has been merged into
+             * */
+            void get_coalesced(std::unordered_map<Item *, Item *> & coalesced);
                     
         private:
 
+            InterferenceGraph * intGraph;
+            Function * F;
+            int32_t color_num;
+
+            SpillCosts * spillCosts;
+            std::set<Item *> * noSpill;
+
+            std::vector<NodeState> state;
+            std::vector<int32_t> alias;
+
             /**
-             *  local copy of interference graph
+             *  number of neighbors still in the graph
+             *      updated incrementally on every removal and merge
              * */
-            InterferenceGraph intGraph;
-            int32_t color_num;
+            std::vector<int32_t> degree;
+
+            std::set<int32_t> simplifyWorklist;
+            std::set<int32_t> freezeWorklist;
+            std::set<int32_t> spillWorklist;
+            std::vector<int32_t> selectStack;
+
+            std::vector<Move> moves;
+            std::vector<MoveState> moveState;
+            std::vector<std::vector<int32_t>> moveList;
+            std::set<int32_t> worklistMoves;
+            std::set<int32_t> activeMoves;
+
+            void build();
+            void make_worklist();
+
+            bool is_precolored(int32_t n);
+            bool move_related(int32_t n);
+            void node_moves(int32_t n, std::vector<int32_t> & result);
+            void adjacent(int32_t n, std::vector<int32_t> & result);
+
+            void add_edge(int32_t u, int32_t v);
+            void decrement_degree(int32_t m);
+            void enable_moves(int32_t n);
+            int32_t get_alias(int32_t n);
+
+            void add_worklist(int32_t u);
+            void move_to_worklist(int32_t n, NodeState to);
+            bool george_ok(int32_t t, int32_t r);
+            bool briggs_conservative(int32_t u, int32_t v);
+            void combine(int32_t u, int32_t v);
+
+            void simplify();
+            void coalesce();
+            void freeze();
+            void freeze_moves(int32_t u);
 
             /**
-             *  • Remove the node with the most edges
-                  that’s smaller than then number of colors (15 in L1)
-                • After all nodes with <= 15 edges are removed,
-                  remove the remaining ones starting from the one
-                  with the highest number of edges
+             *  potential spill: the node with the lowest cost / degree
+             *      spill temporaries are only picked if nothing else is left
              * */
-            Item * select_next_node();    
+            double spill_priority(int32_t n);
+            void select_spill();
     };
 
 
@@ -74,7 +185,8 @@ namespace L2 {
              * */
             ColorSelector(
                 InterferenceGraph * intGraph, 
-                std::stack<Item *> *nodeStack
+                std::stack<Item *> *nodeStack,
+                std::unordered_map<Item *, Item *> * coalesced
             );
             /**
              *  Try to assign colors for all variables
@@ -90,6 +202,9 @@ namespace L2 {
         private:
             std::stack<Item *> * nodeStack;
             InterferenceGraph * intGraph;
+            std::unordered_map<Item *, Item *> * coalesced;
+
+            Item * get_alias(Item * item);
             // std::unordered_map<Item *, Color> item2color;
             
 
@@ -127,11 +242,12 @@ namespace L2 {
         public:
             SpillVarSelector(
                 std::set<Item *> * NonColorItems,
-                std::set<Item *> * prevSpillReplace
+                std::set<Item *> * prevSpillReplace,
+                SpillCosts * spillCosts
             );
 
             /**
-             *  spill all right now
+             *  spill all right now, cheapest first
              *      except those created by previous spills
              * */
             void selectVarsToSpill(std::vector<Item *> &varsToSpill);
@@ -139,6 +255,7 @@ namespace L2 {
         private:
             std::set<Item *> * NonColorItems;
             std::set<Item *> * prevSpillReplace;
+            SpillCosts * spillCosts;
     };  
 
     class VarColorVisitor : public InstVisitor
@@ -185,7 +302,71 @@ namespace L2 {
             // VarColorVisitor * var_color_visitor;
             
             void color_variables(Function * F, std::unordered_map<Item *, Color> & item2color);
-            bool analysisAndColoring(Function * , std::set<Item *> & NonColorItems);
+
+            /**
+             *  weight every use and def by 10^(loop depth) of its instruction
+             * */
+            void compute_spill_costs(
+                Function * F,
+                FunctionLivenessAnalyzer & live_analyzer,
+                SpillCosts & spillCosts
+            );
+
+            SpillCosts spillCosts;
+
+            /**
+             *  10^(loop depth) of every instruction,
+             *      instructions added by spilling take the weight of their segment
+             * */
+            std::unordered_map<Instruction *, double> instWeight;
+
+            /**
+             *  interference graph of the current F
+             *      built from scratch once, then carried across allocation rounds
+             * */
+            InterferenceGraph intGraph;
+
+            /**
+             *  OUT set of every instruction as last computed
+             *      entries are not rewritten when variables get colored or spilled,
+             *      update_after_spill maps them through @replacedBy/@spilledVars instead
+             * */
+            LiveSet liveOUT;
+            std::unordered_map<Item *, Item *> replacedBy;
+            std::set<Item *> spilledVars;
+
+            /**
+             *  full liveness + interference analysis of F into intGraph/liveOUT
+             * */
+            void analysis(Function * F);
+
+            /**
+             *  coalesce and color a copy of intGraph, then rewrite F with the colors
+             * */
+            bool coloring(
+                Function * F,
+                std::set<Item *> & NonColorItems,
+                std::set<Item *> & noSpill,
+                std::unordered_map<Item *, Color> & item2color
+            );
+
+            bool analysisAndColoring(Function * , std::set<Item *> & NonColorItems, std::set<Item *> & noSpill);
+
+            /**
+             *  bring intGraph/liveOUT up to date after a coloring round and a spill
+             *      colored variables are folded into their register node,
+             *      spilled variables leave the graph,
+             *      and only the spilled segments get liveness recomputed
+             *      to connect the new temporaries
+             *      @splitReplacements get their spill cost from the segments they live in
+             * */
+            void update_after_spill(
+                std::unordered_map<Item *, Color> & item2color,
+                std::vector<Item *> & varsToSpill,
+                std::vector<SpillSite> & sites,
+                std::set<Item *> & splitReplacements
+            );
+            Item * get_replacement(Item * item);
     };
 
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 
+#include <set>
 #include "spiller.h"
+#include "analysis.h"
 
 #define IN_MAP(map, key) (map.find(key) != map.end())
+#define IN_SET(set, key) (set.find(key) != set.end())
 #define ARG_BYTE_NUM 8 
 
 namespace L2 {
@@ -80,24 +83,254 @@ namespace L2 {
     }
 
 
-    SpillerVisitor::SpillerVisitor(
-        ItemVariable * varToSpill,
-        ItemVariable * prefix,
-        Function * F
-    ) {
-        this->varToSpill = varToSpill;
-        this->prefix = prefix;
+    SpillerVisitor::SpillerVisitor(Function * F) {
         this->F = F;
-        this->suffix_num = 0;
+        this->varToSpill = NULL;
+        this->rewritten = false;
+        this->pos = 0;
+    }
+
+    void SpillerVisitor::add_var(ItemVariable * varToSpill, ItemVariable * prefix, SpillMode mode, Item * remat) {
+        SpillSlot slot;
+        slot.prefix = prefix;
+        slot.suffix_num = 0;
+        slot.offset = 0;
+        slot.mode = mode;
+        slot.remat = remat;
+
+        if (remat == NULL) {
+            this->F->locals += 1;
+            slot.offset = (this->F->locals - 1) * ARG_BYTE_NUM;
+        }
+
+        this->varsToSpill.push_back(varToSpill);
+        this->slots[varToSpill] = slot;
+    }
+
+    void SpillerVisitor::rewrite_inst(Instruction * inst) {
+        /**
+         *  a label starts a segment;
+         *      branches, returns and calls end one
+         * */
+        if (inst->type == InstType::inst_label) {
+            this->flush_segment();
+        }
+
+        this->segment.push_back(inst);
+
+        switch (inst->type) {
+            case InstType::inst_ret:
+            case InstType::inst_goto:
+            case InstType::inst_cjump:
+            case InstType::inst_call:
+                this->flush_segment();
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void SpillerVisitor::finish() {
+        this->flush_segment();
+    }
+
+    void SpillerVisitor::flush_segment() {
+        int32_t size = this->segment.size();
+        if (size == 0) return;
+
+        this->loads = std::vector<std::vector<Instruction *>>(size);
+        this->stores = std::vector<std::vector<Instruction *>>(size);
+        this->dropped = std::vector<bool>(size, false);
+        this->rewritten = false;
+
+        for (ItemVariable * var : this->varsToSpill) {
+            this->varToSpill = var;
+            this->refs.clear();
+
+            for (this->pos = 0; this->pos < size; this->pos++) {
+                this->segment[this->pos]->accept(*this);
+            }
+
+            if (this->refs.empty()) continue;
+
+            if (this->slots[var].mode == spill_segment) {
+                this->spill_segment_refs();
+            } else {
+                this->spill_per_use_refs();
+            }
+        }
+
+        int32_t start = this->new_insts.size();
+        Instruction * anchor = NULL;
+
+        for (int32_t k = 0; k < size; k++) {
+            this->new_insts.insert(this->new_insts.end(), this->loads[k].begin(), this->loads[k].end());
+
+            if (!this->dropped[k]) {
+                this->new_insts.push_back(this->segment[k]);
+                anchor = this->segment[k];
+            }
+
+            this->new_insts.insert(this->new_insts.end(), this->stores[k].begin(), this->stores[k].end());
+        }
+
+        if (this->rewritten) {
+            SpillSite site;
+            site.insts = std::vector<Instruction *>(this->new_insts.begin() + start, this->new_insts.end());
+            site.anchor = anchor;
+            this->sites.push_back(site);
+        }
+
+        this->segment.clear();
+    }
+
+    void SpillerVisitor::spill_per_use_refs() {
+        SpillSlot & slot = this->slots[this->varToSpill];
+
+        for (SpillRef & ref : this->refs) {
+            /**
+             *  a rematerialized variable is only ever defined by `var <- remat`,
+             *      those definitions go away
+             * */
+            if (slot.remat != NULL && ref.write) {
+                this->dropped[ref.pos] = true;
+                continue;
+            }
+
+            ItemVariable * new_var = NULL;
+            ItemMemoryAccess * stacklocal = NULL;
+
+            if (ref.read){
+                new_var = this->build_new_var_prefix_suffix();
+                if (slot.remat == NULL) {
+                    stacklocal = this->build_stackAccess_locals();
+                }
+
+                this->loads[ref.pos].push_back(this->build_load(new_var, stacklocal));
+            }
+
+
+            /**
+             *  changed the place include at instruction
+             *  if it somewhat contains varToSpill
+             * */
+            if (new_var == NULL && !ref.places.empty()) {
+                new_var = this->build_new_var_prefix_suffix();
+            }
+
+            for (Item ** wAddr : ref.places) {
+                *wAddr = new_var;
+            }
+
+            if (new_var != NULL) {
+                this->rewritten = true;
+            }
+
+
+            if (ref.write)
+            {
+                /**
+                 *  put a writeToStack instruction when it is purely write
+                 *  mem rsp 0 <- %S0
+                 * */
+                if (new_var == NULL) {
+                    new_var = this->build_new_var_prefix_suffix();
+                }
+
+                if (stacklocal == NULL) {
+                    stacklocal = this->build_stackAccess_locals();
+                }
+
+                Instruction_assignment * writeToStack = new Instruction_assignment;
+                writeToStack->type = inst_assign;
+                writeToStack->dst = stacklocal;
+                writeToStack->src = new_var;
+
+                /**
+                 *  stores of later variables go right behind the instruction,
+                 *      the same order spilling them one at a time gives
+                 * */
+                this->stores[ref.pos].insert(this->stores[ref.pos].begin(), writeToStack);
+
+            }
+        }
+    }
+
+    void SpillerVisitor::spill_segment_refs() {
+        SpillSlot & slot = this->slots[this->varToSpill];
+
+        ItemVariable * new_var = NULL;
+        SpillRef * firstRead = NULL;
+        SpillRef * lastWrite = NULL;
+
+        for (SpillRef & ref : this->refs) {
+            if (slot.remat != NULL && ref.write) {
+                this->dropped[ref.pos] = true;
+                continue;
+            }
+
+            if (new_var == NULL) {
+                new_var = this->build_new_var_prefix_suffix();
+                this->split_replacements.push_back(new_var);
+                this->rewritten = true;
+            }
+
+            for (Item ** wAddr : ref.places) {
+                *wAddr = new_var;
+            }
+
+            /**
+             *  the value only comes from the stack if it is read before being written
+             * */
+            if (ref.read && firstRead == NULL && lastWrite == NULL) {
+                firstRead = &ref;
+            }
+
+            if (ref.write) {
+                lastWrite = &ref;
+            }
+        }
+
+        if (firstRead != NULL) {
+            ItemMemoryAccess * stacklocal = (slot.remat == NULL) ? this->build_stackAccess_locals() : NULL;
+            this->loads[firstRead->pos].push_back(this->build_load(new_var, stacklocal));
+        }
+
+        if (lastWrite != NULL) {
+            Instruction_assignment * writeToStack = new Instruction_assignment;
+            writeToStack->type = inst_assign;
+            writeToStack->dst = this->build_stackAccess_locals();
+            writeToStack->src = new_var;
+
+            this->stores[lastWrite->pos].insert(this->stores[lastWrite->pos].begin(), writeToStack);
+        }
+    }
+
+    Instruction * SpillerVisitor::build_load(ItemVariable * new_var, ItemMemoryAccess * stacklocal) {
+        SpillSlot & slot = this->slots[this->varToSpill];
+
+        /**
+         *  %S0 <- mem rsp 0
+         *      or %S0 <- remat
+         * */
+        Instruction_assignment * fetchFromStack = new Instruction_assignment;
+        fetchFromStack->type = inst_assign;
+        fetchFromStack->dst = new_var;
+        fetchFromStack->src = (slot.remat == NULL) ? (Item *) stacklocal : slot.remat->copy();
+
+        return fetchFromStack;
     }
 
     ItemVariable * SpillerVisitor::build_new_var_prefix_suffix() {
-        std::string newSubstiut_str = this->prefix->name + std::to_string(suffix_num);
+        SpillSlot & slot = this->slots[this->varToSpill];
+
+        std::string newSubstiut_str = slot.prefix->name + std::to_string(slot.suffix_num);
         ItemVariable * v = new ItemVariable(
             newSubstiut_str
         );
 
-        this->suffix_num++;
+        slot.suffix_num++;
 
         this->F->varName2ptr[newSubstiut_str] = v;
 
@@ -106,7 +339,7 @@ namespace L2 {
     }
 
     ItemMemoryAccess * SpillerVisitor::build_stackAccess_locals() {
-        ItemConstant * offset = new ItemConstant((this->F->locals - 1) * ARG_BYTE_NUM);
+        ItemConstant * offset = new ItemConstant(this->slots[this->varToSpill].offset);
         
         ItemMemoryAccess * memA = new ItemMemoryAccess(
             & L2::reg_rsp,
@@ -122,85 +355,34 @@ namespace L2 {
             bool HasWritten,
             std::vector<Item **> & placeToReplace 
     ){
-        ItemVariable * new_var = NULL;
-        ItemMemoryAccess * stacklocal = NULL;
-        
-        if (HasRead){
-            new_var = this->build_new_var_prefix_suffix(); 
-            stacklocal = this->build_stackAccess_locals();
-
-            /**
-             *  mem rsp 0 <- %S0
-             * */
-            Instruction_assignment * fetchFromStack = new Instruction_assignment;
-            fetchFromStack->type = inst_assign;
-            fetchFromStack->dst = new_var;
-            fetchFromStack->src = stacklocal;
-
-            this->new_insts.push_back(fetchFromStack);
-        }
-
-
         /**
-         *  changed the place include at instruction 
-         *  if it somewhat contains varToSpill
+         *  only record the reference,
+         *      the segment is rewritten once all of its references are known
          * */
-        if (new_var == NULL && !placeToReplace.empty()) {
-            new_var = this->build_new_var_prefix_suffix(); 
-        }
-
-        for (Item ** wAddr : placeToReplace) {
-            *wAddr = new_var;
+        if (!HasRead && !HasWritten && placeToReplace.empty()) {
+            return;
         }
 
-        this->new_insts.push_back(inst);
-
-
-        if (HasWritten) 
-        {   
-            /**
-             *  put a writeToStack instruction when it is purely write
-             *  mem rsp 0 <- %S0
-             * */
-            if (new_var == NULL) {
-                new_var = this->build_new_var_prefix_suffix(); 
-            }
-
-            if (stacklocal == NULL) {
-                stacklocal = this->build_stackAccess_locals();
-            }
-
-            Instruction_assignment * writeToStack = new Instruction_assignment;
-            writeToStack->type = inst_assign;
-            writeToStack->dst = stacklocal;
-            writeToStack->src = new_var;
-
-            this->new_insts.push_back(writeToStack);
-
-        }
+        this->refs.push_back({this->pos, HasRead, HasWritten, placeToReplace});
     }
 
     void SpillerVisitor::visit(Instruction_ret *ret) {
         /**
-         *  push original instruction
+         *  nothing to spill, flush_segment keeps the original instruction
          * */
-
-        this->new_insts.push_back(ret);
     } 
 
     void SpillerVisitor::visit(Instruction_label * label_inst) {
         /**
-         *  push original instruction
+         *  nothing to spill, flush_segment keeps the original instruction
          * */
-        this->new_insts.push_back(label_inst);
     }
 
 
     void SpillerVisitor::visit(Instruction_call_runtime *runtime_call) {
         /**
-         *  push original instruction
+         *  nothing to spill, flush_segment keeps the original instruction
          * */
-        this->new_insts.push_back(runtime_call);
     }
 
     void SpillerVisitor::visit(Instruction_call_user *user_call) {
@@ -311,11 +493,9 @@ namespace L2 {
     }
     
     void SpillerVisitor::visit(Instruction_goto *inst_goto) {
-         /**
-         *  push original instruction
+        /**
+         *  nothing to spill, flush_segment keeps the original instruction
          * */
-
-        this->new_insts.push_back(inst_goto);
     }
     
     void SpillerVisitor::visit(Instruction_dec *dec) {
@@ -381,11 +561,7 @@ namespace L2 {
         this->varToSpill = varToSpill;
         this->prefix = prefix;
 
-        this->spill_visitor = new SpillerVisitor(
-            varToSpill,
-            prefix,
-            F
-        );
+        this->spill_visitor = new SpillerVisitor(F);
     }
 
     void Spiller::spill_variables()
@@ -397,11 +573,12 @@ namespace L2 {
         }
 
 
-        this->F->locals += 1;
+        this->spill_visitor->add_var(this->varToSpill, this->prefix, spill_per_use, NULL);
         
         for (Instruction *inst : this->F->instructions) {
-            inst->accept(*this->spill_visitor);
+            this->spill_visitor->rewrite_inst(inst);
         }
+        this->spill_visitor->finish();
 
         this->F->instructions = this->spill_visitor->new_insts;
 
@@ -416,6 +593,97 @@ namespace L2 {
     }
 
 
+    BatchSpiller::BatchSpiller(Function * F) : spill_visitor(F) {
+        this->F = F;
+        this->rematerialized = 0;
+    }
+
+    void BatchSpiller::add_var(ItemVariable * varToSpill, ItemVariable * prefix, SpillMode mode) {
+        if (!IN_MAP(this->F->varName2ptr, varToSpill->to_string())) {
+            return;
+        }
+
+        this->varsToSpill.push_back(varToSpill);
+        this->prefixes.push_back(prefix);
+        this->modes.push_back(mode);
+    }
+
+    void BatchSpiller::find_rematerializable(std::unordered_map<Item *, Item *> & remat) {
+        std::set<Item *> toSpill(this->varsToSpill.begin(), this->varsToSpill.end());
+        LivenessVisitor live_visitor;
+
+        for (Instruction * inst : this->F->instructions) {
+            inst->accept(live_visitor);
+
+            for (Item * item : live_visitor.KILL[inst]) {
+                if (!IN_SET(toSpill, item)) continue;
+
+                Item * value = NULL;
+                if (inst->type == InstType::inst_assign) {
+                    Item * src = ((Instruction_assignment *) inst)->src;
+
+                    if (src->itemtype == ItemType::item_constant || src->itemtype == ItemType::item_labels) {
+                        value = src;
+                    }
+                }
+
+                /**
+                 *  every definition has to produce the very same value
+                 * */
+                if (IN_MAP(remat, item) && (remat[item] == NULL || value == NULL ||
+                    remat[item]->to_string() != value->to_string())) {
+                    value = NULL;
+                }
+                remat[item] = value;
+            }
+
+            live_visitor.GEN.clear();
+            live_visitor.KILL.clear();
+        }
+    }
+
+    void BatchSpiller::spill_variables() {
+        std::unordered_map<Item *, Item *> remat;
+        this->find_rematerializable(remat);
+
+        for (uint32_t j = 0; j < this->varsToSpill.size(); j++) {
+            ItemVariable * var = this->varsToSpill[j];
+
+            /**
+             *  a variable that is never defined stays on the stack
+             * */
+            Item * value = IN_MAP(remat, var) ? remat[var] : NULL;
+            if (value != NULL) {
+                this->rematerialized++;
+            }
+
+            this->spill_visitor.add_var(var, this->prefixes[j], this->modes[j], value);
+        }
+
+        for (Instruction *inst : this->F->instructions) {
+            this->spill_visitor.rewrite_inst(inst);
+        }
+        this->spill_visitor.finish();
+
+        this->F->instructions = this->spill_visitor.new_insts;
+    }
+
+    std::vector<ItemVariable *> BatchSpiller::get_var_replacement() {
+        return this->spill_visitor.var_replacements;
+    }
+
+    std::vector<ItemVariable *> BatchSpiller::get_split_replacement() {
+        return this->spill_visitor.split_replacements;
+    }
+
+    std::vector<SpillSite> & BatchSpiller::get_sites() {
+        return this->spill_visitor.sites;
+    }
+
+    int32_t BatchSpiller::get_rematerialized() {
+        return this->rematerialized;
+    }
+
     void Spiller::output_spilled_function()
     {   
         std::cout << '(';
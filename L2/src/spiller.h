@@ -7,6 +7,58 @@ namespace L2
 {
     void run_Spill(Program &p);
 
+    enum SpillMode {
+        /**
+         *  load before every read, store after every write
+         * */
+        spill_per_use,
+
+        /**
+         *  split the live range at labels, branches and calls:
+         *      one variable per straight-line segment,
+         *      loaded before its first read and stored after its last write
+         * */
+        spill_segment
+    };
+
+    /**
+     *  stack slot and naming state of one spilled variable
+     * */
+    struct SpillSlot {
+        ItemVariable * prefix;
+        int32_t suffix_num;
+        int64_t offset;
+        SpillMode mode;
+
+        /**
+         *  constant/label every definition assigns
+         *      the variable is rematerialized from it and gets no stack slot
+         *      NULL if it needs the stack
+         * */
+        Item * remat;
+    };
+
+    /**
+     *  a reference to the variable being spilled inside the current segment
+     * */
+    struct SpillRef {
+        int32_t pos;
+        bool read;
+        bool write;
+        std::vector<Item **> places;
+    };
+
+    /**
+     *  a straight-line segment that references a spilled variable
+     *      @insts is the whole segment once rewritten
+     *      @anchor is its last instruction that was there before spilling,
+     *      what is live after @anchor is live at the end of the segment
+     * */
+    struct SpillSite {
+        std::vector<Instruction *> insts;
+        Instruction * anchor;
+    };
+
     class SpillerVisitor : public InstVisitor
     {
     public:
@@ -23,26 +75,75 @@ namespace L2
         void visit(Instruction_inc *) override;
         void visit(Instruction_cjump *) override;
 
-        SpillerVisitor(
-            ItemVariable * varToSpill,
-            ItemVariable * prefix,
-            Function * F
-        );
+        SpillerVisitor(Function * F);
+
+        /**
+         *  spill @varToSpill, the variables replacing it are named @prefix + number
+         *      unless @remat is given it gets its own stack slot (F->locals grows by one)
+         * */
+        void add_var(ItemVariable * varToSpill, ItemVariable * prefix, SpillMode mode, Item * remat);
+
+        /**
+         *  rewrite @inst for every variable added so far
+         *      instructions are buffered up to the end of their segment,
+         *      the rewritten segment is then appended to new_insts
+         * */
+        void rewrite_inst(Instruction * inst);
+
+        /**
+         *  flush the last segment
+         * */
+        void finish();
 
         std::vector<Instruction *> new_insts;
         std::vector<ItemVariable *> var_replacements;
+
+        /**
+         *  replacements made by spill_segment, a subset of var_replacements
+         * */
+        std::vector<ItemVariable *> split_replacements;
+
+        /**
+         *  every segment that has been rewritten, in program order
+         * */
+        std::vector<SpillSite> sites;
     private:
         Function * F;
-        
+
         /**
          *  map contains all instructions that have variables to be spilled
          *      inst -> vector replacement instruction
          * */
         // std::map<Instruction *, std::vector<Instruction *>> inst2replacement;
 
+        std::vector<ItemVariable *> varsToSpill;
+        std::unordered_map<Item *, SpillSlot> slots;
+
+        /**
+         *  variable the visit functions are spilling right now
+         * */
         ItemVariable *varToSpill;
-        ItemVariable *prefix;
-        int32_t suffix_num;
+
+        /**
+         *  current segment, and for each of its instructions
+         *      the loads to put in front, the stores to put behind
+         *      and whether it is a definition of a rematerialized variable
+         * */
+        std::vector<Instruction *> segment;
+        std::vector<std::vector<Instruction *>> loads;
+        std::vector<std::vector<Instruction *>> stores;
+        std::vector<bool> dropped;
+        bool rewritten;
+
+        /**
+         *  references to varToSpill in the segment, filled by the visit functions
+         * */
+        std::vector<SpillRef> refs;
+        int32_t pos;
+
+        void flush_segment();
+        void spill_per_use_refs();
+        void spill_segment_refs();
 
         /**
          *  produce pointer to variable from prefix and suffix number
@@ -53,18 +154,24 @@ namespace L2
         ItemVariable * build_new_var_prefix_suffix();
 
         /**
-         *  return pointer to a new memory access item based on F->locals
-         *      mem rsp F->locals - 1
+         *  return pointer to a new memory access item for the stack slot of varToSpill
+         *      mem rsp offset
          * */
         ItemMemoryAccess * build_stackAccess_locals();
 
+        /**
+         *  instruction that gives @new_var the value of varToSpill
+         *      a load from its stack slot, or its constant/label when rematerialized
+         * */
+        Instruction * build_load(ItemVariable * new_var, ItemMemoryAccess * stacklocal);
+
         void spill_Inst(
             Instruction * inst,
             bool HasRead,
             bool HasWritten,
-            std::vector<Item **> & placeToWrite 
+            std::vector<Item **> & placeToWrite
         );
-    
+
     };
 
 
@@ -87,7 +194,41 @@ namespace L2
             ItemVariable * prefix;
 
             SpillerVisitor * spill_visitor;
-            
+
+    };
+
+    /**
+     *  Spill several variables of F in a single walk over its instructions
+     *      each variable gets its own stack slot, in the order they are added
+     *      variables whose definitions all assign the same constant/label are rematerialized
+     * */
+    class BatchSpiller {
+        public:
+            BatchSpiller(Function * F);
+
+            void add_var(ItemVariable * varToSpill, ItemVariable * prefix, SpillMode mode);
+            void spill_variables();
+
+            std::vector<ItemVariable *> get_var_replacement();
+            std::vector<ItemVariable *> get_split_replacement();
+            std::vector<SpillSite> & get_sites();
+
+            int32_t get_rematerialized();
+        private:
+            Function * F;
+
+            std::vector<ItemVariable *> varsToSpill;
+            std::vector<ItemVariable *> prefixes;
+            std::vector<SpillMode> modes;
+
+            /**
+             *  variable -> the constant/label all of its definitions assign
+             *      NULL once some definition assigns anything else
+             * */
+            void find_rematerializable(std::unordered_map<Item *, Item *> & remat);
+            int32_t rematerialized;
+
+            SpillerVisitor spill_visitor;
     };
 
-}        
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <transformer.h>
+
+namespace L2 {
+
+    static Instruction_assignment * build_move(Item * dst, Item * src) {
+        Instruction_assignment * move = new Instruction_assignment;
+        move->type = inst_assign;
+        move->dst = dst;
+        move->src = src;
+        return move;
+    }
+
+    static bool names_label(Item * it, const std::string & name) {
+        return it->itemtype == item_labels && ((ItemLabel *) it)->labelName == name;
+    }
+
+    static bool is_tail_call(Instruction * inst) {
+        return inst->type == inst_call
+            && !((Instruction_call *) inst)->isRuntimeCall
+            && ((Instruction_call_user *) inst)->isTail;
+    }
+
+    void save_callee_registers(Function * F) {
+        std::vector<Instruction *> saves;
+        std::vector<Item *> copies;
+
+        for (ItemRegister * reg : callee_saved) {
+            /**
+             *  %CALLEE_SAVE_rbx <- rbx
+             * */
+            std::string name = "%CALLEE_SAVE_" + reg->to_string();
+            ItemVariable * copy = new ItemVariable(name);
+            F->varName2ptr[name] = copy;
+
+            saves.push_back(build_move(copy, reg));
+            copies.push_back(copy);
+        }
+
+        std::vector<Instruction *> instructions;
+        instructions.reserve(F->instructions.size() + saves.size());
+        instructions.insert(instructions.end(), saves.begin(), saves.end());
+
+        for (Instruction * inst : F->instructions) {
+            /**
+             *  rbx <- %CALLEE_SAVE_rbx
+             *  return
+             *      and the same before a tail call, which returns to our caller as well
+             * */
+            if (inst->type == inst_ret || is_tail_call(inst)) {
+                for (int32_t i = 0; i < L2::CALLEE_NUM; i++) {
+                    instructions.push_back(build_move(callee_saved[i], copies[i]));
+                }
+            }
+
+            instructions.push_back(inst);
+        }
+
+        F->instructions = std::move(instructions);
+    }
+
+    /**
+     *  some instruction of @p calls @name or takes its address
+     * */
+    static bool label_referenced(Program & p, const std::string & name) {
+        for (Function * F : p.functions) {
+            for (Instruction * inst : F->instructions) {
+                if (inst->type == inst_assign) {
+                    Instruction_assignment * assign = (Instruction_assignment *) inst;
+                    if (names_label(assign->src, name)) return true;
+                }
+
+                if (inst->type == inst_call && !((Instruction_call *) inst)->isRuntimeCall) {
+                    Instruction_call_user * call = (Instruction_call_user *) inst;
+                    if (names_label(call->callee, name)) return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    void save_callee_registers(Program & p) {
+        /**
+         *  go saves the callee-saved registers around the entry point itself,
+         *      unless the program calls the entry point again there is nothing left to save
+         * */
+        bool entryReentered = label_referenced(p, p.entryPointLabel);
+
+        for (Function * F : p.functions) {
+            if (F->name == p.entryPointLabel && !entryReentered) continue;
+            save_callee_registers(F);
+        }
+    }
+
+    static void count_label(Item * it, std::unordered_map<std::string, int32_t> & uses) {
+        if (it->itemtype == item_labels) uses[((ItemLabel *) it)->labelName]++;
+    }
+
+    /**
+     *  how often each label is named by an instruction, its definition aside
+     * */
+    static void count_label_uses(Function * F, std::unordered_map<std::string, int32_t> & uses) {
+        for (Instruction * inst : F->instructions) {
+            switch (inst->type) {
+                case inst_assign:
+                    count_label(((Instruction_assignment *) inst)->src, uses);
+                    break;
+
+                case inst_goto:
+                    count_label(((Instruction_goto *) inst)->gotoLabel, uses);
+                    break;
+
+                case inst_cjump:
+                    count_label(((Instruction_cjump *) inst)->dst, uses);
+                    break;
+
+                case inst_call:
+                    if (!((Instruction_call *) inst)->isRuntimeCall) {
+                        count_label(((Instruction_call_user *) inst)->callee, uses);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    /**
+     *  mem rsp -8 <- @label
+     * */
+    static bool stores_return_address(Instruction * inst, const std::string & label) {
+        if (inst->type != inst_assign) return false;
+
+        Instruction_assignment * assign = (Instruction_assignment *) inst;
+        if (!names_label(assign->src, label) || assign->dst->itemtype != item_memory) return false;
+
+        ItemMemoryAccess * mem = (ItemMemoryAccess *) assign->dst;
+        return mem->reg->itemtype == item_registers
+            && ((ItemRegister *) mem->reg)->rType == rsp
+            && mem->offset->itemtype == item_constant
+            && ((ItemConstant *) mem->offset)->constVal == -8;
+    }
+
+    /**
+     *  @inst moves a value into a variable or rax,
+     *      @holders (rax and variables, by name) is updated to those still holding the call result
+     *  false for anything else, which ends the search for a tail call
+     * */
+    static bool moves_result(Instruction * inst, std::set<std::string> & holders) {
+        if (inst->type != inst_assign) return false;
+
+        Instruction_assignment * move = (Instruction_assignment *) inst;
+        bool toRax = move->dst->itemtype == item_registers && ((ItemRegister *) move->dst)->rType == rax;
+        if (move->dst->itemtype != item_variable && !toRax) return false;
+
+        ItemType srcType = move->src->itemtype;
+        if (srcType != item_variable && srcType != item_registers && srcType != item_constant) return false;
+
+        std::string dst = move->dst->to_string();
+        if (srcType != item_constant && holders.count(move->src->to_string()) > 0) {
+            holders.insert(dst);
+        } else {
+            holders.erase(dst);
+        }
+
+        return true;
+    }
+
+    void find_tail_calls(Function * F) {
+        std::vector<Instruction *> & insts = F->instructions;
+        int32_t size = insts.size();
+
+        std::unordered_map<std::string, int32_t> labelUses;
+        count_label_uses(F, labelUses);
+
+        std::vector<bool> dropped(size, false);
+
+        for (int32_t i = 0; i + 1 < size; i++) {
+            if (insts[i]->type != inst_call || ((Instruction_call *) insts[i])->isRuntimeCall) continue;
+            if (insts[i + 1]->type != inst_label) continue;
+
+            /**
+             *  the return label may only be named by the store of the return address
+             * */
+            std::string retLabel = ((ItemLabel *) ((Instruction_label *) insts[i + 1])->item_label)->labelName;
+            if (labelUses[retLabel] != 1) continue;
+
+            /**
+             *  the result reaches the return in rax, moved around at most
+             * */
+            std::set<std::string> holders = {reg_rax.to_string()};
+            int32_t ret = i + 2;
+            while (ret < size && moves_result(insts[ret], holders)) ret++;
+            if (ret == size || insts[ret]->type != inst_ret || holders.count(reg_rax.to_string()) == 0) continue;
+
+            /**
+             *  the store sits among the moves setting up the arguments
+             * */
+            int32_t store = i - 1;
+            while (store >= 0 && insts[store]->type == inst_assign && !stores_return_address(insts[store], retLabel)) {
+                store--;
+            }
+            if (store < 0 || !stores_return_address(insts[store], retLabel)) continue;
+
+            ((Instruction_call_user *) insts[i])->isTail = true;
+            dropped[store] = true;
+            for (int32_t j = i + 1; j <= ret; j++) {
+                dropped[j] = true;
+            }
+
+            i = ret;
+        }
+
+        std::vector<Instruction *> instructions;
+        for (int32_t i = 0; i < size; i++) {
+            if (!dropped[i]) instructions.push_back(insts[i]);
+        }
+
+        F->instructions = std::move(instructions);
+    }
+
+    void find_tail_calls(Program & p) {
+        for (Function * F : p.functions) {
+            find_tail_calls(F);
+        }
+    }
+}
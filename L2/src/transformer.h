@@ -1 +1,41 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+#include <L2.h>
+
+namespace L2 {
+
+    /**
+     *  Hand the callee-saved registers to the register allocator
+     *      every callee-saved register is copied into a fresh variable on entry
+     *      and copied back right before each return
+     *  the allocator then decides what saving costs:
+     *      a register the function never needs is coalesced with its copy and both moves vanish,
+     *      one it does need leaves its copy to be spilled, i.e. saved in the frame
+     *  so only the registers the final assignment really uses get saved
+     * */
+    void save_callee_registers(Function * F);
+
+    /**
+     *  every function of @p but the entry point, go saves the registers around that one
+     *      (unless the program calls the entry point itself)
+     * */
+    void save_callee_registers(Program & p);
+
+    /**
+     *  Turn calls in tail position into tail calls
+     *      mem rsp -8 <- :ret
+     *      call u N
+     *      :ret
+     *      %r <- rax
+     *      rax <- %r
+     *      return
+     *  becomes tail-call u N: the callee reuses our frame and returns straight to our caller
+     *  only moves passing the result along may sit between the call and the return,
+     *  and :ret may be named by nothing but the store
+     *  must run before save_callee_registers, which restores the registers before tail calls too
+     * */
+    void find_tail_calls(Function * F);
+
+    void find_tail_calls(Program & p);
+
+}
@@ -297,6 +297,105 @@ namespace L3 {
         return ret;
     }
 
+    /**
+     *  names indexed by Register_type
+     * */
+    static const char * const register_names[] = {
+        "rdi", "rax", "rsi", "rdx", "rcx", "r8", "r9", "rbx", "rbp", "r10", "r11", "r12", "r13", "r14", "r15", "rsp"
+    };
+
+    static const char * aop_name(AopType aopType) {
+        switch (aopType)
+        {
+        case AopType::plus :        return "+";
+        case AopType::minus :       return "-";
+        case AopType::times :       return "*";
+        case AopType::bit_and :     return "&";
+        case AopType::shift_left :  return "<<";
+        case AopType::shift_right : return ">>";
+        default :                   return NULL;
+        }
+    }
+
+    static const char * cmp_name(CmpType cmptype) {
+        switch (cmptype)
+        {
+        case CmpType::eq :      return "=";
+        case CmpType::less :    return "<";
+        case CmpType::leq :     return "<=";
+        case CmpType::great :   return ">";
+        case CmpType::geq :     return ">=";
+        default :               return NULL;
+        }
+    }
+
+    void ItemRegister::print(Output::Sink & out) {
+        if (this->rType < rdi || this->rType > rsp) {
+            std::cerr << "wrong register type in ItemRegister::print\n";
+            return;
+        }
+        out << register_names[this->rType];
+    }
+
+    void ItemConstant::print(Output::Sink & out) {
+        out << this->constVal;
+    }
+
+    void ItemLabel::print(Output::Sink & out) {
+        out << this->labelName;
+    }
+
+    void ItemAop::print(Output::Sink & out) {
+        const char * op = aop_name(this->aopType);
+        if (op == NULL) {
+            std::cerr << "wrong aop type in ItemAop::print\n";
+            return;
+        }
+
+        this->op1->print(out);
+        out << ' ' << op << ' ';
+        this->op2->print(out);
+    }
+
+    void ItemCmp::print(Output::Sink & out) {
+        const char * op = cmp_name(this->cmptype);
+        if (op == NULL) {
+            std::cerr << "wrong cmp type in ItemCmp::print\n";
+            return;
+        }
+
+        this->op1->print(out);
+        out << ' ' << op << ' ';
+        this->op2->print(out);
+    }
+
+    void ItemLoad::print(Output::Sink & out) {
+        out << "load ";
+        this->varToLoad->print(out);
+    }
+
+    void ItemVariable::print(Output::Sink & out) {
+        out << this->name;
+    }
+
+    void ItemStore::print(Output::Sink & out) {
+        out << "store ";
+        this->dst->print(out);
+    }
+
+    void ItemCall::print(Output::Sink & out) {
+        out << "call ";
+        this->callee->print(out);
+        out << '(';
+        
+        for (Item * arg : this->args) {
+            arg->print(out);
+            out << ' ';
+        }
+        
+        out << ')';
+    }
+
 
     void ItemRegister::accept(ItemVisitor & visitor){
         visitor.visit(this);
@@ -5,6 +5,8 @@
 #include <set>
 #include <iostream>
 #include <unordered_map>
+
+#include <output_sink.h>
 // #include "analysis.h"
 
 
@@ -61,6 +63,11 @@ namespace L3 {
         ItemType itemtype;
 
         virtual std::string to_string() = 0;
+
+        /**
+         *  same text as to_string, appended to @out without building a string
+         * */
+        virtual void print(Output::Sink & out) = 0;
         virtual void accept(ItemVisitor &) = 0;
         virtual Item * copy() = 0;
     };
@@ -71,6 +78,7 @@ namespace L3 {
         ItemRegister(Register_type rType); 
         
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemRegister * copy() override;
     };
@@ -82,6 +90,7 @@ namespace L3 {
         ItemConstant(int64_t constVal);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemConstant * copy() override;
     }; 
@@ -92,6 +101,7 @@ namespace L3 {
         ItemLabel(std::string str);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemLabel * copy() override;
     };
@@ -117,6 +127,7 @@ namespace L3 {
         ItemAop(Item *op1, Item *op2, AopType cmpType);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemAop * copy() override;
     };
@@ -130,6 +141,7 @@ namespace L3 {
         ItemCmp(Item *op1, Item *op2, CmpType cmpType);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemCmp * copy() override;
     };
@@ -140,6 +152,7 @@ namespace L3 {
         ItemVariable(std::string str);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor & visitor) override;
         ItemVariable * copy() override;
     };
@@ -161,6 +174,7 @@ namespace L3 {
         ItemLoad(Item *varToLoad);
         
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor &visitor) override;
         ItemLoad * copy() override;
     };
@@ -171,6 +185,7 @@ namespace L3 {
         ItemStore(Item *dst);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor &visitor) override;
         ItemStore * copy() override;
 
@@ -191,6 +206,7 @@ namespace L3 {
         ItemCall(bool isRuntime, Item *callee, std::vector<Item *> & args);
 
         std::string to_string() override;
+        void print(Output::Sink & out) override;
         void accept(ItemVisitor &visitor) override;
         ItemCall * copy() override;
 
@@ -89,39 +89,13 @@ namespace L3
 
     }
 
-    bool calc_live_OUT2IN(
-        Instruction *inst,
-        LiveSet &GEN,
-        LiveSet &KILL,
-        LiveSet &IN,
-        LiveSet &OUT)
-    {
-        std::set<Item *> tempIN;
-        /**
-             *  p = &x;
-             *  IN[i] = GEN[i] U (OUT[i] – KILL[i])
-             * */
-        std::set<Item *> outMinusKill;
-        set_diff(
-            OUT[inst],   /* srcA */
-            KILL[inst],  /* srcB */
-            outMinusKill /* target */
-        );
-
-        set_union(
-            outMinusKill, /* srcA */
-            GEN[inst],    /* srcB */
-            tempIN        /* target */
-        );
-
-        bool diff = tempIN != IN[inst];
-        IN[inst] = tempIN;
-        return diff;
-    }
-
     FunctionLivenessAnalyzer::FunctionLivenessAnalyzer(Function * F){
         this->F = F;
-        
+        this->solver = NULL;
+    }
+
+    FunctionLivenessAnalyzer::~FunctionLivenessAnalyzer(){
+        delete this->solver;
     }
 
     void FunctionLivenessAnalyzer::calculate_GENKILL() {
@@ -202,77 +176,101 @@ OUT[return] = {}
 
      * */
 
+    void FunctionLivenessAnalyzer::number_items() {
+        this->id2item.clear();
+        this->item2id.clear();
+
+        for (Instruction * inst : this->F->instructions) {
+            for (LiveSet * sets : {&this->GEN, &this->KILL}) {
+                auto it = sets->find(inst);
+                if (it == sets->end()) continue;
+
+                for (Item * item : it->second) {
+                    if (IN_MAP(this->item2id, item)) continue;
+
+                    this->item2id[item] = this->id2item.size();
+                    this->id2item.push_back(item);
+                }
+            }
+        }
+    }
+
+    void FunctionLivenessAnalyzer::to_bit_vector(std::set<Item *> & items, BitVector & bits) {
+        for (Item * item : items) {
+            bits.set(this->item2id[item]);
+        }
+    }
+
+    void FunctionLivenessAnalyzer::to_live_set(BitVector & bits, std::set<Item *> & items) {
+        items.clear();
+        bits.for_each([&](int32_t id) {
+            items.insert(this->id2item[id]);
+        });
+    }
+
     void FunctionLivenessAnalyzer::calculate_INOUT() {
         /**
          *  Find successors for each instruction
          * */
         this->succVisitor.find_successors(this->F);
+        this->number_items();
 
-        bool changed;
+        std::vector<Instruction *> & insts = this->F->instructions;
+        int32_t inst_num = insts.size();
+        int32_t width = this->id2item.size();
 
-        do {
-            changed = false;
-            for (auto inst_it= F->instructions.rbegin(); inst_it != F->instructions.rend(); inst_it++ ){
-                Instruction * inst = *inst_it;
-                
-                // std::cerr <<  "successor size "<< this->succVisitor.successor[inst].size() << '\n';
-                this->OUT[inst].clear();
-                for (Instruction * succ : this->succVisitor.successor[inst]){
-                    this->OUT[inst].insert(
-                        this->IN[succ].begin(),
-                        this->IN[succ].end()
-                    );
-                }
-                
-                // output_INOUT();
-
-                bool in_changed = calc_live_OUT2IN(
-                                    inst,
-                                    this->live_visitor.GEN,
-                                    this->live_visitor.KILL,
-                                    this->IN,
-                                    this->OUT
-                                );
-                
-                if (!changed) changed = in_changed;
+        this->inst2idx.clear();
+        for (int32_t i = 0; i < inst_num; i++) {
+            this->inst2idx[insts[i]] = i;
+        }
 
-                // output_INOUT();
+        this->instGEN = std::vector<BitVector>(inst_num, BitVector(width));
+        this->instKILL = std::vector<BitVector>(inst_num, BitVector(width));
+        std::vector<std::vector<int32_t>> successors(inst_num);
+
+        for (int32_t i = 0; i < inst_num; i++) {
+            this->to_bit_vector(this->GEN[insts[i]], this->instGEN[i]);
+            this->to_bit_vector(this->KILL[insts[i]], this->instKILL[i]);
+
+            for (Instruction * succ : this->succVisitor.successor[insts[i]]) {
+                /**
+                 *  branching to an undefined label gives a NULL successor
+                 * */
+                if (succ == NULL) continue;
+                successors[i].push_back(this->inst2idx[succ]);
             }
+        }
 
-            // for (Instruction * inst : F->instructions){
-            //     // Instruction * inst = *inst_it;
-                
-            //     bool in_changed = calc_live_OUT2IN(
-            //                         inst,
-            //                         this->live_visitor.GEN,
-            //                         this->live_visitor.KILL,
-            //                         this->IN,
-            //                         this->OUT
-            //                     );
-
-            //     std::set<Item *> tempOut;            
-            //     /**
-            //      *  Calculate OUT of current instruction from IN of successors
-            //      * */
-            //     for (Instruction * succ : this->succVisitor.successor[inst]){
-            //         this->OUT[inst].insert(
-            //             this->IN[inst].begin(),
-            //             this->IN[inst].end()
-            //         );
-            //     }
-            //     bool out_changed = this->OUT[inst] != tempOut;
+        /**
+         *  solve on basic blocks, per-instruction sets are filled in lazily
+         * */
+        this->cfg.build(successors);
 
-                
-                
-            //     changed = changed || in_changed || out_changed;
+        delete this->solver;
+        this->solver = new BlockLivenessSolver(this->cfg, this->instGEN, this->instKILL, width);
+        this->solver->solve();
+
+        this->IN.clear();
+        this->OUT.clear();
+        this->blockInLiveSet = std::vector<bool>(this->cfg.blocks.size(), false);
+    }
 
-            // }
+    void FunctionLivenessAnalyzer::materialize_block(int32_t block) {
+        if (this->blockInLiveSet[block]) return;
 
-        } while(changed);
-        
+        BasicBlock & bb = this->cfg.blocks[block];
+        for (int32_t i = bb.first; i <= bb.last; i++) {
+            Instruction * inst = this->F->instructions[i];
+            this->to_live_set(this->solver->get_IN(i), this->IN[inst]);
+            this->to_live_set(this->solver->get_OUT(i), this->OUT[inst]);
+        }
+
+        this->blockInLiveSet[block] = true;
     }
 
     void FunctionLivenessAnalyzer::output_INOUT() {
+        this->get_live_IN();
+
         std::cout << '(' << '\n'; 
         std::cout << '(' << "in" << '\n';
         
@@ -333,11 +331,17 @@ OUT[return] = {}
 
     LiveSet & FunctionLivenessAnalyzer::get_live_IN() 
     {
+        for (int32_t b = 0; b < (int32_t) this->cfg.blocks.size(); b++) {
+            this->materialize_block(b);
+        }
         return this->IN;
     }
 
     LiveSet & FunctionLivenessAnalyzer::get_live_OUT()
     {
+        for (int32_t b = 0; b < (int32_t) this->cfg.blocks.size(); b++) {
+            this->materialize_block(b);
+        }
         return this->OUT;
     }
 
@@ -351,10 +355,16 @@ OUT[return] = {}
     }
 
     std::set<Item *> FunctionLivenessAnalyzer::get_live_after(Instruction * inst) {
+        if (IN_MAP(this->inst2idx, inst)) {
+            this->materialize_block(this->cfg.inst2block[this->inst2idx[inst]]);
+        }
         return this->OUT[inst];
     }
 
     std::set<Item *> FunctionLivenessAnalyzer::get_live_since(Instruction * inst) {
+        if (IN_MAP(this->inst2idx, inst)) {
+            this->materialize_block(this->cfg.inst2block[this->inst2idx[inst]]);
+        }
         return this->IN[inst];
     }
 
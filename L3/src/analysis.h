@@ -7,9 +7,16 @@
 #include <vector>
 #include "L3.h"
 #include "utils.h"
+#include <bit_vector.h>
+#include <cfg.h>
 
 namespace L3
 {
+    using Dataflow::BitVector;
+    using Dataflow::BasicBlock;
+    using Dataflow::ControlFlowGraph;
+    using Dataflow::BlockLivenessSolver;
+
     void run_liveAnalysis(Program &p);
 
     // typedef std::unordered_map<Instruction *, std::unordered_set<Item *>> LiveSet 
@@ -62,13 +69,23 @@ namespace L3
         void output_GENKILL();
 
         FunctionLivenessAnalyzer(Function *F);
+        ~FunctionLivenessAnalyzer();
         
         LiveSet & get_live_KILL();
+
+        /**
+         *  IN/OUT of every instruction
+         *      materializes the blocks that have not been queried yet
+         * */
         LiveSet & get_live_IN();
         LiveSet & get_live_OUT();
 
         std::set<Item *> get_used(Instruction *);
         std::set<Item *> get_defs(Instruction *);
+
+        /**
+         *  only the basic block of @inst gets materialized
+         * */
         std::set<Item *> get_live_after(Instruction *);
         std::set<Item *> get_live_since(Instruction *);
     private:
@@ -79,6 +96,32 @@ namespace L3
         LiveSet GEN;
         LiveSet KILL;
 
+        /**
+         *  dense numbering of the variables of F
+         *      the fixed point runs on BitVectors indexed by these ids
+         * */
+        std::vector<Item *> id2item;
+        std::unordered_map<Item *, int32_t> item2id;
+        std::unordered_map<Instruction *, int32_t> inst2idx;
+
+        void number_items();
+        void to_bit_vector(std::set<Item *> & items, BitVector & bits);
+        void to_live_set(BitVector & bits, std::set<Item *> & items);
+
+        /**
+         *  block-level dataflow state built by calculate_INOUT
+         * */
+        std::vector<BitVector> instGEN;
+        std::vector<BitVector> instKILL;
+        ControlFlowGraph cfg;
+        BlockLivenessSolver * solver;
+
+        /**
+         *  copy the per-instruction sets of @block into IN/OUT
+         * */
+        void materialize_block(int32_t block);
+        std::vector<bool> blockInLiveSet;
+
         LivenessVisitor live_visitor;
 
         SuccessorVisitor succVisitor;
@@ -1,5 +1,6 @@
 #include "code_generator.h"
-#include <fstream>
+#include <output_sink.h>
+#include <thread_pool.h>
 // #include <assert.h>
 
 // #define CODE_GEN_DEBUG 1
@@ -18,61 +19,78 @@
 namespace L3 {
     
 
-    void generateCode(
+    void generateFunction(
         Program & p,
-        std::vector<std::vector<InstSelectForest * >> & codeGenerator
+        std::vector<std::vector<InstSelectForest * >> & codeGenerator,
+        int32_t fIdx,
+        L2Emitter & emitter
     ) {
-        std::ofstream out =  std::ofstream();
-        out.open("prog.L2");
-        
-        out << "(" << p.mainF->name->to_string() << "\n";
-        
-        for (int16_t i = 0; i < p.functions.size(); i++) {
-            Function * F = p.functions[i];
-
-            out << "(";
-            out << F->name->to_string();
-            out << " ";
-            out << F->arg_list.size();
-            out << "\n";
-
-            /**
-             *  loading args
-             * */
-            for (int32_t i = 0; i < F->arg_list.size(); i++) {
-                out << '\t';
-                out << F->arg_list[i]->to_string();
-                out << " <- ";
-                
-                if (i < L3::ARG_NUM) {
-                    out << L3::arg_regs[i]->to_string();
-                }
-                else 
-                {
-                    int32_t offset = (F->arg_list.size() - i - 1) * 8;
-                    out << "stack-arg " << std::to_string(offset);  
-                }
-                out << "\n";
-            }
+        Function * F = p.functions[fIdx];
+        tile_begin_function(fIdx);
 
+        emitter.begin_function(F->name, F->arg_list.size());
 
-            for (InstSelectForest * forest : codeGenerator[i]) 
+        /**
+         *  loading args
+         * */
+        for (int32_t i = 0; i < F->arg_list.size(); i++) {
+            if (i < L3::ARG_NUM) {
+                emitter.assign(F->arg_list[i], L3::arg_regs[i]);
+            }
+            else 
             {
-                std::vector<std::string> insts_str;
-                forest->generateCode(insts_str);
-
-                for (int16_t j = 0; j < insts_str.size(); j++) {
-                    out << '\t' << insts_str[j];
-                }
+                int32_t offset = (F->arg_list.size() - i - 1) * 8;
+                emitter.stack_arg(F->arg_list[i], offset);
             }
+        }
+
+        /**
+         *  tiles hand their instructions to @emitter
+         * */
+        for (InstSelectForest * forest : codeGenerator[fIdx]) 
+        {
+            forest->generateCode(emitter);
+        }
+
+        emitter.end_function();
+    }
 
-            out << ")\n\n";
+    void generateCode(
+        Program & p,
+        std::vector<std::vector<InstSelectForest * >> & codeGenerator
+    ) {
+        Output::Sink out(1 << 20);
+
+        generateCode(p, codeGenerator, out);
 
+        if (!out.flush("prog.L2")) {
+            std::cerr << "cannot write prog.L2\n";
         }
+    }
 
-        out << ")\n";
+    void generateCode(
+        Program & p,
+        std::vector<std::vector<InstSelectForest * >> & codeGenerator,
+        Output::Sink & out
+    ) {
+        out << "(";
+        p.mainF->name->print(out);
+        out << "\n";
+        
+        /**
+         *  functions are generated in parallel into their own buffers,
+         *      then written out in program order
+         * */
+        /**
+         *  functions are generated in parallel into their own buffers,
+         *      then written out in program order
+         * */
+        ThreadPool::parallel_emit(p.functions.size(), out, [&](int32_t i, Output::Sink & out) {
+            L2TextEmitter emitter(out);
+            generateFunction(p, codeGenerator, i, emitter);
+        });
 
-        out.close();
+        out << ")\n";
 
     }
 }
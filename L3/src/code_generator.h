@@ -6,8 +6,16 @@
 #include <vector>
 
 #include "inst_selection.h"
+#include "emitter.h"
 
 namespace L3 {
 
+    /**
+     *  select and hand the L2 instructions of function @fIdx to @emitter,
+     *      tile_set_prefix must have been called
+     * */
+    void generateFunction(Program & p, std::vector<std::vector<InstSelectForest * >> & codeGenerator, int32_t fIdx, L2Emitter & emitter);
+
     void generateCode(Program & p, std::vector<std::vector<InstSelectForest * >> & codeGenerator);
+    void generateCode(Program & p, std::vector<std::vector<InstSelectForest * >> & codeGenerator, Output::Sink & out);
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "emitter.h"
+
+namespace L3 {
+
+    L2TextEmitter::L2TextEmitter(Output::Sink & out) : out(out) {}
+
+    void L2TextEmitter::begin_function(ItemLabel * name, int64_t arguments) {
+        out << "(";
+        name->print(out);
+        out << " " << arguments << "\n";
+    }
+
+    void L2TextEmitter::end_function() {
+        out << ")\n\n";
+    }
+
+    void L2TextEmitter::assign(Item * dst, Item * src) {
+        out << '\t';
+        dst->print(out);
+        out << " " << OperatorType_toString(OperatorType::assign) << " ";
+        src->print(out);
+        out << "\n";
+    }
+
+    void L2TextEmitter::load(Item * dst, Item * addr, int64_t offset) {
+        out << '\t';
+        dst->print(out);
+        out << " " << OperatorType_toString(OperatorType::assign) << " mem ";
+        addr->print(out);
+        out << " " << offset << "\n";
+    }
+
+    void L2TextEmitter::store(Item * addr, int64_t offset, Item * src) {
+        out << '\t';
+        out << "mem ";
+        addr->print(out);
+        out << " " << offset << " " << OperatorType_toString(OperatorType::assign) << " ";
+        src->print(out);
+        out << "\n";
+    }
+
+    void L2TextEmitter::stack_arg(Item * dst, int64_t offset) {
+        out << '\t';
+        dst->print(out);
+        out << " " << OperatorType_toString(OperatorType::assign) << " stack-arg " << offset << "\n";
+    }
+
+    /**
+     *  + -> +=
+     * */
+    void L2TextEmitter::aop(Item * dst, OperatorType op, Item * src) {
+        out << '\t';
+        dst->print(out);
+        out << " " << OperatorType_toString(op) << "= ";
+        src->print(out);
+        out << "\n";
+    }
+
+    void L2TextEmitter::cmp(Item * dst, Item * op1, OperatorType cmp, Item * op2) {
+        out << '\t';
+        dst->print(out);
+        out << " " << OperatorType_toString(OperatorType::assign) << " ";
+        op1->print(out);
+        out << " " << OperatorType_toString(cmp) << " ";
+        op2->print(out);
+        out << "\n";
+    }
+
+    void L2TextEmitter::cjump(Item * op1, OperatorType cmp, Item * op2, Item * label) {
+        out << '\t';
+        out << "cjump ";
+        op1->print(out);
+        out << " " << OperatorType_toString(cmp) << " ";
+        op2->print(out);
+        out << " ";
+        label->print(out);
+        out << "\n";
+    }
+
+    void L2TextEmitter::go_to(Item * label) {
+        out << '\t';
+        out << "goto ";
+        label->print(out);
+        out << "\n";
+    }
+
+    void L2TextEmitter::label(Item * label) {
+        out << '\t';
+        label->print(out);
+        out << "\n";
+    }
+
+    void L2TextEmitter::call(Item * callee, int64_t nargs) {
+        out << '\t';
+        out << "call ";
+        callee->print(out);
+        out << " " << nargs << "\n";
+    }
+
+    void L2TextEmitter::ret() {
+        out << '\t';
+        out << OperatorType_toString(OperatorType::ret);
+        out << "\n";
+    }
+}
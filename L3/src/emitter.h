@@ -0,0 +1,73 @@
+#pragma once
+
+#include <output_sink.h>
+#include "L3.h"
+#include "inst_selection.h"
+
+namespace L3 {
+
+    /**
+     *  Receiver of the L2 instructions the tiles select
+     *      operands are L3 items (variables, labels, constants and registers),
+     *      the emitter decides whether they become L2 text or L2 objects
+     * */
+    class L2Emitter {
+        public:
+            virtual void begin_function(ItemLabel * name, int64_t arguments) = 0;
+            virtual void end_function() = 0;
+
+            /* dst <- src */
+            virtual void assign(Item * dst, Item * src) = 0;
+
+            /* dst <- mem addr offset */
+            virtual void load(Item * dst, Item * addr, int64_t offset) = 0;
+
+            /* mem addr offset <- src */
+            virtual void store(Item * addr, int64_t offset, Item * src) = 0;
+
+            /* dst <- stack-arg offset */
+            virtual void stack_arg(Item * dst, int64_t offset) = 0;
+
+            /* dst op= src, @op one of the aop operators */
+            virtual void aop(Item * dst, OperatorType op, Item * src) = 0;
+
+            /* dst <- op1 cmp op2, @cmp one of <, <= and = */
+            virtual void cmp(Item * dst, Item * op1, OperatorType cmp, Item * op2) = 0;
+
+            /* cjump op1 cmp op2 label, @cmp one of <, <= and = */
+            virtual void cjump(Item * op1, OperatorType cmp, Item * op2, Item * label) = 0;
+
+            virtual void go_to(Item * label) = 0;
+            virtual void label(Item * label) = 0;
+            virtual void call(Item * callee, int64_t nargs) = 0;
+            virtual void ret() = 0;
+
+            virtual ~L2Emitter() {}
+    };
+
+    /**
+     *  L2 text, one tab-indented line per instruction
+     * */
+    class L2TextEmitter : public L2Emitter {
+        public:
+            L2TextEmitter(Output::Sink & out);
+
+            void begin_function(ItemLabel * name, int64_t arguments) override;
+            void end_function() override;
+
+            void assign(Item * dst, Item * src) override;
+            void load(Item * dst, Item * addr, int64_t offset) override;
+            void store(Item * addr, int64_t offset, Item * src) override;
+            void stack_arg(Item * dst, int64_t offset) override;
+            void aop(Item * dst, OperatorType op, Item * src) override;
+            void cmp(Item * dst, Item * op1, OperatorType cmp, Item * op2) override;
+            void cjump(Item * op1, OperatorType cmp, Item * op2, Item * label) override;
+            void go_to(Item * label) override;
+            void label(Item * label) override;
+            void call(Item * callee, int64_t nargs) override;
+            void ret() override;
+
+        private:
+            Output::Sink & out;
+    };
+}
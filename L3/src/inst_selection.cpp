@@ -1,4 +1,5 @@
 
+#include <thread_pool.h>
 #include "inst_selection.h"
 
 // #define INST_SELECT_DEBUG
@@ -84,7 +85,7 @@ namespace L3{
         }
     }
 
-    std::string OperatorType_toString(OperatorType optype) {
+    const char * OperatorType_toString(OperatorType optype) {
         switch (optype)
         {
         case noDef:
@@ -207,13 +208,13 @@ namespace L3{
         return bestTile != NULL;
     }
 
-    void InstSelectNode::generateCode(std::vector<std::string> & insts_str) {
+    void InstSelectNode::generateCode(L2Emitter & emitter) {
 
         for (InstSelectNode * next : this->nextNodes) {
-            next->generateCode(insts_str);
+            next->generateCode(emitter);
         }
 
-        this->coveredBy->generateL2Inst(this, insts_str);
+        this->coveredBy->generateL2Inst(this, emitter);
     }
 
     InstSelectNodeOperator::InstSelectNodeOperator(OperatorType op) {
@@ -228,6 +229,10 @@ namespace L3{
         return OperatorType_toString(this->op);
     }
 
+    void InstSelectNodeOperator::print(Output::Sink & out) {
+        out << OperatorType_toString(this->op);
+    }
+
     void InstSelectNodeOperator::AddChild(InstSelectNode *leaf) {
         this->children.push_back(leaf);
     }
@@ -287,6 +292,10 @@ namespace L3{
         return this->data->to_string();
     }
 
+    void InstSelectNodeOperand::print(Output::Sink & out) {
+        this->data->print(out);
+    }
+
     
     
     bool InstSelectTree::tiling(std::vector<Tile *> & tiles) {
@@ -304,8 +313,8 @@ namespace L3{
         
     }
 
-    void InstSelectTree::generateCode(std::vector<std::string> & insts_str) {
-        this->head->generateCode(insts_str);
+    void InstSelectTree::generateCode(L2Emitter & emitter) {
+        this->head->generateCode(emitter);
     }
 
 
@@ -1157,10 +1166,10 @@ namespace L3{
         }
     }
 
-    void InstSelectForest::generateCode(std::vector<std::string> & insts_str) {
+    void InstSelectForest::generateCode(L2Emitter & emitter) {
         
         for (auto tree: this->trees) {
-            tree->generateCode(insts_str);
+            tree->generateCode(emitter);
         }
     }
 
@@ -1174,15 +1183,17 @@ namespace L3{
             std::vector<InstSelectForest * >()
         );
 
-        std::vector<Tile *> L3ToL2_tiles;
         std::string prefix =  new_var_prefix(p);
         std::string FRet_prefix = new_fRetLabel_prefix(p);
 
-        tile_init(p, L3ToL2_tiles, prefix, FRet_prefix);
+        tile_set_prefix(prefix, FRet_prefix);
 
         // for  (Function * F : p.functions) {
-        for (int16_t i = 0; i < p.functions.size(); i++) {
+        ThreadPool::parallel_for(p.functions.size(), [&](int32_t i) {
             Function * F = p.functions[i];
+
+            std::vector<Tile *> L3ToL2_tiles;
+            tile_init(p, L3ToL2_tiles);
             /**
              *  run liveness analysis
              * */
@@ -1216,7 +1227,7 @@ namespace L3{
 
             }
 
-        }
+        });
     }
 
 }
\ No newline at end of file
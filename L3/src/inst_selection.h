@@ -18,6 +18,8 @@ namespace L3{
     struct PatternNodeOperand;
     struct PatternTree;
 
+    class L2Emitter;
+
     struct Tile {
         int32_t nodenCnt;
         int32_t cost;
@@ -28,7 +30,7 @@ namespace L3{
         PatternTree *pattern;
         bool match(InstSelectNode *, std::vector<InstSelectNode *> &);
 
-        virtual void generateL2Inst(InstSelectNode *, std::vector<std::string> &) = 0;
+        virtual void generateL2Inst(InstSelectNode *, L2Emitter &) = 0;
     
     };
 
@@ -45,12 +47,28 @@ namespace L3{
 
     void transform_label (Program & p);
 
-    void tile_init(
-        Program & p,
-        std::vector<Tile *> & L3ToL2_tiles,
+    /**
+     *  prefixes of new variables and return labels, once per program
+     * */
+    void tile_set_prefix(
         std::string & prefix,
         std::string & FRet_prefix
     );
+
+    /**
+     *  restart the new variable/return label counters of this thread for the @fIdx th function
+     *      return labels carry @fIdx so they stay unique across functions
+     * */
+    void tile_begin_function(int32_t fIdx);
+
+    /**
+     *  a fresh set of tiles, tiles record what they matched
+     *      so every function gets its own
+     * */
+    void tile_init(
+        Program & p,
+        std::vector<Tile *> & L3ToL2_tiles
+    );
     
     enum OperatorType {
         noDef,
@@ -67,7 +85,7 @@ namespace L3{
         op_others
     };
 
-    std::string OperatorType_toString(OperatorType optype);
+    const char * OperatorType_toString(OperatorType optype);
 
     struct genNode {
         // std::vector<genNode *> children;
@@ -92,10 +110,15 @@ namespace L3{
 
 
         virtual std::string to_string() = 0;
+        virtual void print(Output::Sink & out) = 0;
         virtual InstSelectNode * copy() = 0;
 
         bool tiling(std::vector<Tile *> & tiles);
-        void generateCode(std::vector<std::string> &);
+
+        /**
+         *  L2 instructions of the subtrees first, then of this node, handed to @emitter
+         * */
+        void generateCode(L2Emitter & emitter);
     };
 
     struct InstSelectNodeOperator : InstSelectNode
@@ -114,6 +137,7 @@ namespace L3{
         void AddChild(InstSelectNode * leaf);
 
         std::string to_string();
+        void print(Output::Sink & out) override;
         InstSelectNode * copy() override;
 
     };
@@ -127,6 +151,7 @@ namespace L3{
 
         InstSelectNode * copy() override;
         std::string to_string();
+        void print(Output::Sink & out) override;
     };
 
     
@@ -154,7 +179,7 @@ namespace L3{
          * */
         bool tiling(std::vector<Tile *> & tiles);
 
-        void generateCode(std::vector<std::string> &);
+        void generateCode(L2Emitter & emitter);
         void print();
         
 
@@ -244,7 +269,7 @@ namespace L3{
         );
 
         bool tiling(std::vector<Tile *> & tiles);
-        void generateCode(std::vector<std::string> & insts_str);
+        void generateCode(L2Emitter & emitter);
         void print();
 
         private:
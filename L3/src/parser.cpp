@@ -1373,5 +1373,28 @@ namespace L3 {
         return p;
     }
 
+    Program parse_input (const std::string & source, const std::string & sourceName){
+
+        /* 
+        * Check the grammar for some possible issues.
+        */
+        pegtl::analyze< grammar >();
+
+        /*
+        * Parse the in-memory text handed over by the previous stage.
+        */   
+        memory_input< > memoryInput(source, sourceName);
+        Program p;
+        parse< grammar, action >(memoryInput, p);
+
+        if (p.mainF == NULL){
+            std::cerr << "missing main function" << '\n';
+            assert(0);
+        }
+
+
+        return p;
+    }
+
 
 }
@@ -4,6 +4,7 @@
 
 namespace L3{
     Program parse_file (char *fileName);
+    Program parse_input (const std::string & source, const std::string & sourceName);
     // Program parse_function_file (char *fileName);
     // Program parse_spill_file(char *fileName);
 }
@@ -3,11 +3,17 @@
 
 namespace L3 {
     
-    static int32_t new_var_cnt = 0;
+    /**
+     *  prefixes are set once per program,
+     *  counters are per thread and restart for every function (tile_begin_function)
+     *      so fresh names only depend on the function being generated
+     * */
     static std::string prefix;
+    static thread_local int32_t new_var_cnt = 0;
 
-    static int32_t FRet_cnt = 0;
     static std::string FRet_prefix;
+    static thread_local int32_t FRet_cnt = 0;
+    static thread_local int32_t FRet_fIdx = 0;
     
     std::set<OperatorType> aopOps = 
     {
@@ -285,10 +291,27 @@ namespace L3 {
         }
     }
 
+    /**
+     *  same as varNodeToString, but the item itself for the emitter
+     * */
+    Item * varNodeItem(InstSelectNode * instNode) {
+        if (instNode->isOperator) {
+            InstSelectNodeOperator * oprt = (InstSelectNodeOperator *) instNode;
+            assert(oprt->representative != NULL);
+            return oprt->representative;
+        }
+        else 
+        {
+            InstSelectNodeOperand * oprd = (InstSelectNodeOperand *) instNode;
+
+            return oprd->data;
+        }
+    }
+
 
     void AopTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
         
         /**
@@ -313,25 +336,8 @@ namespace L3 {
         
         assert(oprt->children.size() == 2);
 
-        std::string inst = "";
-        inst += varNodeToString(oprt);
-        inst += " ";
-        inst += OperatorType_toString(OperatorType::assign);     /*  <- */
-        inst += " ";
-        inst += varNodeToString(oprt->children[0]);
-        inst += "\n";
-
-        insts_str.push_back(inst);
-        inst.clear();
-
-        inst += varNodeToString(oprt);
-        inst += " ";
-        inst += OperatorType_toString(oprt->op) + "=";     /*  + -> += */
-        inst += " ";
-        inst += varNodeToString(oprt->children[1]);
-        inst += "\n";
-
-        insts_str.push_back(inst);
+        emitter.assign(oprt->representative, varNodeItem(oprt->children[0]));
+        emitter.aop(oprt->representative, oprt->op, varNodeItem(oprt->children[1]));     /*  + -> += */
     }
     
     AssignToVarTile::AssignToVarTile () {
@@ -362,7 +368,7 @@ namespace L3 {
 
     void AssignToVarTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
          /**
          *  WTF if it's not matched???
@@ -382,16 +388,7 @@ namespace L3 {
         
         assert(oprt->children.size() == 2);
 
-        std::string inst = "";
-
-        inst += varNodeToString(oprt->children[0]);
-        inst += " ";
-        inst += OperatorType_toString(OperatorType::assign);     /*  <- */
-        inst += " ";
-        inst += varNodeToString(oprt->children[1]);
-        inst += "\n";
-
-        insts_str.push_back(inst);
+        emitter.assign(varNodeItem(oprt->children[0]), varNodeItem(oprt->children[1]));
     }
 
     AssignToStoreTile::AssignToStoreTile () {
@@ -435,7 +432,7 @@ namespace L3 {
 
     void AssignToStoreTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
          /**
          *  WTF if it's not matched???
@@ -467,20 +464,7 @@ namespace L3 {
         
         int32_t offset = 0;
         
-        std::string inst = "";
-
-        inst += "mem";
-        inst += " ";
-        inst += varNodeToString(store->children[0]);            /* assign */
-        inst += " ";
-        inst += std::to_string(offset);                         
-        inst += " ";
-        inst += OperatorType_toString(OperatorType::assign);     /*  <- */
-        inst += " ";
-        inst += varNodeToString(oprt->children[1]);                 
-        inst += "\n";
-
-        insts_str.push_back(inst);
+        emitter.store(varNodeItem(store->children[0]), offset, varNodeItem(oprt->children[1]));
     }
 
     ReturnTile::ReturnTile() {
@@ -498,7 +482,7 @@ namespace L3 {
 
     void ReturnTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
          /**
          *  WTF if it's not matched???
@@ -506,17 +490,8 @@ namespace L3 {
         assert(IN_SET(this->matchedNodes, instNode));
 
         assert(instNode->isOperator);
-        InstSelectNodeOperator * oprt = (InstSelectNodeOperator *) instNode;
-        
-
-        std::string inst = "";
-
-
-        inst += oprt->to_string();
-        inst += "\n";
-        
-        insts_str.push_back(inst);
 
+        emitter.ret();
     }
 
     ReturnValueTile::ReturnValueTile() {
@@ -539,7 +514,7 @@ namespace L3 {
 
     void ReturnValueTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
          /**
          *  WTF if it's not matched???
@@ -552,19 +527,8 @@ namespace L3 {
 
         assert(oprt->children.size() == 1);
 
-        std::string inst = "";
-
-        inst += "rax <- ";
-        inst += varNodeToString(oprt->children[0]);
-        inst += "\n";
-
-        insts_str.push_back(inst);
-        
-        inst.clear();
-        inst += oprt->to_string();
-        inst += "\n";
-        
-        insts_str.push_back(inst);
+        emitter.assign(&reg_rax, varNodeItem(oprt->children[0]));
+        emitter.ret();
     }
 
     CallTile::CallTile(bool isRuntimeCall, int32_t num_args) {
@@ -631,7 +595,7 @@ namespace L3 {
 
     void CallTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
 
         assert(IN_SET(this->matchedNodes, instNode));
@@ -647,7 +611,6 @@ namespace L3 {
             L3::prefix + std::to_string(L3::new_var_cnt++)
         );
 
-        std::string inst = "";
         std::string new_ret_label = "";
 
         /**
@@ -662,42 +625,34 @@ namespace L3 {
         
         
         for (int32_t i = 0; i < this->num_args; i++) {
-            inst.clear();
-
             if (i < L3::ARG_NUM) {
-                inst += L3::arg_regs[i]->to_string();
+                emitter.assign(L3::arg_regs[i], varNodeItem(oprt->children[i + 1]));
             } else {
                 /**
                  *  i = 6, 7th arg, offset = -16
                  * */
                 int32_t offset = -8 + (i - L3::ARG_NUM + 1) * (-8);
                 
-                inst += "mem rsp " + std::to_string(offset);
+                emitter.store(&reg_rsp, offset, varNodeItem(oprt->children[i + 1]));
             }
-
-            inst += " <- ";
-            inst += varNodeToString(oprt->children[i + 1]);
-            inst += "\n";
-            insts_str.push_back(inst);
         }
 
+        ItemLabel * ret_label = NULL;
         if (!this->isRuntimeCall) {
             new_ret_label = FRet_prefix 
                         + "_" 
                         + fname_noColon
                         + "_"
+                        + std::to_string(L3::FRet_fIdx)
+                        + "_"
                         + std::to_string(L3::FRet_cnt++);  
+            ret_label = new ItemLabel(new_ret_label);
 
             /**
              *  Sample output:
              *      mem rsp -8 <- :new_ret_label
              * */
-
-            inst.clear();
-            inst += "mem rsp -8 <- " ;
-            inst += new_ret_label;
-            inst += "\n";
-            insts_str.push_back(inst);
+            emitter.store(&reg_rsp, -8, ret_label);
         }
 
 
@@ -705,13 +660,7 @@ namespace L3 {
          *  Sample output:
          *      call :myF 1
          * */
-        inst.clear();
-        inst += "call ";
-        inst += varNodeToString(callee);
-        inst += " ";
-        inst += std::to_string(this->num_args);
-        inst += "\n";
-        insts_str.push_back(inst);
+        emitter.call(varNodeItem(callee), this->num_args);
 
         
         if (!this->isRuntimeCall) {
@@ -719,26 +668,13 @@ namespace L3 {
              *  Sample output:
              *      :new_ret_label
              * */
-
-            inst.clear();
-            inst += new_ret_label;
-            inst += "\n";
-            insts_str.push_back(inst);
+            emitter.label(ret_label);
         }
         
         /**
          *  %newVar <- rax
          * */
-        inst.clear();
-        inst += varNodeToString(oprt);
-        inst += " ";
-        inst += OperatorType_toString(OperatorType::assign);
-        inst += " ";
-        inst += reg_rax.to_string();
-        inst += "\n";
-        insts_str.push_back(inst);
-
-
+        emitter.assign(oprt->representative, &reg_rax);
     }
 
     CmpTile::CmpTile() {
@@ -773,7 +709,7 @@ namespace L3 {
 
     void CmpTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
         
         /**
@@ -796,48 +732,21 @@ namespace L3 {
         
         assert(oprt->children.size() == 2);
 
-        std::string inst = "";
         /**
          * Flips >= and > because only < exists in L2
          * */
         if (oprt->op == op_geq)
         {
-            inst += varNodeToString(oprt);
-            inst += " ";
-            inst += OperatorType_toString(OperatorType::assign); /*  <- */
-            inst += " ";
-            inst += varNodeToString(oprt->children[1]);
-            inst += " ";
-            inst += OperatorType_toString(OperatorType::op_leq);
-            inst += " ";
-            inst += varNodeToString(oprt->children[0]);
+            emitter.cmp(oprt->representative, varNodeItem(oprt->children[1]), OperatorType::op_leq, varNodeItem(oprt->children[0]));
         }
         else if (oprt->op == op_great)
         {
-            inst += varNodeToString(oprt);
-            inst += " ";
-            inst += OperatorType_toString(OperatorType::assign); /*  <- */
-            inst += " ";
-            inst += varNodeToString(oprt->children[1]);
-            inst += " ";
-            inst += OperatorType_toString(OperatorType::op_less);
-            inst += " ";
-            inst += varNodeToString(oprt->children[0]);
+            emitter.cmp(oprt->representative, varNodeItem(oprt->children[1]), OperatorType::op_less, varNodeItem(oprt->children[0]));
         }
         else
         {
-            inst += varNodeToString(oprt);
-            inst += " ";
-            inst += OperatorType_toString(OperatorType::assign); /*  <- */
-            inst += " ";
-            inst += varNodeToString(oprt->children[0]);
-            inst += " ";
-            inst += OperatorType_toString(oprt->op);
-            inst += " ";
-            inst += varNodeToString(oprt->children[1]);
+            emitter.cmp(oprt->representative, varNodeItem(oprt->children[0]), oprt->op, varNodeItem(oprt->children[1]));
         }
-        inst += "\n";
-        insts_str.push_back(inst);
     }
 
     UncondBrTile::UncondBrTile () {
@@ -864,7 +773,7 @@ namespace L3 {
 
     void UncondBrTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
         assert(IN_SET(this->matchedNodes, instNode));
         assert(instNode->isOperator);
@@ -872,12 +781,7 @@ namespace L3 {
 
         assert(oprt->children.size() == 1);
         
-        std::string inst = "";
-        inst += "goto ";
-        inst += oprt->children[0]->to_string();
-        inst += "\n";
-
-        insts_str.push_back(inst);
+        emitter.go_to(varNodeItem(oprt->children[0]));
     }
 
     CondBrOnConstTile::CondBrOnConstTile() {
@@ -907,7 +811,7 @@ namespace L3 {
     
     void CondBrOnConstTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ){
         assert(IN_SET(this->matchedNodes, instNode));
         assert(instNode->isOperator);
@@ -924,11 +828,7 @@ namespace L3 {
          *  only goto's if 1
          * */
         if (constData->constVal == 1) {
-            std::string inst = "";
-            inst += "goto ";
-            inst += oprt->children[1]->to_string();
-            inst += "\n";
-            insts_str.push_back(inst);
+            emitter.go_to(varNodeItem(oprt->children[1]));
         }
 
     }
@@ -975,7 +875,7 @@ namespace L3 {
 
     void CondBrOnCmpTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
         assert(IN_SET(this->matchedNodes, instNode));
         assert(instNode->isOperator);
@@ -994,40 +894,20 @@ namespace L3 {
 
         InstSelectNodeOperator * cmp = (InstSelectNodeOperator *) oprt->children[0];
         assert(cmp->children.size() == 2);
-        std::string inst = "";
-        inst += "cjump ";
+        Item * label = varNodeItem(oprt->children[1]);
 
         if (cmp->op == op_geq)
         {
-            inst += varNodeToString(cmp->children[1]);
-            inst += " ";
-            inst += OperatorType_toString(OperatorType::op_leq);
-            inst += " ";
-            inst += varNodeToString(cmp->children[0]);
+            emitter.cjump(varNodeItem(cmp->children[1]), OperatorType::op_leq, varNodeItem(cmp->children[0]), label);
         }
         else if (cmp->op == op_great)
         {
-            inst += varNodeToString(cmp->children[1]);
-            inst += " ";
-            inst += OperatorType_toString(OperatorType::op_less);
-            inst += " ";
-            inst += varNodeToString(cmp->children[0]);
+            emitter.cjump(varNodeItem(cmp->children[1]), OperatorType::op_less, varNodeItem(cmp->children[0]), label);
         }
         else
         {
-            inst += varNodeToString(cmp->children[0]);
-            inst += " ";
-            inst += OperatorType_toString(cmp->op);
-            inst += " ";
-            inst += varNodeToString(cmp->children[1]);
-            inst += " ";
+            emitter.cjump(varNodeItem(cmp->children[0]), cmp->op, varNodeItem(cmp->children[1]), label);
         }
-
-        inst += oprt->children[1]->to_string();
-        inst += "\n";
-
-        insts_str.push_back(inst);
-    
     }
 
     CondBrOnVarTile::CondBrOnVarTile () {
@@ -1062,7 +942,7 @@ namespace L3 {
 
     void CondBrOnVarTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
         assert(IN_SET(this->matchedNodes, instNode));
         assert(instNode->isOperator);
@@ -1076,14 +956,7 @@ namespace L3 {
          * */
         assert(oprt->children.size() == 2);
 
-        std::string inst = "";
-        inst += "cjump "; 
-        inst += varNodeToString(oprt->children[0]);
-        inst += " = ";
-        inst += " 1 ";
-        inst += oprt->children[1]->to_string();
-        inst += "\n";
-        insts_str.push_back(inst);
+        emitter.cjump(varNodeItem(oprt->children[0]), OperatorType::op_eq, new ItemConstant(1), varNodeItem(oprt->children[1]));
     }
 
     LabelTile::LabelTile () {
@@ -1111,7 +984,7 @@ namespace L3 {
 
     void LabelTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
         assert(IN_SET(this->matchedNodes, instNode));
         assert(instNode->isOperator);
@@ -1125,10 +998,7 @@ namespace L3 {
          * */
         assert(oprt->children.size() == 1);
 
-        std::string inst = "";
-        inst += oprt->children[0]->to_string();
-        inst += "\n";
-        insts_str.push_back(inst);
+        emitter.label(varNodeItem(oprt->children[0]));
     }
 
     LoadTile::LoadTile () {
@@ -1158,7 +1028,7 @@ namespace L3 {
 
     void LoadTile::generateL2Inst(
         InstSelectNode * instNode,
-        std::vector<std::string> & insts_str
+        L2Emitter & emitter
     ) {
         assert(IN_SET(this->matchedNodes, instNode));
         assert(instNode->isOperator);
@@ -1179,32 +1049,30 @@ namespace L3 {
         );
 
 
-        std::string inst = "";
-        inst += varNodeToString(oprt);
-        inst += " ";
-        inst += OperatorType_toString(OperatorType::assign);     /*  <- */
-        inst += " mem ";
-        inst += varNodeToString(oprt->children[0]);
-        inst += " 0 ";
-        inst += "\n";
-
-        insts_str.push_back(inst);
+        emitter.load(oprt->representative, varNodeItem(oprt->children[0]), 0);
     }
     
 
 
-    void tile_init(
-        Program & p,
-        std::vector<Tile *> & L3ToL2_tiles,
+    void tile_set_prefix(
         std::string & prefix,
         std::string & FRet_prefix
     ) {
         L3::prefix = prefix;
+        L3::FRet_prefix = FRet_prefix;
+    }
+
+    void tile_begin_function(int32_t fIdx) {
         L3::new_var_cnt = 0;
 
-        L3::FRet_prefix = FRet_prefix;
         L3::FRet_cnt = 0;
+        L3::FRet_fIdx = fIdx;
+    }
 
+    void tile_init(
+        Program & p,
+        std::vector<Tile *> & L3ToL2_tiles
+    ) {
         L3ToL2_tiles.push_back(
             new AopTile()
         );
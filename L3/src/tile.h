@@ -2,6 +2,7 @@
 
 #include "inst_selection.h"
 #include "code_generator.h"
+#include "emitter.h"
 
 namespace L3 {
 
@@ -77,7 +78,7 @@ namespace L3 {
         AopTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -91,7 +92,7 @@ namespace L3 {
         AssignToVarTile ();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -106,7 +107,7 @@ namespace L3 {
         AssignToStoreTile ();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -118,7 +119,7 @@ namespace L3 {
         ReturnTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -129,7 +130,7 @@ namespace L3 {
         ReturnValueTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -140,7 +141,7 @@ namespace L3 {
         CallTile(bool isRuntimeCall, int32_t num_args);
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -154,7 +155,7 @@ namespace L3 {
         CmpTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };  
 
@@ -174,7 +175,7 @@ namespace L3 {
 
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -189,7 +190,7 @@ namespace L3 {
         CondBrOnConstTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -205,7 +206,7 @@ namespace L3 {
         CondBrOnCmpTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -218,7 +219,7 @@ namespace L3 {
         CondBrOnVarTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 
@@ -232,7 +233,7 @@ namespace L3 {
         LabelTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
     
@@ -249,7 +250,7 @@ namespace L3 {
         LoadTile();
         void generateL2Inst(
             InstSelectNode *,
-            std::vector<std::string> &
+            L2Emitter &
         ) override;
     };
 